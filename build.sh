@@ -46,6 +46,15 @@ else
     CURL_FLAGS="-lcurl"
 fi
 
+# Check for zlib (optional, enables --compress)
+ZLIB_FLAGS=""
+if [ -f /usr/include/zlib.h ] || [ -f /usr/local/include/zlib.h ] || pkg-config --exists zlib 2>/dev/null; then
+    ZLIB_FLAGS="-DOLLAMA_AGENT_HAVE_ZLIB -lz"
+    echo "Found zlib (request compression enabled)"
+else
+    echo "zlib not found, request compression disabled"
+fi
+
 # Create build directory
 mkdir -p build
 
@@ -54,14 +63,33 @@ echo "Building OllamaAgent..."
 echo
 
 # Compile
-$CXX -std=c++17 -O2 \
+$CXX -std=c++17 -O2 -pthread \
     -I include \
     src/main.cpp \
     src/agent.cpp \
     src/file_manager.cpp \
     src/json_parser.cpp \
     src/ollama_client.cpp \
+    src/content_hash.cpp \
+    src/response_cache.cpp \
+    src/response_parser.cpp \
+    src/agent_server.cpp \
+    src/job_scheduler.cpp \
+    src/event_queue.cpp \
+    src/response_arena.cpp \
+    src/request_body.cpp \
+    src/config_file.cpp \
+    src/workspace_watcher.cpp \
+    src/ignore_rules.cpp \
+    src/file_writer.cpp \
+    src/embedding_index.cpp \
+    src/section_chunker.cpp \
+    src/summary_cache.cpp \
+    src/context_minifier.cpp \
+    src/context_dedup.cpp \
+    src/checkpoint_log.cpp \
     $CURL_FLAGS \
+    $ZLIB_FLAGS \
     -o build/ollama_agent
 
 if [ $? -ne 0 ]; then
@@ -94,6 +94,15 @@ if not exist "%CURL_INCLUDE%\curl\curl.h" (
 
 echo Found curl includes: %CURL_INCLUDE%
 
+:: zlib comes with vcpkg's curl; use it for request compression
+set "ZLIB_DEFINE="
+set "ZLIB_LIB="
+if exist "%CURL_INCLUDE%\zlib.h" (
+    set "ZLIB_DEFINE=/DOLLAMA_AGENT_HAVE_ZLIB"
+    set "ZLIB_LIB=zlib.lib"
+    echo Found zlib: request compression enabled
+)
+
 :: Create build directory
 if not exist build mkdir build
 
@@ -109,16 +118,35 @@ rc /nologo /fo build\app.res resources\app.rc
 cl /nologo /EHsc /std:c++17 /O2 ^
     /I include ^
     /I "%CURL_INCLUDE%" ^
+    %ZLIB_DEFINE% ^
     /DUNICODE /D_UNICODE ^
     src\gui_main.cpp ^
     src\agent.cpp ^
     src\file_manager.cpp ^
     src\json_parser.cpp ^
     src\ollama_client.cpp ^
+    src\content_hash.cpp ^
+    src\response_cache.cpp ^
+    src\response_parser.cpp ^
+    src\agent_server.cpp ^
+    src\job_scheduler.cpp ^
+    src\event_queue.cpp ^
+    src\response_arena.cpp ^
+    src\request_body.cpp ^
+    src\config_file.cpp ^
+    src\workspace_watcher.cpp ^
+    src\ignore_rules.cpp ^
+    src\file_writer.cpp ^
+    src\embedding_index.cpp ^
+    src\section_chunker.cpp ^
+    src\summary_cache.cpp ^
+    src\context_minifier.cpp ^
+    src\context_dedup.cpp ^
+    src\checkpoint_log.cpp ^
     build\app.res ^
     /Fe:build\ollama_agent_gui.exe ^
     /Fo:build\ ^
-    /link /SUBSYSTEM:WINDOWS /LIBPATH:"%CURL_LIB%" libcurl.lib ws2_32.lib user32.lib gdi32.lib comctl32.lib shell32.lib ole32.lib
+    /link /SUBSYSTEM:WINDOWS /LIBPATH:"%CURL_LIB%" libcurl.lib %ZLIB_LIB% ws2_32.lib user32.lib gdi32.lib comctl32.lib shell32.lib ole32.lib
 
 if %errorlevel% neq 0 (
     echo.
@@ -2,26 +2,43 @@
 
 #include "ollama_client.hpp"
 #include "file_manager.hpp"
+#include "response_parser.hpp"
+#include "event_queue.hpp"
+#include "workspace_watcher.hpp"
+#include "file_writer.hpp"
+#include "embedding_index.hpp"
+#include "summary_cache.hpp"
+#include "context_minifier.hpp"
+#include "context_dedup.hpp"
+#include "checkpoint_log.hpp"
 #include <string>
 #include <vector>
 #include <regex>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 
 namespace ollama_agent {
 
-// Represents a parsed file from LLM response
-struct ParsedFile {
-    std::string filename;
-    std::string content;
-    std::string language;
-};
-
 // Callback type for output messages
 using OutputCallback = std::function<void(const std::string& message)>;
 
+// Limits on the project files sent with each request
+struct ContextLimits {
+    size_t maxFiles = 20;
+    size_t maxFileBytes = 30000;     // Larger files are truncated
+    size_t truncatedBytes = 1000;    // Bytes kept of a truncated file
+    size_t sectionBytes = 8000;      // Bytes of sections sent of a file too large to send whole
+    size_t summaryBytes = 16000;     // Budget for summaries of the files left out
+    size_t maxTotalBytes = 0;        // Budget for all files together (0 = unlimited)
+};
+
 class Agent {
 public:
     Agent(OllamaClient& client, FileManager& fileManager);
+    ~Agent();
     
     // Process a user request
     bool processRequest(const std::string& userRequest);
@@ -38,17 +55,148 @@ public:
     // Set output callback for GUI integration
     void setOutputCallback(OutputCallback callback);
     
+    // Publish output as events on a queue drained by the caller; output falls
+    // back to the callback/stdout only while the queue is full
+    void setEventQueue(std::shared_ptr<AgentEventQueue> queue);
+    
+    // Use a different client for subsequent requests (e.g. one leased from a pool)
+    void setClient(OllamaClient& client);
+    
     // Get conversation history summary
     std::string getContextSummary() const;
+    
+    // Set the limits on project files sent as context
+    void setContextLimits(const ContextLimits& limits);
+    
+    // Get the limits on project files sent as context
+    const ContextLimits& getContextLimits() const;
+    
+    // Take the project files from a watched index instead of walking the
+    // directory on every request; the context is rebuilt only after changes
+    void setWorkspaceWatcher(std::shared_ptr<WorkspaceWatcher> watcher);
+    
+    // Write generated files through a shared writer stage (one is created
+    // on first use otherwise)
+    void setFileWriter(std::shared_ptr<FileWriter> writer);
+    
+    // Pick the project files for a request by embedding similarity once they
+    // no longer all fit the context limits; files too large to send whole
+    // contribute their best chunks (empty model disables)
+    void setRetrieval(const std::string& embedModel, size_t topK = 8);
+    
+    // Get the embedding model used for retrieval (empty = disabled)
+    std::string getRetrievalModel() const;
+    
+    // List the project files left out of the context with a cached summary
+    // each, instead of dropping them (nullptr disables)
+    void setSummaryCache(std::shared_ptr<SummaryCache> cache);
+    
+    // Send files of these languages minified (see minifyForPrompt); the
+    // files on disk are not touched
+    void setMinify(const std::set<std::string>& languages);
+    
+    // Get the languages whose files are sent minified
+    const std::set<std::string>& getMinify() const;
+    
+    // Send blocks repeated across files (shared <head>, nav bar, footer)
+    // once and reference them from each file (see deduplicateBlocks);
+    // references left in the response are expanded before writing. Files
+    // are then read up front rather than streamed; off by default
+    void setDeduplication(bool enabled);
+    
+    // Check if shared blocks are deduplicated
+    bool isDeduplication() const;
+    
+    // Race each request across several models and keep the first valid response
+    // (fewer than two models disables racing)
+    void setRaceModels(const std::vector<std::string>& models);
+    
+    // Get the models used for racing
+    std::vector<std::string> getRaceModels() const;
+    
+    // Request files as JSON through a schema instead of scraping markdown
+    // (takes precedence over racing)
+    void setStructuredOutput(bool enabled);
+    
+    // Check if structured output mode is enabled
+    bool isStructuredOutput() const;
+    
+    // Plan the files first, then generate each file with its own request,
+    // up to maxParallel at once (0 disables; takes precedence over racing)
+    void setFanOut(int maxParallel);
+    
+    // Get the number of concurrent per-file requests (0 = disabled)
+    int getFanOut() const;
+    
+    // Stream responses and stop generation once all files are complete
+    // (fences closed, files named in the request present) instead of
+    // paying for the model's trailing explanation; requests that name no
+    // files run to the end
+    void setEarlyStop(bool enabled);
+    
+    // Check if early stop is enabled
+    bool isEarlyStop() const;
+    
+    // Log streamed output to disk so an interrupted reply is continued, not
+    // re-run: a dropped stream is resumed at once, and output left by a run
+    // that died is picked up when the same request is sent again (nullptr
+    // disables; plain and early-stop requests only)
+    void setCheckpointLog(std::shared_ptr<CheckpointLog> log);
+    
+    // Enable prompt prefill (see startPrefill)
+    void setPrefill(bool enabled);
+    
+    // Check if prompt prefill is enabled
+    bool isPrefill() const;
+    
+    // While waiting for the next request, have Ollama evaluate the system
+    // prompt and project context ahead of time: a request that generates a
+    // single token is sent in the background with the same prefix and
+    // re-sent whenever the workspace changes or a summary lands, so the real
+    // request only evaluates its own text. Skipped when disabled and with
+    // retrieval, racing and fan-out, whose prompts depend on the request,
+    // and while the context has sections picked by the request. Status goes
+    // to the event queue only. The server doesn't use it.
+    void startPrefill();
+    
+    // Cancel the prefill; call before any other use of the agent
+    void stopPrefill();
 
 private:
-    OllamaClient& client_;
+    OllamaClient* client_;
     FileManager& fileManager_;
     std::string lastResponse_;
     std::vector<std::string> createdFiles_;
     bool verbose_ = false;
     std::string contextSummary_;
     OutputCallback outputCallback_;
+    std::shared_ptr<AgentEventQueue> eventQueue_;
+    mutable std::atomic<size_t> droppedStatus_{0};   // Status lines the full queue could not take
+    std::vector<std::string> raceModels_;
+    bool structuredOutput_ = false;
+    ContextLimits contextLimits_;
+    bool earlyStop_ = false;
+    std::shared_ptr<CheckpointLog> checkpointLog_;
+    bool prefill_ = false;
+    std::thread prefillThread_;
+    std::mutex prefillMutex_;
+    std::condition_variable prefillWake_;
+    bool prefillStop_ = false;                   // Guarded by prefillMutex_
+    int fanOut_ = 0;
+    std::shared_ptr<WorkspaceWatcher> watcher_;
+    std::shared_ptr<FileWriter> fileWriter_;
+    std::unique_ptr<EmbeddingIndex> embeddingIndex_;
+    size_t retrievalTopK_ = 8;
+    std::shared_ptr<SummaryCache> summaryCache_;
+    std::set<std::string> minifyLanguages_;
+    bool deduplicate_ = false;
+    std::map<std::string, std::string> sharedBlocks_;  // Blocks referenced by the cached context
+    mutable RequestBody cachedContext_;          // Context for cachedGeneration_
+    mutable uint64_t cachedGeneration_ = 0;
+    mutable bool contextCached_ = false;
+    mutable std::string cachedRequest_;          // Request the cached context was ranked for
+    mutable bool cachedSectioned_ = false;       // Last context built has request-picked sections
+    mutable uint64_t cachedSummaryVersion_ = 0;  // Summaries the cached context was built with
     
     // Build the system prompt for the agent
     std::string buildSystemPrompt() const;
@@ -65,20 +213,63 @@ private:
     // Extract thinking/explanation from response
     std::string extractExplanation(const std::string& response) const;
     
-    // Helper to trim whitespace from strings
-    std::string trimString(const std::string& str) const;
+    // Build the project-file context for the LLM; file contents are
+    // referenced by path and streamed from disk when the request is sent
+    RequestBody getExistingFilesContext(const std::string& userRequest);
     
-    // Helper to extract filename from text with markdown formatting
-    std::string extractFilenameFromText(const std::string& text) const;
+    // Build the user message: the project context first, so it is a prefix
+    // shared by all requests until the workspace changes, then the request
+    RequestBody buildUserMessage(const RequestBody& existingFiles, const std::string& userRequest) const;
     
-    // Helper to check if a string looks like a valid filename
-    bool looksLikeFilename(const std::string& text) const;
+    // Send the prompt prefix, and again whenever the workspace changes,
+    // until stopPrefill (config is the connection of the agent's client)
+    void prefillLoop(OllamaConfig config);
     
-    // Read existing files and build context for the LLM
-    std::string getExistingFilesContext() const;
+    // Keep the files most similar to the request, best first, and collect
+    // their matching chunks (keeps directory order if retrieval fails)
+    void selectRelevantFiles(std::vector<WorkspaceEntry>& files, const std::string& userRequest,
+                             std::map<std::string, std::vector<ContextChunk>>& excerpts);
     
-    // Output a message (to callback if set, otherwise stdout)
+    // Append the files left out of the context with their summaries
+    void appendSummaries(RequestBody& context, const std::vector<WorkspaceEntry>& files) const;
+    
+    // Append a large file as an outline of its sections plus the sections
+    // relevant to the request (the retrieved ones if given, otherwise those
+    // sharing words with it), up to maxBytes; returns the bytes sent
+    size_t appendSections(RequestBody& context, const WorkspaceEntry& file, const std::string& userRequest,
+                          const std::vector<ContextChunk>* retrieved, size_t maxBytes) const;
+    
+    // Merge section replacements ("path#ID") into their current files;
+    // whole files pass through unchanged
+    std::vector<ParsedFile> applySectionEdits(const std::vector<ParsedFile>& files, bool& allSuccess) const;
+    
+    // Replace shared block references in the files with the blocks last sent
+    std::vector<ParsedFile> expandSharedBlocks(const std::vector<ParsedFile>& files) const;
+    
+    // Send the request to all race models concurrently, aborting the rest
+    // once one response passes validation
+    std::string raceChat(const std::string& systemPrompt, const RequestBody& fullRequest,
+                         const std::string& userRequest);
+    
+    // Request a file plan, then generate the planned files concurrently and
+    // assemble them as one response ("" if the plan has fewer than two files)
+    std::string fanOutChat(const std::string& systemPrompt, const RequestBody& fullRequest);
+    
+    // Stream a markdown request, cutting it off once the response is complete
+    // (with early stop) and continuing it from the checkpoint log (if set)
+    std::string streamedChat(const std::string& systemPrompt, const RequestBody& fullRequest,
+                             const std::string& userRequest);
+    
+    // Stream a structured-output request, decoding files as they complete
+    std::string structuredChat(const std::string& systemPrompt, const RequestBody& fullRequest,
+                               std::vector<ParsedFile>& files);
+    
+    // Output a message (to the event queue, callback if set, otherwise stdout)
     void outputMessage(const std::string& message) const;
+    
+    // Push a typed event if a queue is set; returns false if it was not queued
+    bool publishEvent(AgentEventType type, const std::string& text,
+                      const GenerationStats& stats = GenerationStats{}) const;
 };
 
 } // namespace ollama_agent
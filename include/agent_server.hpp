@@ -0,0 +1,152 @@
+#pragma once
+
+#include "agent.hpp"
+#include "ollama_client.hpp"
+#include "file_manager.hpp"
+#include "file_writer.hpp"
+#include "job_scheduler.hpp"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <deque>
+
+namespace ollama_agent {
+
+// Configuration for the headless agent server
+struct ServerConfig {
+    std::string bindAddress = "127.0.0.1";
+    int port = 11500;
+    int workerThreads = 4;           // Connections handled concurrently
+    int clientPoolSize = 2;          // Ollama requests in flight at once
+    std::string defaultWorkingDir = ".";
+    SchedulerConfig scheduler;       // Admission limits; maxConcurrent follows clientPoolSize
+    ContextLimits contextLimits;     // Applied to every session's agent
+};
+
+// Pool of OllamaClient instances shared by all sessions
+class ClientPool {
+public:
+    // Borrowed client, returned to the pool on destruction
+    class Lease {
+    public:
+        Lease(ClientPool& pool, OllamaClient* client);
+        Lease(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+        
+        OllamaClient& operator*() const { return *client_; }
+        OllamaClient* operator->() const { return client_; }
+    
+    private:
+        ClientPool* pool_;
+        OllamaClient* client_;
+    };
+    
+    // Create size clients with the prototype's configuration, retry policy and cache
+    ClientPool(const OllamaClient& prototype, size_t size);
+    
+    // Borrow a client, blocking until one is free
+    Lease acquire();
+
+private:
+    std::vector<std::unique_ptr<OllamaClient>> clients_;
+    std::vector<OllamaClient*> idle_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+    
+    // Return a client to the pool
+    void release(OllamaClient* client);
+};
+
+// One client's working directory and conversation state
+struct Session {
+    std::string id;
+    std::string model;
+    std::unique_ptr<FileManager> fileManager;
+    std::unique_ptr<OllamaClient> idleClient;  // Bound to the agent between requests; never sends
+    std::unique_ptr<Agent> agent;
+    std::mutex mutex;                 // Serializes requests within the session
+    
+    // Status readable while a request runs, guarded by statusMutex
+    std::vector<std::string> output;  // Messages of the request in progress
+    std::string lastResponse;
+    size_t requestCount = 0;
+    bool busy = false;
+    std::mutex statusMutex;
+};
+
+// Minimal parsed HTTP request
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string body;
+};
+
+// Headless agent server exposing a local HTTP/JSON API.
+// Many clients (editors, CI jobs) create sessions, each with its own
+// FileManager working directory and agent state, and share one warm
+// process, a fixed worker pool and a pool of Ollama clients.
+//
+//   GET    /health                 - server status
+//   GET    /sessions               - list sessions
+//   POST   /sessions               - create {"workdir","model","structured","weight"}
+//   GET    /sessions/<id>          - session details and last response (never waits for a request)
+//   POST   /sessions/<id>/requests - run {"prompt","priority"}; returns files and output
+//   DELETE /sessions/<id>          - close a session
+class AgentServer {
+public:
+    AgentServer(const OllamaClient& prototype, const ServerConfig& config);
+    ~AgentServer();
+    
+    // Accept and serve connections until stop() is called.
+    // Returns false if the listening socket could not be opened.
+    bool run();
+    
+    // Ask the accept loop and workers to exit
+    void stop();
+    
+    // Get last error message
+    std::string getLastError() const;
+
+private:
+    ServerConfig config_;
+    std::string defaultModel_;
+    OllamaConfig clientConfig_;                   // Connection of the pooled clients
+    ClientPool clientPool_;
+    std::shared_ptr<FileWriter> fileWriter_;      // Shared by all sessions
+    JobScheduler scheduler_;
+    std::map<std::string, std::shared_ptr<Session>> sessions_;
+    std::mutex sessionsMutex_;
+    std::deque<long long> pendingConnections_;
+    std::mutex queueMutex_;
+    std::condition_variable queueReady_;
+    std::vector<std::thread> workers_;
+    std::atomic<bool> running_{false};
+    std::string lastError_;
+    
+    // Worker thread body: serve queued connections
+    void workerLoop();
+    
+    // Read one request from a connection, route it and write the response
+    void handleConnection(long long socket);
+    
+    // Dispatch a request; sets the HTTP status and returns a JSON body
+    std::string route(const HttpRequest& request, int& status);
+    
+    // Endpoint handlers
+    std::string createSession(const HttpRequest& request, int& status);
+    std::string listSessions();
+    std::string describeSession(const std::shared_ptr<Session>& session);
+    std::string runRequest(const std::shared_ptr<Session>& session, const HttpRequest& request, int& status);
+    
+    // Look up a session by id
+    std::shared_ptr<Session> findSession(const std::string& id);
+};
+
+} // namespace ollama_agent
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "request_body.hpp"
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <filesystem>
+
+namespace ollama_agent {
+
+// On-disk log of a streamed reply, so a generation cut off by a crash, a
+// dropped connection or a timeout can be continued instead of re-run.
+// Each request (model, system prompt and user content) has one log file;
+// every streamed delta is appended and flushed as it arrives, and the log
+// is removed once the reply is complete. Logs left behind are kept for a
+// week, then pruned.
+class CheckpointLog {
+public:
+    // directory defaults to defaultCacheDirectory()/checkpoints
+    explicit CheckpointLog(const std::string& directory = "");
+    ~CheckpointLog();
+    
+    CheckpointLog(const CheckpointLog&) = delete;
+    CheckpointLog& operator=(const CheckpointLog&) = delete;
+    
+    // Compute the key of a request; file segments are read to hash them
+    static std::string makeKey(const std::string& model, const std::string& systemPrompt,
+                               const RequestBody& userContent);
+    
+    // Get the output logged for a request by an unfinished run ("" if none)
+    std::string load(const std::string& key) const;
+    
+    // Start logging a request's output after what is already logged for it
+    bool open(const std::string& key);
+    
+    // Append a streamed delta and flush it to disk
+    void append(std::string_view delta);
+    
+    // Stop logging, keeping the log for a later resume (an empty log is removed)
+    void close();
+    
+    // Remove the log of a request whose reply is complete
+    void remove(const std::string& key);
+    
+    // Get the directory the logs are kept in
+    std::string getDirectory() const;
+    
+    // Get last error message
+    std::string getLastError() const;
+
+private:
+    std::filesystem::path directory_;
+    std::ofstream file_;
+    std::filesystem::path openPath_;  // Log being appended to
+    std::string lastError_;
+    
+    // Path of the log of a request
+    std::filesystem::path entryPath(const std::string& key) const;
+    
+    // Remove logs not written to for a week
+    void pruneStale();
+};
+
+} // namespace ollama_agent
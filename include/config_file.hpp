@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ollama_client.hpp"
+#include <string>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace ollama_agent {
+
+// Settings loaded once at startup from an INI-style file:
+//
+//   [agent]                  client-side settings (host, port, model, parallel, ...)
+//   host = 192.168.1.20
+//
+//   [model qwen2.5-coder]    profile for a model (exact name, name without tag, or *)
+//   num_ctx = 8192
+//   num_thread = 8
+//
+// '#' and ';' start comments (at line start or after whitespace).
+class ConfigFile {
+public:
+    // Load and parse a file; returns false if it can't be read or has an invalid line.
+    // [agent] values of the wrong type (or negative numbers) are left out
+    // with a warning, so the default applies.
+    bool load(const std::string& path);
+    
+    // Get an [agent] value as written
+    std::optional<std::string> getString(const std::string& key) const;
+    
+    // Get an [agent] value as an integer
+    std::optional<long long> getInt(const std::string& key) const;
+    
+    // Get an [agent] value as a boolean (true/false, yes/no, on/off, 1/0)
+    std::optional<bool> getBool(const std::string& key) const;
+    
+    // Get the model profiles, keyed by section name
+    const std::map<std::string, ModelProfile>& getProfiles() const;
+    
+    // Get the warnings about values ignored by the last load
+    const std::vector<std::string>& getWarnings() const;
+    
+    // Get last error message
+    std::string getLastError() const;
+
+private:
+    std::map<std::string, std::string> settings_;
+    std::vector<std::string> warnings_;
+    std::map<std::string, ModelProfile> profiles_;
+    std::string lastError_;
+    
+    // Store one key of a [model] section; returns false for unknown keys or bad values
+    static bool setProfileValue(ModelProfile& profile, const std::string& key, const std::string& value);
+    
+    // Check an [agent] value against its key's type; returns the problem ("" if valid)
+    static std::string checkAgentValue(const std::string& key, const std::string& value);
+};
+
+// Default config file location (XDG_CONFIG_HOME, APPDATA or ~/.config)
+std::string defaultConfigPath();
+
+} // namespace ollama_agent
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace ollama_agent {
+
+// 64-bit FNV-1a hash with an optional seed (offset basis)
+uint64_t fnv1a64(std::string_view data, uint64_t seed = 14695981039346656037ULL);
+
+// Incremental 128-bit content hasher (two independently seeded FNV-1a lanes)
+class ContentHasher {
+public:
+    ContentHasher();
+    
+    // Feed more data into the hash
+    void update(std::string_view data);
+    
+    // Get the hash as a 32-character hex string
+    std::string hexDigest() const;
+
+private:
+    uint64_t lo_;
+    uint64_t hi_;
+};
+
+// Hash a complete buffer and return it as a 32-character hex string
+std::string contentHash(std::string_view data);
+
+} // namespace ollama_agent
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+
+namespace ollama_agent {
+
+// A run of lines found verbatim in several files
+struct SharedBlock {
+    std::string id;                  // "B1", "B2", ...
+    std::string text;                // Whole lines, each ending with a line break
+    size_t uses = 0;
+};
+
+// Files with their shared blocks replaced by reference lines
+struct DeduplicatedFiles {
+    std::vector<SharedBlock> blocks;
+    std::vector<std::string> texts;  // One per input, in input order
+    std::vector<std::vector<size_t>> references;  // Blocks (indices) each text references
+};
+
+// Find runs of at least minLines lines and minBytes bytes that repeat
+// across the texts (the same <head>, nav bar or footer on every page)
+// and replace each with a reference line (see blockReference). Runs are
+// matched by rolling hashes of line windows and extended line by line;
+// a block is only kept if at least two places use it.
+DeduplicatedFiles deduplicateBlocks(const std::vector<std::string_view>& texts,
+                                    size_t minBytes = 200, size_t minLines = 3);
+
+// Get the reference line that stands for a block, e.g. "[[BLOCK B1]]"
+std::string blockReference(const std::string& id);
+
+// Replace reference lines in text with their blocks (keyed by ID); returns
+// false, leaving expanded untouched, if the text references no known block
+bool expandBlockReferences(std::string_view text, const std::map<std::string, std::string>& blocks,
+                           std::string& expanded);
+
+} // namespace ollama_agent
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <set>
+
+namespace ollama_agent {
+
+// Languages the prompt minifier handles ("html", "css", "js", "json", "py", "cpp")
+const std::vector<std::string>& minifyLanguages();
+
+// Get the minifier language of a file extension ("" if none applies)
+std::string minifyLanguageFor(std::string_view extension);
+
+// Parse a comma-separated language list ("all" selects every language);
+// names that are not minifier languages are returned in unknown
+std::set<std::string> parseMinifyLanguages(const std::string& list, std::vector<std::string>* unknown = nullptr);
+
+// Shrink a file for the prompt: drop indentation (except in Python),
+// trailing whitespace and runs of blank lines, never inside strings, <pre>
+// or <textarea>. Comments are kept, so a file the model rewrites from this
+// copy keeps them too. The result is for the model to read, not to be
+// written back.
+std::string minifyForPrompt(std::string_view text, std::string_view language);
+
+} // namespace ollama_agent
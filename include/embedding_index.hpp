@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ollama_client.hpp"
+#include "workspace_watcher.hpp"
+#include "section_chunker.hpp"
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+namespace ollama_agent {
+
+// A section of a project file that is embedded and retrieved on its own
+struct ContextChunk {
+    std::string relativePath;
+    std::string id;                  // Section ID (see splitIntoSections)
+    size_t offset = 0;
+    size_t length = 0;
+    std::string hash;                // Content hash of the chunk text (key of its vector)
+};
+
+// Chunk found by a query, with its cosine similarity to the query
+struct ChunkMatch {
+    ContextChunk chunk;
+    float score = 0.0f;
+};
+
+class VectorStore;
+
+// Vector index over project files for picking the context relevant to a
+// request. Files are split into sections, which are embedded through
+// Ollama's /api/embed in batches, and the vectors are kept in a
+// memory-mapped file keyed by section content hash, so unchanged text is
+// never embedded twice, across requests or sessions. Each workspace has its
+// own file, written under a file lock; vectors none of its files use any
+// more are dropped once they outnumber the others.
+class EmbeddingIndex {
+public:
+    // The vector file is that of the workspace (see defaultEmbeddingStorePath)
+    EmbeddingIndex(const std::string& model, const std::string& workspaceRoot);
+    ~EmbeddingIndex();
+    
+    EmbeddingIndex(const EmbeddingIndex&) = delete;
+    EmbeddingIndex& operator=(const EmbeddingIndex&) = delete;
+    
+    // Switch to the vector file of another workspace (no-op if unchanged)
+    void setWorkspace(const std::string& workspaceRoot);
+    
+    // Index exactly these files: re-chunk changed ones and embed chunks
+    // without a stored vector. Returns false if embedding failed.
+    bool update(OllamaClient& client, const std::vector<WorkspaceEntry>& files);
+    
+    // Get the k chunks most similar to the text (empty on failure)
+    std::vector<ChunkMatch> query(OllamaClient& client, const std::string& text, size_t k);
+    
+    // Get the embedding model
+    std::string getModel() const;
+    
+    // Get last error message
+    std::string getLastError() const;
+
+private:
+    struct FileChunks {
+        size_t size = 0;
+        std::filesystem::file_time_type mtime;
+        std::vector<ContextChunk> chunks;
+    };
+    
+    std::string model_;
+    std::string storePath_;
+    std::unique_ptr<VectorStore> store_;
+    std::map<std::string, FileChunks> files_;
+    std::string lastError_;
+    
+    // Embed texts in batches and store their vectors under the given hashes
+    // (one store write per call)
+    bool embedAndStore(OllamaClient& client, const std::vector<std::string>& hashes,
+                       const std::vector<std::string>& texts);
+};
+
+// Dot product of two float vectors (SIMD where available)
+float dotProduct(const float* a, const float* b, size_t count);
+
+// Vector file for a model and workspace, e.g.
+// <cache>/embeddings-nomic-embed-text-<hash of the root>.bin
+std::string defaultEmbeddingStorePath(const std::string& model, const std::string& workspaceRoot);
+
+} // namespace ollama_agent
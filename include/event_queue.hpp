@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ollama_client.hpp"
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace ollama_agent {
+
+// Kind of event emitted by the agent
+enum class AgentEventType {
+    Status,       // A line of user-facing output
+    TokenDelta,   // A chunk of streamed model output
+    FileWritten,  // A file was written; text holds the filename
+    Stats         // Generation statistics for the last request
+};
+
+// One event; only the fields relevant to its type are set
+struct AgentEvent {
+    AgentEventType type = AgentEventType::Status;
+    std::string text;
+    GenerationStats stats;
+};
+
+// Bounded lock-free queue of agent events.
+// The agent thread pushes without blocking or allocating a node; any
+// number of consumer threads (CLI loop, GUI timer) drain it in batches.
+// Each slot carries a sequence number that tells producer and consumers
+// whether it is free or filled, so no locks are needed on either side.
+class AgentEventQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit AgentEventQueue(size_t capacity = 1024);
+    
+    AgentEventQueue(const AgentEventQueue&) = delete;
+    AgentEventQueue& operator=(const AgentEventQueue&) = delete;
+    
+    // Push an event; returns false without blocking if the queue is full
+    bool tryPush(AgentEvent&& event);
+    
+    // Pop one event; returns false if the queue is empty
+    bool tryPop(AgentEvent& event);
+    
+    // Pop up to maxEvents events into out (appended); returns the number popped
+    size_t drain(std::vector<AgentEvent>& out, size_t maxEvents = 256);
+    
+    // Check if the queue is empty (approximate while other threads are active)
+    bool empty() const;
+    
+    // Get the number of slots
+    size_t capacity() const;
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        AgentEvent event;
+    };
+    
+    std::unique_ptr<Slot[]> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueuePos_{0};
+    alignas(64) std::atomic<size_t> dequeuePos_{0};
+};
+
+} // namespace ollama_agent
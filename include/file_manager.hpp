@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <filesystem>
 
@@ -24,7 +25,7 @@ public:
     std::string getWorkingDirectory() const;
     
     // Create a file with content
-    bool createFile(const std::string& relativePath, const std::string& content);
+    bool createFile(const std::string& relativePath, std::string_view content);
     
     // Read a file's content
     std::string readFile(const std::string& relativePath) const;
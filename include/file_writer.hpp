@@ -0,0 +1,86 @@
+#pragma once
+
+#include "response_parser.hpp"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <filesystem>
+#include <cstdint>
+
+namespace ollama_agent {
+
+// Outcome of writing one file
+struct WriteResult {
+    std::string filename;
+    size_t bytes = 0;
+    bool success = false;
+    std::string error;
+};
+
+class UringQueue;
+
+// Background stage that writes batches of generated files.
+// Every file is written to a hidden temporary next to it, flushed with
+// fsync and renamed over the target, so readers never see a half-written
+// file. On Linux a batch is submitted to io_uring as linked
+// open/write/fsync/close/rename chains, many files per system call;
+// without io_uring a pool of threads writes files in parallel.
+class FileWriter {
+public:
+    // threads is the pool size used when io_uring is unavailable
+    explicit FileWriter(size_t threads = 4);
+    ~FileWriter();
+    
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+    
+    // Queue files for writing below workDir; returns the batch id.
+    // A filename given more than once is written once, with its last
+    // content. The files keep their response storage alive until written.
+    uint64_t submit(const std::filesystem::path& workDir, const std::vector<ParsedFile>& files);
+    
+    // Wait for the next file of a batch to finish; returns false once every
+    // result of the batch has been handed out
+    bool nextResult(uint64_t batchId, WriteResult& result);
+    
+    // Get the active backend ("io_uring" or "threads")
+    std::string getBackendName() const;
+
+private:
+    struct Batch {
+        std::filesystem::path workDir;
+        std::vector<ParsedFile> files;
+        std::deque<WriteResult> finished;
+        size_t pending = 0;
+    };
+    
+    // Consecutive files of a batch handled by one worker
+    struct Job {
+        std::shared_ptr<Batch> batch;
+        size_t first;
+        size_t count;
+    };
+    
+    std::unique_ptr<UringQueue> uring_;
+    std::vector<std::thread> workers_;
+    std::deque<Job> jobs_;
+    std::map<uint64_t, std::shared_ptr<Batch>> batches_;
+    uint64_t nextBatchId_ = 1;
+    bool stopping_ = false;
+    mutable std::mutex mutex_;
+    std::condition_variable jobReady_;
+    std::condition_variable resultReady_;
+    
+    // Take jobs until the writer is destroyed
+    void workerLoop();
+    
+    // Hand a finished file back to the batch's consumer
+    void finish(Batch& batch, WriteResult&& result);
+};
+
+} // namespace ollama_agent
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <filesystem>
+
+namespace ollama_agent {
+
+// Compiled .gitignore-style rules (also read from .agentignore):
+//
+//   node_modules/     directory anywhere in the tree
+//   /config.local.js  anchored to the directory of the ignore file
+//   docs/**/*.tmp     '*', '?', '[a-z]' and '**' globs
+//   !dist/keep.js     later negated rules re-include a path
+//
+// Literal rules are looked up by name or path in hash tables; only glob
+// rules run the matcher. Parent directories are not checked again: walks
+// are expected to skip the contents of ignored directories.
+class IgnoreRules {
+public:
+    // Add the built-in rules for dependency and build output directories
+    void addDefaults();
+    
+    // Add one pattern; baseDir is the directory of the file it came from
+    // (relative to the root, "" for the root itself)
+    void addPattern(const std::string& pattern, const std::string& baseDir = "");
+    
+    // Add every pattern of an ignore file; returns false if it can't be read
+    bool loadFile(const std::filesystem::path& path, const std::string& baseDir = "");
+    
+    // Add the .gitignore and .agentignore of a directory below root, if present
+    void loadDirectory(const std::filesystem::path& root, const std::string& relativeDir = "");
+    
+    // Check if a path (relative to the root, forward slashes) is ignored
+    bool isIgnored(const std::string& relativePath, bool isDirectory) const;
+    
+    // Check if no rules were added
+    bool empty() const;
+
+private:
+    enum class TokenType { Literal, AnyChar, Star, DoubleStar, DirStar, CharClass };
+    
+    struct Token {
+        TokenType type = TokenType::Literal;
+        char literal = 0;
+        std::vector<std::pair<char, char>> ranges;   // CharClass
+        bool negatedClass = false;
+    };
+    
+    struct GlobRule {
+        size_t index;                 // Position among all rules; the last match wins
+        std::vector<Token> tokens;
+        std::string baseDir;
+        bool anchored;                // Matched against the path, not the name
+        bool directoryOnly;
+        bool negated;
+    };
+    
+    // Last rule index of a literal, for any entry and for directories only
+    struct LiteralRule {
+        long anyEntry = -1;
+        long directory = -1;
+        bool anyNegated = false;
+        bool directoryNegated = false;
+    };
+    
+    std::unordered_map<std::string, LiteralRule> literalNames_;   // Unanchored root rules
+    std::unordered_map<std::string, LiteralRule> literalPaths_;   // Anchored root rules
+    std::vector<GlobRule> globRules_;
+    size_t ruleCount_ = 0;
+    
+    // Compile a glob into matcher tokens
+    static std::vector<Token> compile(const std::string& glob);
+    
+    // Run the compiled glob over text (NFA simulation, no backtracking)
+    static bool matches(const std::vector<Token>& tokens, const std::string& text);
+};
+
+} // namespace ollama_agent
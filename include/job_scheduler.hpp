@@ -0,0 +1,109 @@
+#pragma once
+
+#include "ollama_client.hpp"
+#include <string>
+#include <map>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+namespace ollama_agent {
+
+// Scheduling class of a generation job
+enum class JobPriority {
+    Interactive,  // A user is waiting on the result
+    Batch         // Background work (CI, bulk generation)
+};
+
+// Limits applied by the JobScheduler
+struct SchedulerConfig {
+    int maxConcurrent = 1;                   // Jobs running against the backend at once
+    int defaultModelConcurrency = 1;         // Jobs per model unless overridden
+    std::map<std::string, int> modelConcurrency;
+    int maxModelStreak = 4;                  // Consecutive same-model dispatches while other models wait
+};
+
+// Admission control in front of one Ollama backend.
+// Jobs wait until a slot is free, then are dispatched in this order:
+//   1. interactive before batch
+//   2. the model that is already loaded, to avoid model swaps (bounded by maxModelStreak)
+//   3. weighted fair queuing across sessions (smallest virtual finish time)
+class JobScheduler {
+public:
+    // Running slot, released when destroyed
+    class Ticket {
+    public:
+        Ticket() = default;
+        Ticket(JobScheduler* scheduler, const std::string& model);
+        Ticket(Ticket&& other) noexcept;
+        Ticket& operator=(Ticket&& other) noexcept;
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+        ~Ticket();
+        
+        // False if admission was cancelled
+        explicit operator bool() const { return scheduler_ != nullptr; }
+        
+        // Release the slot early
+        void release();
+    
+    private:
+        JobScheduler* scheduler_ = nullptr;
+        std::string model_;
+    };
+    
+    explicit JobScheduler(const SchedulerConfig& config = SchedulerConfig{});
+    
+    // Wait for a slot for a job of the given session and model.
+    // Returns an empty ticket if the token is cancelled while queued.
+    Ticket admit(const std::string& sessionId, const std::string& model,
+                 JobPriority priority = JobPriority::Interactive,
+                 const CancellationToken* token = nullptr);
+    
+    // Relative share of a session under contention (default 1.0)
+    void setSessionWeight(const std::string& sessionId, double weight);
+    
+    // Forget per-session accounting
+    void removeSession(const std::string& sessionId);
+    
+    // Statistics
+    size_t getQueuedCount() const;
+    size_t getRunningCount() const;
+    std::string getLoadedModel() const;
+
+private:
+    struct Job {
+        uint64_t sequence;
+        std::string sessionId;
+        std::string model;
+        JobPriority priority;
+        double virtualStart;
+        double virtualFinish;
+        bool granted = false;
+    };
+    
+    SchedulerConfig config_;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::list<Job> queue_;
+    std::map<std::string, int> runningPerModel_;
+    int running_ = 0;
+    std::map<std::string, double> sessionWeights_;
+    std::map<std::string, double> sessionFinish_;
+    double virtualTime_ = 0.0;
+    std::string loadedModel_;
+    int modelStreak_ = 0;
+    uint64_t nextSequence_ = 0;
+    
+    // Grant slots to as many queued jobs as the limits allow (mutex held)
+    void dispatch();
+    
+    // Concurrency cap for a model
+    int modelLimit(const std::string& model) const;
+    
+    // Called by Ticket
+    void release(const std::string& model);
+};
+
+} // namespace ollama_agent
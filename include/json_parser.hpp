@@ -1,12 +1,32 @@
 #pragma once
 
+#include "request_body.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <optional>
 
 namespace ollama_agent {
 
+// Model parameters sent in a request's "options" object (unset = model default)
+struct GenerationOptions {
+    std::optional<int> numCtx;          // Context window in tokens
+    std::optional<int> numPredict;      // Maximum tokens to generate (-1 = unlimited)
+    std::optional<int> numThread;       // CPU threads used for inference
+    std::optional<double> temperature;
+    
+    // Check if no parameter is set
+    bool empty() const;
+};
+
+// Optional fields shared by generate and chat requests
+struct RequestOptions {
+    std::string keepAlive;  // How long the model stays loaded, e.g. "30m" (empty = server default)
+    std::string format;     // Raw JSON for "format": "json" or a JSON schema (empty = free text)
+    GenerationOptions generation;
+};
+
 // Simple JSON parser for handling Ollama API responses
 class JsonParser {
 public:
@@ -16,29 +36,51 @@ public:
     // Parse a JSON string and extract a boolean value by key
     static std::optional<bool> getBool(const std::string& json, const std::string& key);
     
+    // Parse a JSON string and extract an integer value by key
+    static std::optional<long long> getInt(const std::string& json, const std::string& key);
+    
     // Parse streaming response to extract content
     static std::string extractStreamContent(const std::string& response);
     
     // Build a JSON object for Ollama API request
     static std::string buildRequest(const std::string& model, 
                                    const std::string& prompt,
-                                   bool stream = false);
+                                   bool stream = false,
+                                   const RequestOptions& options = RequestOptions{});
     
     // Build a chat request with system prompt
     static std::string buildChatRequest(const std::string& model,
                                         const std::string& systemPrompt,
                                         const std::string& userMessage,
-                                        bool stream = false);
-
-private:
+                                        bool stream = false,
+                                        const RequestOptions& options = RequestOptions{});
+    
+    // Build a chat request whose user message is produced from segments
+    // (e.g. files streamed from disk) while it is sent; a non-empty
+    // assistantPrefix is sent as a final assistant message for the model
+    // to continue
+    static RequestBody buildChatRequestBody(const std::string& model,
+                                            const std::string& systemPrompt,
+                                            const RequestBody& userContent,
+                                            bool stream = false,
+                                            const RequestOptions& options = RequestOptions{},
+                                            const std::string& assistantPrefix = "");
+    
     // Helper to escape JSON strings
     static std::string escapeJson(const std::string& input);
     
+    // Append input to out, escaped as the contents of a JSON string
+    static void appendEscapedJson(std::string& out, std::string_view input);
+
+private:
     // Helper to find value position after key
     static size_t findValueStart(const std::string& json, const std::string& key);
     
     // Extract string value starting at position
     static std::string extractString(const std::string& json, size_t startPos);
+    
+    // Serialize the optional request fields (each prefixed with a comma)
+    static std::string buildOptionFields(const RequestOptions& options);
 };
 
 } // namespace ollama_agent
@@ -1,22 +1,106 @@
 #pragma once
 
+#include "response_cache.hpp"
+#include "json_parser.hpp"
 #include <string>
 #include <functional>
 #include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <thread>
 
 namespace ollama_agent {
 
+// Per-model request settings, e.g. from a [model <name>] config section
+struct ModelProfile {
+    GenerationOptions options;
+    std::string keepAlive;           // Overrides OllamaConfig::keepAlive when set
+};
+
 // Configuration for Ollama connection
 struct OllamaConfig {
     std::string host = "127.0.0.1";
     int port = 11434;
     std::string model = "llama3.2";  // Default model
     int timeoutSeconds = 120;
+    std::string keepAlive = "30m";   // How long Ollama keeps the model loaded after a request
+    bool compressRequests = false;   // Gzip large request bodies (for remote hosts)
+    size_t compressMinBytes = 32 * 1024;  // Bodies smaller than this are sent as-is
+    int modelListTtlSeconds = 0;     // Reuse the model list cached on disk this long (0 = always query)
+    std::map<std::string, ModelProfile> profiles;  // Keyed by model name, name without tag, or "*"
+};
+
+// Find the profile for a model: exact name, then the name without its
+// ":tag", then the "*" fallback (nullptr if none applies)
+const ModelProfile* findModelProfile(const std::map<std::string, ModelProfile>& profiles,
+                                     const std::string& model);
+
+// Timing and token statistics reported by Ollama for a completed request
+struct GenerationStats {
+    long long totalMs = 0;
+    long long loadMs = 0;            // Time spent loading the model (cold start)
+    long long promptEvalCount = 0;
+    long long promptEvalMs = 0;
+    long long evalCount = 0;
+    long long evalMs = 0;
+    bool valid = false;
+};
+
+// Retry behaviour for requests that fail with transient errors
+struct RetryPolicy {
+    int maxAttempts = 4;              // Total attempts, including the first
+    int initialBackoffMs = 500;       // Delay before the first retry
+    int maxBackoffMs = 8000;          // Upper bound for a single delay
+    double backoffMultiplier = 2.0;   // Growth factor between retries
+    int deadlineSeconds = 0;          // Budget for all attempts together (0 = none)
+};
+
+// Classification of the last request failure
+enum class RequestError {
+    None,
+    ConnectFailed,  // Connection refused/reset before any data arrived (retryable)
+    ServerBusy,     // HTTP 429/502/503/504, e.g. while a model is swapped (retryable)
+    HttpError,      // Any other HTTP error status
+    Timeout,        // Transfer timeout or request deadline exceeded
+    Cancelled,      // Cancelled through a CancellationToken
+    Aborted,        // Stream callback asked to stop
+    Other
+};
+
+// Result of the background availability check
+enum class Availability {
+    Unknown,        // Check not started or still running
+    Available,
+    Unavailable
+};
+
+// Shared flag used to cancel in-flight requests from another thread.
+// Copies share state, so a token handed to a client can be cancelled
+// by whoever kept the original.
+class CancellationToken {
+public:
+    CancellationToken();
+    
+    // Request cancellation (safe to call from any thread or signal handler)
+    void cancel();
+    
+    // Check if cancellation was requested
+    bool isCancelled() const;
+    
+    // Clear the cancellation flag for reuse
+    void reset();
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_;
 };
 
 // Callback for streaming responses
 using StreamCallback = std::function<void(const std::string& chunk)>;
 
+// Callback for streamed chat content; return false to abort the transfer
+using ChatStreamCallback = std::function<bool(const std::string& chunk)>;
+
 class OllamaClient {
 public:
     explicit OllamaClient(const OllamaConfig& config = OllamaConfig{});
@@ -25,8 +109,19 @@ public:
     // Check if Ollama is available
     bool isAvailable();
     
-    // List available models
-    std::vector<std::string> listModels();
+    // List available models. With modelListTtlSeconds set, a fresh copy cached
+    // on disk is returned without a request (unless allowCached is false);
+    // every successful query refreshes that copy.
+    std::vector<std::string> listModels(bool allowCached = true);
+    
+    // Get the model list cached on disk (empty if disabled, missing or expired)
+    std::vector<std::string> getCachedModels() const;
+    
+    // Check availability on a background thread; also refreshes the cached model list
+    void checkAvailabilityAsync();
+    
+    // Get the result of the background availability check
+    Availability getAvailability() const;
     
     // Set the model to use
     void setModel(const std::string& model);
@@ -34,27 +129,178 @@ public:
     // Get current model
     std::string getModel() const;
     
+    // Get the connection configuration
+    const OllamaConfig& getConfig() const;
+    
     // Send a prompt and get response (blocking)
     std::string generate(const std::string& prompt);
     
-    // Send a chat message with system prompt
-    std::string chat(const std::string& systemPrompt, const std::string& userMessage);
+    // Send a chat message with system prompt. A non-empty format (raw JSON:
+    // "json" or a JSON schema) requests structured output.
+    std::string chat(const std::string& systemPrompt, const std::string& userMessage,
+                     const std::string& format = "");
+    
+    // Send a chat message whose content is produced from segments (e.g. project
+    // files read from disk while the request is sent)
+    std::string chat(const std::string& systemPrompt, const RequestBody& userContent,
+                     const std::string& format = "");
     
     // Send a prompt with streaming callback
     void generateStream(const std::string& prompt, StreamCallback callback);
     
+    // Send a chat message and stream the reply; returns all content received.
+    // Complete replies go through the response cache like chat(), and a
+    // cached one is delivered to the callback in a single piece.
+    std::string chatStream(const std::string& systemPrompt, const std::string& userMessage,
+                           ChatStreamCallback callback, const std::string& format = "");
+    
+    // Streamed chat with segmented message content
+    std::string chatStream(const std::string& systemPrompt, const RequestBody& userContent,
+                           ChatStreamCallback callback, const std::string& format = "");
+    
+    // Continue a streamed reply that was cut off: assistantPrefix (the output
+    // received so far) is sent as the start of the reply, so the model picks
+    // up where it ended. Returns only the new content.
+    std::string continueChatStream(const std::string& systemPrompt, const RequestBody& userContent,
+                                   const std::string& assistantPrefix, ChatStreamCallback callback,
+                                   const std::string& format = "");
+    
     // Get last error message
     std::string getLastError() const;
+    
+    // Get statistics of the last completed generate/chat request (invalid
+    // when it was served from the response cache)
+    GenerationStats getLastStats() const;
+    
+    // Load a model into memory ahead of use (empty generate with keep_alive).
+    // Returns false if the model could not be loaded.
+    bool preloadModel(const std::string& model);
+    
+    // Preload a model on a background thread, replacing any pending preload
+    void preloadModelAsync(const std::string& model);
+    
+    // Evaluate a chat prompt while generating a single token (num_predict 1:
+    // Ollama does not honor 0), so it keeps the prompt in its cache and a
+    // later request sharing the prefix only evaluates the rest. Never
+    // cached; returns false on failure.
+    bool prefillChat(const std::string& systemPrompt, const RequestBody& userContent);
+    
+    // Check if a background preload is still running
+    bool isPreloading() const;
+    
+    // Get the load time measured by the last completed preload (-1 = none yet)
+    long long getLastPreloadMs() const;
+    
+    // List models currently loaded in Ollama's memory (/api/ps)
+    std::vector<std::string> listLoadedModels();
+    
+    // Embed texts with an embedding model (/api/embed); one vector per input,
+    // or an empty result on failure
+    std::vector<std::vector<float>> embed(const std::string& model, const std::vector<std::string>& inputs);
+    
+    // Attach an on-disk response cache for chat/generate (nullptr disables caching)
+    void setResponseCache(std::shared_ptr<ResponseCache> cache);
+    
+    // Get the attached response cache (may be nullptr)
+    std::shared_ptr<ResponseCache> getResponseCache() const;
+    
+    // Skip cache lookups; fresh responses are still stored
+    void setCacheBypass(bool bypass);
+    
+    // Check if the last chat/generate response was served from the cache
+    bool wasLastResponseCached() const;
+    
+    // Set the retry/backoff policy for generation requests
+    void setRetryPolicy(const RetryPolicy& policy);
+    
+    // Get the retry/backoff policy
+    const RetryPolicy& getRetryPolicy() const;
+    
+    // Set the token checked while requests are in flight
+    void setCancellationToken(const CancellationToken& token);
+    
+    // Get the token checked while requests are in flight
+    const CancellationToken& getCancellationToken() const;
+    
+    // Get the kind of the last failure
+    RequestError getLastErrorKind() const;
+    
+    // Get the number of attempts the last request took
+    int getLastAttemptCount() const;
+    
+    // Check if request-body compression was compiled in (zlib)
+    static bool supportsCompression();
 
 private:
+    // Receives response body bytes; return false to abort the transfer
+    using BodySink = std::function<bool(const char* data, size_t size)>;
+    
     OllamaConfig config_;
     std::string lastError_;
+    std::shared_ptr<ResponseCache> cache_;
+    bool cacheBypass_ = false;
+    bool lastResponseCached_ = false;
+    RetryPolicy retryPolicy_;
+    CancellationToken cancelToken_;
+    RequestError lastErrorKind_ = RequestError::None;
+    int lastAttemptCount_ = 0;
+    long lastHttpStatus_ = 0;
+    GenerationStats lastStats_;
+    
+    // Background preload state
+    std::thread preloadThread_;
+    CancellationToken preloadToken_;
+    std::atomic<bool> preloading_{false};
+    std::atomic<long long> lastPreloadMs_{-1};
+    
+    // Background availability check state
+    std::thread healthThread_;
+    CancellationToken healthToken_;
+    std::atomic<Availability> availability_{Availability::Unknown};
+    
+    // Build optional request fields from the configuration and the model's profile
+    RequestOptions requestOptions(const std::string& model, const std::string& format = "") const;
+    
+    // Extract model names from a /api/tags or /api/ps response
+    static std::vector<std::string> parseModelNames(const std::string& response);
+    
+    // Extract the vectors of an /api/embed response
+    static std::vector<std::vector<float>> parseEmbeddings(const std::string& response);
+    
+    // Extract timing statistics from a final response object
+    static GenerationStats parseStats(const std::string& json);
     
     // Build the base URL
     std::string buildUrl(const std::string& endpoint) const;
     
+    // Perform an HTTP transfer (GET when body is null), retrying transient
+    // failures with exponential backoff until maxAttempts or the deadline.
+    // Retries stop once any response data was handed to the sink.
+    bool performTransfer(const std::string& url, const RequestBody* body,
+                         const BodySink& sink, int timeoutSeconds, int maxAttempts);
+    
+    // Perform a single transfer attempt, optionally gzip-compressing the body
+    RequestError transferOnce(const std::string& url, const RequestBody* body,
+                              const BodySink& sink, long timeoutMs, long long deadlineMs,
+                              bool compress, size_t& delivered);
+    
+    // Check if a body should be compressed (enabled, large enough, and not
+    // rejected by this host before)
+    bool shouldCompress(const RequestBody* body) const;
+    
+    // Sleep for a backoff delay; returns false if cancelled meanwhile
+    bool sleepUnlessCancelled(int milliseconds) const;
+    
+    // Stream a chat request, optionally continuing an assistant prefix
+    std::string streamChat(const std::string& systemPrompt, const RequestBody& userContent,
+                           const std::string& assistantPrefix, ChatStreamCallback callback,
+                           const std::string& format);
+    
     // Perform HTTP POST request
-    std::string httpPost(const std::string& url, const std::string& body);
+    std::string httpPost(const std::string& url, const RequestBody& body);
+    
+    // Perform HTTP POST request through the response cache
+    std::string cachedPost(const std::string& endpoint, const RequestBody& body);
     
     // Perform HTTP GET request
     std::string httpGet(const std::string& url);
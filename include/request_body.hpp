@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <cstddef>
+
+namespace ollama_agent {
+
+// HTTP request body assembled from segments and produced on demand.
+// File segments are read and JSON-escaped block by block while the body
+// is sent, so large project contexts never exist in memory as one string.
+class RequestBody {
+public:
+    // Append JSON text as-is
+    void appendRaw(const std::string& text);
+    
+    // Append text escaped as the contents of a JSON string
+    void appendEscaped(const std::string& text);
+    
+    // Append up to maxBytes of a file, escaped as the contents of a JSON string
+    void appendFile(const std::filesystem::path& path, size_t maxBytes);
+    
+    // Append all segments of another body
+    void append(const RequestBody& other);
+    
+    // Check if the body has no segments
+    bool empty() const;
+    
+    // Check if any segment is read from disk
+    bool hasFiles() const;
+    
+    // Get the size of the content before escaping (file segments count maxBytes)
+    size_t getSourceSize() const;
+    
+    // Produce the whole body as one string
+    std::string toString() const;
+    
+    // Sequential reader over a body; every transfer attempt uses its own
+    class Reader {
+    public:
+        explicit Reader(const RequestBody& body);
+        
+        // Fill up to size bytes; returns 0 at the end of the body
+        size_t read(char* buffer, size_t size);
+    
+    private:
+        const RequestBody& body_;
+        size_t segment_ = 0;
+        size_t offset_ = 0;          // Position within the current segment's source
+        std::ifstream file_;
+        bool fileOpen_ = false;
+        std::string pending_;        // Escaped output not yet handed out
+        size_t pendingPos_ = 0;
+        
+        // Produce the next block of the current segment into pending_
+        bool fillPending();
+    };
+
+private:
+    enum class SegmentKind { Raw, Escaped, File };
+    
+    struct Segment {
+        SegmentKind kind;
+        std::string text;
+        std::filesystem::path path;
+        size_t maxBytes = 0;
+    };
+    
+    std::vector<Segment> segments_;
+};
+
+} // namespace ollama_agent
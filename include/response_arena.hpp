@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <deque>
+
+namespace ollama_agent {
+
+// Append-only storage for text parsed out of one response.
+// Views returned by the arena stay valid for the arena's lifetime: chunks
+// are never reallocated once handed out, so parsed files can reference
+// their filename and content without owning copies.
+class ResponseArena {
+public:
+    explicit ResponseArena(size_t chunkSize = 64 * 1024);
+    
+    ResponseArena(const ResponseArena&) = delete;
+    ResponseArena& operator=(const ResponseArena&) = delete;
+    
+    // Take ownership of a string without copying it
+    std::string_view adopt(std::string&& text);
+    
+    // Copy text into the arena
+    std::string_view copy(std::string_view text);
+    
+    // Extend the open slice (contiguous with everything appended since the last commit)
+    void append(std::string_view text);
+    
+    // Close the open slice and return it
+    std::string_view commit();
+    
+    // Discard the open slice
+    void rollback();
+    
+    // Get the size of the open slice
+    size_t getOpenSize() const;
+    
+    // Get the total bytes held (including discarded slices)
+    size_t getBytesUsed() const;
+
+private:
+    size_t chunkSize_;
+    std::deque<std::string> chunks_;   // Each chunk keeps its reserved capacity
+    std::deque<std::string> adopted_;
+    size_t openStart_ = 0;             // Offset of the open slice in the last chunk
+    size_t bytesUsed_ = 0;
+};
+
+} // namespace ollama_agent
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "request_body.hpp"
+#include <string>
+#include <optional>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <filesystem>
+
+namespace ollama_agent {
+
+// Limits for the on-disk response cache
+struct ResponseCacheConfig {
+    std::string directory;                  // Empty = defaultCacheDirectory()/responses
+    size_t maxEntries = 512;
+    size_t maxBytes = 64 * 1024 * 1024;     // 64 MB
+};
+
+// Content-addressed on-disk cache of raw Ollama responses.
+// Entries are keyed by a hash of the endpoint and the serialized request body
+// (model, system prompt, file context and user text), so identical requests
+// are answered without a round-trip. The stored value is the raw API response,
+// which includes Ollama's timing and token statistics.
+class ResponseCache {
+public:
+    explicit ResponseCache(const ResponseCacheConfig& config = ResponseCacheConfig{});
+    
+    // Compute the cache key for a request
+    static std::string makeKey(const std::string& endpoint, const std::string& body);
+    
+    // Compute the cache key for a streamed request body (same key as its string form)
+    static std::string makeKey(const std::string& endpoint, const RequestBody& body);
+    
+    // Look up a stored response (marks it as most recently used)
+    std::optional<std::string> get(const std::string& key);
+    
+    // Store a response, evicting least recently used entries over the limits
+    bool put(const std::string& key, const std::string& response);
+    
+    // Remove all entries
+    void clear();
+    
+    // Get cache directory
+    std::string getDirectory() const;
+    
+    // Statistics
+    size_t getEntryCount() const;
+    size_t getTotalBytes() const;
+    size_t getHits() const;
+    size_t getMisses() const;
+
+private:
+    struct Entry {
+        std::string key;
+        size_t size = 0;
+    };
+    
+    ResponseCacheConfig config_;
+    std::filesystem::path directory_;
+    std::list<Entry> lru_;  // Front = most recently used
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t totalBytes_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    mutable std::mutex mutex_;
+    
+    // Load existing entries from disk, ordered by modification time
+    void loadIndex();
+    
+    // Evict entries until within limits (mutex must be held)
+    void evictLocked();
+    
+    // Path of the file backing an entry
+    std::filesystem::path entryPath(const std::string& key) const;
+};
+
+// Default per-user cache directory (XDG_CACHE_HOME, LOCALAPPDATA or ~/.cache)
+std::string defaultCacheDirectory();
+
+} // namespace ollama_agent
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "response_arena.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+
+namespace ollama_agent {
+
+// Represents a parsed file from LLM response.
+// The views point into the arena the file shares with the parser that
+// produced it; copies of a ParsedFile keep that arena alive.
+struct ParsedFile {
+    std::string_view filename;
+    std::string_view content;
+    std::string_view language;
+    std::shared_ptr<const ResponseArena> storage;
+};
+
+// Callback for parser diagnostics (verbose output)
+using ParserLogCallback = std::function<void(const std::string& message)>;
+
+// Incremental parser that extracts files from an LLM response.
+// Text can be fed in arbitrary chunks as it streams in; every complete
+// line is parsed immediately, so files become available as soon as their
+// closing code fence arrives.
+class StreamingFileParser {
+public:
+    explicit StreamingFileParser(ParserLogCallback log = nullptr);
+    
+    // Feed the next chunk of response text
+    void feed(std::string_view chunk);
+    
+    // Parse any trailing partial line (call once the response is complete)
+    void finish();
+    
+    // Get the files parsed so far (duplicates replaced by their latest version)
+    const std::vector<ParsedFile>& getFiles() const;
+    
+    // Check if the parser is currently inside an unclosed code block
+    bool isInCodeBlock() const;
+    
+    // Get the number of complete code blocks that produced a file
+    int getCodeBlockCount() const;
+    
+    // Get the bytes of text outside code blocks since the last fence
+    size_t getTrailingTextSize() const;
+    
+    // Helper to trim whitespace from strings
+    static std::string trim(const std::string& str);
+    
+    // Helper to extract filename from text with markdown formatting
+    static std::string extractFilenameFromText(const std::string& text);
+    
+    // Helper to check if a string looks like a valid filename
+    static bool looksLikeFilename(const std::string& text);
+
+private:
+    ParserLogCallback log_;
+    std::string lineBuffer_;
+    std::vector<ParsedFile> files_;
+    std::map<std::string, size_t> fileIndexByName_;  // Track files by name to deduplicate
+    std::shared_ptr<ResponseArena> arena_;   // Code block bodies are written here once
+    std::string pendingFilename_;
+    std::string currentLang_;
+    bool inCodeBlock_ = false;
+    int codeBlockCount_ = 0;
+    size_t trailingTextSize_ = 0;
+    std::vector<std::string> recentLines_;  // Keep track of recent lines before code block
+    
+    // Parse one complete line
+    void processLine(std::string_view line);
+    
+    // Find filename in lines preceding a code block
+    std::string findFilenameInRecentLines() const;
+    
+    // Generate a fallback filename from a code block language
+    static std::string generateFilename(const std::string& lang, int index);
+    
+    // Emit a diagnostic message if logging is enabled
+    void log(const std::string& message) const;
+};
+
+// Incremental decoder for structured output of the form
+// {"files":[{"path":"...","content":"..."}, ...]}.
+// Each file object is decoded as soon as its closing brace arrives, so no
+// markdown heuristics or post-processing are involved.
+class StructuredFileDecoder {
+public:
+    explicit StructuredFileDecoder(ParserLogCallback log = nullptr);
+    
+    // Feed the next chunk of JSON text
+    void feed(std::string_view chunk);
+    
+    // Get the files decoded so far (duplicates replaced by their latest version)
+    const std::vector<ParsedFile>& getFiles() const;
+    
+    // Check if the top-level JSON object has been closed
+    bool isComplete() const;
+    
+    // JSON schema passed as the request "format" for this output shape
+    static std::string schema();
+
+private:
+    ParserLogCallback log_;
+    std::shared_ptr<ResponseArena> arena_;
+    std::vector<ParsedFile> files_;
+    std::map<std::string, size_t> fileIndexByName_;
+    std::string containers_;    // Stack of open '{' and '[' characters
+    std::string objectBuffer_;  // Text of the file object being received
+    bool capturing_ = false;
+    bool inString_ = false;
+    bool escaped_ = false;
+    bool complete_ = false;
+    
+    // Decode one complete file object
+    void decodeObject(const std::string& object);
+};
+
+} // namespace ollama_agent
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+
+namespace ollama_agent {
+
+// An addressable part of a file: an element, rule block, function or paragraph
+struct FileSection {
+    std::string id;                  // Stable ID, e.g. "S1f2e3d4c" (derived from the first line)
+    size_t offset = 0;
+    size_t length = 0;
+    std::string label;               // First non-blank line, shortened
+};
+
+// Split a file into sections of roughly maxBytes along its structure:
+// block elements for HTML, rule blocks for CSS, top-level functions and
+// declarations for C-like languages and Python, headings for Markdown and
+// blank-line paragraphs otherwise. Small neighbouring units are packed
+// together; the same content always yields the same sections and IDs.
+std::vector<FileSection> splitIntoSections(std::string_view text, std::string_view extension,
+                                           size_t maxBytes = 1500);
+
+// Split text into chunks of roughly maxBytes, breaking at line ends
+// (preferably blank lines); returns offset/length pairs
+std::vector<std::pair<size_t, size_t>> splitIntoChunks(std::string_view text, size_t maxBytes = 1500);
+
+// Split a section reference "path#ID" into its parts (false if name has no ID)
+bool parseSectionReference(std::string_view name, std::string& path, std::string& id);
+
+// Get the lowercase extension of a path without the dot ("" if none)
+std::string pathExtension(std::string_view path);
+
+} // namespace ollama_agent
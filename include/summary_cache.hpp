@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ollama_client.hpp"
+#include "workspace_watcher.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <filesystem>
+#include <cstdint>
+
+namespace ollama_agent {
+
+// Short per-file summaries for files left out of the context.
+// Summaries are stored on disk under the file's content hash, so each
+// one is computed once and reused across turns and sessions. Missing
+// summaries are computed on a background thread, by a model when one is
+// set, otherwise extracted locally (headings, ids, declared symbols);
+// until then a local extraction is returned.
+class SummaryCache {
+public:
+    // config is the Ollama connection used for model summaries; model is
+    // the summarizing model (empty = local extraction only); directory
+    // defaults to defaultCacheDirectory()/summaries
+    SummaryCache(const OllamaConfig& config, const std::string& model, const std::string& directory = "");
+    ~SummaryCache();
+    
+    SummaryCache(const SummaryCache&) = delete;
+    SummaryCache& operator=(const SummaryCache&) = delete;
+    
+    // Queue the files without a stored summary for the background thread
+    void refresh(const std::vector<WorkspaceEntry>& files);
+    
+    // Get the summary of a file: the stored one if any, otherwise a local
+    // extraction (empty if the file cannot be read)
+    std::string get(const WorkspaceEntry& file);
+    
+    // Get a counter that grows whenever a new summary is stored
+    uint64_t getVersion() const;
+    
+    // Get the number of files waiting for a summary
+    size_t getPending() const;
+    
+    // Get the summarizing model (empty = local extraction)
+    std::string getModel() const;
+
+private:
+    // Content hash of a file, valid while its size and mtime are unchanged
+    struct FileHash {
+        size_t size = 0;
+        std::filesystem::file_time_type mtime;
+        std::string hash;
+    };
+    
+    std::string model_;
+    std::filesystem::path directory_;
+    OllamaClient client_;            // Used by the background thread only
+    CancellationToken cancelToken_;  // Aborts a summary in flight on destruction
+    std::map<std::string, FileHash> hashes_;
+    std::deque<WorkspaceEntry> queue_;
+    std::set<std::string> queued_;   // Paths in the queue
+    std::atomic<uint64_t> version_{0};
+    bool stopping_ = false;
+    mutable std::mutex mutex_;
+    std::condition_variable workReady_;
+    std::thread worker_;
+    
+    // Summarize queued files until the cache is destroyed
+    void workerLoop();
+    
+    // Read a file and get its content hash (cached by size and mtime)
+    bool hashFile(const WorkspaceEntry& file, std::string& content, std::string& hash);
+    
+    // Path of the stored summary for a content hash
+    std::filesystem::path entryPath(const std::string& hash) const;
+    
+    // Load a stored summary (empty if none)
+    std::string load(const std::string& hash) const;
+    
+    // Store a summary, replacing any previous one atomically
+    void store(const std::string& hash, const std::string& summary);
+};
+
+// Extract a summary from a file without a model: title, headings and ids
+// for HTML, selectors for CSS, declared functions/classes/exports for code,
+// headings for Markdown, the first lines otherwise
+std::string extractSummary(std::string_view text, std::string_view extension);
+
+} // namespace ollama_agent
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ignore_rules.hpp"
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <filesystem>
+#include <cstdint>
+
+namespace ollama_agent {
+
+// Indexed state of one file in the workspace
+struct WorkspaceEntry {
+    std::string relativePath;        // Forward slashes, relative to the root
+    std::filesystem::path fullPath;
+    size_t size = 0;
+    std::filesystem::file_time_type mtime;
+};
+
+// In-memory index of the files under a directory (hidden files and
+// directories, and paths matched by .gitignore/.agentignore rules
+// excluded), kept current by change notifications.
+// On Linux inotify events update single entries, so queries cost
+// O(changed files); elsewhere, or when inotify is unavailable, every
+// query rescans the tree.
+class WorkspaceWatcher {
+public:
+    explicit WorkspaceWatcher(const std::string& root = ".");
+    ~WorkspaceWatcher();
+    
+    WorkspaceWatcher(const WorkspaceWatcher&) = delete;
+    WorkspaceWatcher& operator=(const WorkspaceWatcher&) = delete;
+    
+    // Watch a different directory (rebuilds the index)
+    void setRoot(const std::string& root);
+    
+    // Get the watched directory
+    std::string getRoot() const;
+    
+    // Get the indexed files sorted by path, after applying pending changes
+    std::vector<WorkspaceEntry> getFiles();
+    
+    // Get the content hash of a file; computed on first use and kept until
+    // the file changes (empty if the file is not indexed)
+    std::string getHash(const std::string& relativePath);
+    
+    // Get a counter that changes whenever the index changes, after applying
+    // pending changes (cached data derived from the index is stale once it moves)
+    uint64_t getGeneration();
+    
+    // Check if the index is maintained by change notifications instead of rescans
+    bool isEventDriven() const;
+
+private:
+    struct IndexedFile {
+        WorkspaceEntry entry;
+        std::string hash;            // Empty until requested
+    };
+    
+    std::filesystem::path root_;
+    std::map<std::string, IndexedFile> index_;
+    uint64_t generation_ = 0;
+    IgnoreRules ignoreRules_;
+    mutable std::mutex mutex_;
+    
+    int notifyFd_ = -1;                          // inotify instance (-1 = polling)
+    std::map<int, std::string> watchDirs_;       // Watch descriptor -> relative directory
+    std::map<std::string, int> dirWatches_;      // Relative directory -> watch descriptor
+    
+    // Drop the index and watches and scan the whole tree again
+    void rebuild();
+    
+    // Index a directory and its subdirectories, watching each one
+    void scanDirectory(const std::string& relativeDir);
+    
+    // Re-read the metadata of one file; returns true if the index changed
+    bool refreshFile(const std::string& relativePath);
+    
+    // Remove a directory's entries and watches
+    void removeDirectory(const std::string& relativeDir);
+    
+    // Apply queued change notifications, or rescan when polling
+    void update();
+    
+    // Rescan the tree, keeping hashes of unchanged files (polling fallback)
+    void rescan();
+    
+    // Start watching a directory; falls back to polling if that fails
+    void addWatch(const std::string& relativeDir);
+    
+    // Stop using notifications
+    void closeNotifications();
+};
+
+} // namespace ollama_agent
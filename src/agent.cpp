@@ -2,19 +2,195 @@
 #include <iostream>
 #include <regex>
 #include <sstream>
+#include <fstream>
 #include <map>
 #include <algorithm>
 #include <cctype>
 #include <filesystem>
 #include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <limits>
 
 namespace ollama_agent {
 
+// Files the user's request implies a good response should contain
+struct RequestExpectations {
+    bool css = false;
+    bool newPages = false;
+    std::vector<std::string> files;  // Filenames named in the request
+};
+
+// Text outside code blocks after the last fence before a complete response
+// is cut off; short remarks between files stay well below this
+static const size_t kTrailingTextLimit = 256;
+
+// Files considered when retrieval picks the context
+static const size_t kMaxRetrievalFiles = 500;
+
+// Larger files are truncated instead of split into sections
+static const size_t kMaxSectionedFileBytes = 1024 * 1024;
+
+// Times an interrupted stream is continued within one request
+static const int kMaxStreamResumes = 3;
+
+// How long a status line waits for a slot in a full event queue
+static const auto kStatusQueueWait = std::chrono::milliseconds(100);
+
+// How often the prefill checks for workspace changes
+static const auto kPrefillPollInterval = std::chrono::milliseconds(200);
+
+// Set on the prefill thread, whose messages only go to the event queue:
+// the console and the output callback belong to the foreground
+static thread_local bool prefillThread = false;
+
+static std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+    return text;
+}
+
+static std::string baseName(std::string_view path) {
+    size_t slash = path.find_last_of("/\\");
+    return std::string(slash == std::string_view::npos ? path : path.substr(slash + 1));
+}
+
+static RequestExpectations analyzeRequest(const std::string& userRequest) {
+    std::string lowerRequest = toLower(userRequest);
+    
+    RequestExpectations expected;
+    expected.css = (lowerRequest.find("css") != std::string::npos || 
+                    lowerRequest.find("style") != std::string::npos);
+    expected.newPages = (lowerRequest.find("page") != std::string::npos && 
+                        (lowerRequest.find("new") != std::string::npos || 
+                         lowerRequest.find("create") != std::string::npos ||
+                         lowerRequest.find("add") != std::string::npos));
+    
+    // Words like "about.html" or `js/app.js`; extensions need a letter and
+    // two characters so "e.g." or "3.5" don't count
+    std::string word;
+    std::istringstream words(userRequest);
+    while (words >> word) {
+        size_t start = word.find_first_not_of("\"'`(");
+        size_t end = word.find_last_not_of("\"'`),;:!?.");
+        if (start == std::string::npos || end == std::string::npos || end < start) continue;
+        word = word.substr(start, end - start + 1);
+        
+        size_t dotPos = word.rfind('.');
+        if (dotPos == std::string::npos || word.size() - dotPos - 1 < 2) continue;
+        std::string ext = word.substr(dotPos + 1);
+        if (!std::any_of(ext.begin(), ext.end(), ::isalpha)) continue;
+        if (!StreamingFileParser::looksLikeFilename(word)) continue;
+        
+        std::string name = toLower(baseName(word));
+        if (std::find(expected.files.begin(), expected.files.end(), name) == expected.files.end()) {
+            expected.files.push_back(name);
+        }
+    }
+    return expected;
+}
+
+static bool meetsExpectations(const RequestExpectations& expected, const std::vector<ParsedFile>& files) {
+    if (files.empty()) return false;
+    
+    bool hasCss = false;
+    int htmlCount = 0;
+    std::set<std::string> names;
+    for (const auto& f : files) {
+        if (f.language == "css") hasCss = true;
+        if (f.language == "html" || f.language == "htm") htmlCount++;
+        names.insert(toLower(baseName(f.filename.substr(0, f.filename.find('#')))));
+    }
+    
+    if (expected.css && !hasCss) return false;
+    if (expected.newPages && htmlCount <= 1) return false;
+    for (const auto& name : expected.files) {
+        if (names.count(name) == 0) return false;
+    }
+    return true;
+}
+
+// A streamed markdown response is complete once every fence is closed, the
+// expected files are present and the model has moved on to trailing prose.
+// Only a request that names its files says when the reply is done: without
+// names, a short remark between files looks just like the closing one.
+static bool isResponseComplete(const StreamingFileParser& parser, const RequestExpectations& expected) {
+    return !expected.files.empty() && !parser.isInCodeBlock() &&
+           parser.getTrailingTextSize() >= kTrailingTextLimit &&
+           meetsExpectations(expected, parser.getFiles());
+}
+
+// One entry of a fan-out plan
+struct PlannedFile {
+    std::string path;
+    std::string purpose;
+};
+
+// Plans larger than this are cut; each entry costs a full request
+static const size_t kMaxPlannedFiles = 16;
+
+static std::string planSchema() {
+    return R"({"type":"object","properties":{"files":{"type":"array","items":{"type":"object",)"
+           R"("properties":{"path":{"type":"string"},"purpose":{"type":"string"}},)"
+           R"("required":["path","purpose"]}}},"required":["files"]})";
+}
+
+// Read the objects of the "files" array in a plan response
+static std::vector<PlannedFile> parsePlan(const std::string& json) {
+    std::vector<PlannedFile> plan;
+    size_t arrayPos = json.find("\"files\"");
+    if (arrayPos != std::string::npos) {
+        arrayPos = json.find('[', arrayPos);
+    }
+    if (arrayPos == std::string::npos) {
+        return plan;
+    }
+    
+    int depth = 0;
+    bool inString = false;
+    bool escaped = false;
+    size_t objectStart = 0;
+    for (size_t i = arrayPos + 1; i < json.size() && plan.size() < kMaxPlannedFiles; ++i) {
+        char c = json[i];
+        if (inString) {
+            if (escaped) escaped = false;
+            else if (c == '\\') escaped = true;
+            else if (c == '"') inString = false;
+            continue;
+        }
+        if (c == '"') {
+            inString = true;
+        } else if (c == '{') {
+            if (depth++ == 0) objectStart = i;
+        } else if (c == '}' && depth > 0) {
+            if (--depth > 0) continue;
+            std::string object = json.substr(objectStart, i - objectStart + 1);
+            PlannedFile file;
+            file.path = StreamingFileParser::trim(JsonParser::getString(object, "path").value_or(""));
+            file.purpose = JsonParser::getString(object, "purpose").value_or("");
+            bool duplicate = std::any_of(plan.begin(), plan.end(),
+                                         [&](const PlannedFile& p) { return p.path == file.path; });
+            if (StreamingFileParser::looksLikeFilename(file.path) && !duplicate) {
+                plan.push_back(file);
+            }
+        } else if (c == ']' && depth == 0) {
+            break;
+        }
+    }
+    return plan;
+}
+
 Agent::Agent(OllamaClient& client, FileManager& fileManager)
-    : client_(client), fileManager_(fileManager) {}
+    : client_(&client), fileManager_(fileManager) {}
+
+Agent::~Agent() {
+    stopPrefill();
+}
 
-std::string Agent::getExistingFilesContext() const {
-    std::ostringstream context;
+RequestBody Agent::getExistingFilesContext(const std::string& userRequest) {
+    RequestBody context;
     std::string workDir = fileManager_.getWorkingDirectory();
     
     // Extensions we care about
@@ -24,69 +200,556 @@ std::string Agent::getExistingFilesContext() const {
         "json", "xml", "yaml", "yml", "md", "txt", "sh", "bat"
     };
     
-    std::vector<std::pair<std::string, std::string>> existingFiles;
+    auto isCodeFile = [](const std::string& filename) {
+        if (filename.empty() || filename[0] == '.') return false;  // Skip hidden files
+        
+        // Get extension
+        size_t dotPos = filename.rfind('.');
+        if (dotPos == std::string::npos) return false;
+        
+        std::string ext = filename.substr(dotPos + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return codeExtensions.find(ext) != codeExtensions.end();
+    };
     
-    try {
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(
-                workDir, std::filesystem::directory_options::skip_permission_denied)) {
-            
-            if (!entry.is_regular_file()) continue;
-            
-            std::string filename = entry.path().filename().string();
-            if (filename[0] == '.') continue;  // Skip hidden files
-            
-            // Get extension
-            size_t dotPos = filename.rfind('.');
-            if (dotPos == std::string::npos) continue;
-            
-            std::string ext = filename.substr(dotPos + 1);
-            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-            
-            if (codeExtensions.find(ext) == codeExtensions.end()) continue;
-            
-            // Get relative path
-            std::string relativePath = std::filesystem::relative(entry.path(), workDir).string();
-            // Convert backslashes to forward slashes
-            std::replace(relativePath.begin(), relativePath.end(), '\\', '/');
-            
-            // Read content
-            std::string content = fileManager_.readFile(relativePath);
-            if (content.empty()) continue;
-            
-            // Limit file size
-            if (content.length() > 30000) {
-                content = content.substr(0, 1000) + "\n\n... [FILE TRUNCATED] ...\n";
+    // With retrieval, more files are collected and the relevant ones kept;
+    // with summaries, the ones not kept are listed
+    bool retrieval = embeddingIndex_ != nullptr;
+    size_t maxCandidates = (retrieval || summaryCache_) ? kMaxRetrievalFiles : contextLimits_.maxFiles;
+    uint64_t summaryVersion = summaryCache_ ? summaryCache_->getVersion() : 0;
+    std::vector<WorkspaceEntry> existingFiles;
+    
+    if (watcher_) {
+        // Follow working directory changes
+        std::error_code ec;
+        std::string absoluteDir = std::filesystem::absolute(workDir, ec).string();
+        if (watcher_->getRoot() != absoluteDir) {
+            watcher_->setRoot(workDir);
+        }
+        
+        // The index is only rebuilt from change events, so an unchanged
+        // workspace reuses the previous context as-is
+        uint64_t generation = watcher_->getGeneration();
+        if (contextCached_ && cachedGeneration_ == generation && cachedSummaryVersion_ == summaryVersion &&
+            ((!retrieval && !cachedSectioned_) || cachedRequest_ == userRequest)) {
+            return cachedContext_;
+        }
+        
+        for (const auto& entry : watcher_->getFiles()) {
+            if (!isCodeFile(entry.fullPath.filename().string()) || entry.size == 0) continue;
+            existingFiles.push_back(entry);
+            if (existingFiles.size() >= maxCandidates) break;
+        }
+        contextCached_ = false;
+        cachedGeneration_ = generation;
+        cachedRequest_ = userRequest;
+        cachedSummaryVersion_ = summaryVersion;
+    } else {
+        IgnoreRules ignoreRules;
+        ignoreRules.addDefaults();
+        ignoreRules.loadDirectory(workDir);
+        
+        try {
+            std::filesystem::recursive_directory_iterator it(
+                workDir, std::filesystem::directory_options::skip_permission_denied);
+            for (; it != std::filesystem::recursive_directory_iterator(); ++it) {
+                const auto& entry = *it;
+                std::string filename = entry.path().filename().string();
+                
+                // Get relative path
+                std::string relativePath = std::filesystem::relative(entry.path(), workDir).string();
+                // Convert backslashes to forward slashes
+                std::replace(relativePath.begin(), relativePath.end(), '\\', '/');
+                
+                if (entry.is_directory()) {
+                    // Skip whole subtrees (node_modules, build output, ...) instead
+                    // of visiting every file inside them
+                    if (filename[0] == '.' || ignoreRules.isIgnored(relativePath, true)) {
+                        it.disable_recursion_pending();
+                    } else {
+                        ignoreRules.loadDirectory(workDir, relativePath);
+                    }
+                    continue;
+                }
+                
+                if (!entry.is_regular_file()) continue;
+                if (!isCodeFile(filename)) continue;
+                if (ignoreRules.isIgnored(relativePath, false)) continue;
+                
+                // Only the size is needed now; content is read while sending
+                size_t size = static_cast<size_t>(entry.file_size());
+                if (size == 0) continue;
+                
+                existingFiles.push_back({relativePath, entry.path(), size, entry.last_write_time()});
+                
+                // Limit number of files
+                if (existingFiles.size() >= maxCandidates) break;
             }
-            
-            existingFiles.push_back({relativePath, content});
-            
-            // Limit number of files
-            if (existingFiles.size() >= 20) break;
+        } catch (...) {
+            // Ignore errors
         }
-    } catch (...) {
-        // Ignore errors
     }
     
+    std::vector<WorkspaceEntry> candidates;
+    if (summaryCache_) {
+        candidates = existingFiles;
+    }
+    
+    std::map<std::string, std::vector<ContextChunk>> excerpts;
+    if (retrieval) {
+        selectRelevantFiles(existingFiles, userRequest, excerpts);
+    } else if (existingFiles.size() > contextLimits_.maxFiles) {
+        existingFiles.resize(contextLimits_.maxFiles);
+    }
+    
+    sharedBlocks_.clear();
     if (existingFiles.empty()) {
-        return "";
+        cachedContext_ = context;
+        cachedSectioned_ = false;
+        contextCached_ = watcher_ != nullptr;
+        return context;
+    }
+    
+    std::string header = "=== EXISTING PROJECT FILES ===\n";
+    header += "Below are the current files. To modify any file, you MUST output the COMPLETE updated content.\n";
+    if (!structuredOutput_) {
+        header += "Use the format: FILE: filename.ext followed by code block with FULL content.\n";
+    }
+    header += "\n";
+    context.appendEscaped(header);
+    
+    const std::string truncationNote = "\n\n... [FILE TRUNCATED] ...\n";
+    size_t budgetUsed = 0;
+    bool sectioned = false;
+    std::set<std::string> sent;
+    
+    // Files small enough to send whole are read up front when they are sent
+    // minified or deduplicated; the rest are streamed from disk
+    std::map<std::string, std::string> promptCopies;
+    for (const auto& file : existingFiles) {
+        if (file.size > contextLimits_.maxFileBytes) continue;
+        std::string language = minifyLanguageFor(pathExtension(file.relativePath));
+        bool minify = minifyLanguages_.count(language) > 0;
+        if (!minify && !deduplicate_) continue;
+        std::ifstream in(file.fullPath, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        promptCopies[file.relativePath] = minify ? minifyForPrompt(content, language) : std::move(content);
+    }
+    
+    // Blocks repeated across files are sent once, ahead of the files. Only
+    // files sent as they are on disk take part, so expanding a block in a
+    // reply writes back the files' own text, never a minified one.
+    std::vector<SharedBlock> blocks;
+    std::map<std::string, std::vector<size_t>> blockUses;
+    if (deduplicate_) {
+        std::vector<std::string*> originals;
+        std::vector<std::string_view> texts;
+        for (auto& [path, text] : promptCopies) {
+            if (minifyLanguages_.count(minifyLanguageFor(pathExtension(path))) > 0) continue;
+            originals.push_back(&text);
+            texts.push_back(text);
+        }
+        if (texts.size() >= 2) {
+            DeduplicatedFiles deduplicated = deduplicateBlocks(texts);
+            if (!deduplicated.blocks.empty()) {
+                for (auto& [path, text] : promptCopies) {
+                    auto original = std::find(originals.begin(), originals.end(), &text);
+                    if (original == originals.end()) continue;
+                    size_t index = static_cast<size_t>(original - originals.begin());
+                    text = std::move(deduplicated.texts[index]);
+                    blockUses[path] = std::move(deduplicated.references[index]);
+                }
+                blocks = std::move(deduplicated.blocks);
+            }
+        }
+    }
+    
+    // Files go to their own body first: only the blocks of files that were
+    // sent are defined, and each counts against the budget with the first
+    // file that uses it
+    RequestBody fileParts;
+    std::set<size_t> usedBlocks;
+    for (const auto& file : existingFiles) {
+        // Files read up front are sent, and counted, as their prompt copy
+        auto promptCopy = promptCopies.find(file.relativePath);
+        bool copied = promptCopy != promptCopies.end();
+        bool minify = minifyLanguages_.count(minifyLanguageFor(pathExtension(file.relativePath))) > 0;
+        size_t fileBytes = copied ? promptCopy->second.size() : file.size;
+        std::vector<size_t> newBlocks;
+        auto uses = blockUses.find(file.relativePath);
+        if (uses != blockUses.end()) {
+            for (size_t block : uses->second) {
+                if (usedBlocks.count(block) == 0) {
+                    newBlocks.push_back(block);
+                    fileBytes += blocks[block].text.size();
+                }
+            }
+        }
+        
+        // Limit file size, and the total once a budget is set
+        bool truncated = file.size > contextLimits_.maxFileBytes;
+        size_t sentBytes = truncated ? contextLimits_.truncatedBytes : fileBytes;
+        if (contextLimits_.maxTotalBytes > 0) {
+            if (budgetUsed >= contextLimits_.maxTotalBytes) break;
+            size_t remaining = contextLimits_.maxTotalBytes - budgetUsed;
+            if (sentBytes > remaining) {
+                truncated = true;
+                sentBytes = std::min(contextLimits_.truncatedBytes, remaining);
+            }
+        }
+        
+        // A file too large to send whole is split into sections; its outline
+        // and the sections relevant to the request are sent
+        if (truncated && file.size <= kMaxSectionedFileBytes) {
+            size_t remaining = contextLimits_.maxTotalBytes > 0
+                ? contextLimits_.maxTotalBytes - budgetUsed : std::string::npos;
+            auto fileExcerpts = excerpts.find(file.relativePath);
+            size_t sentSections = appendSections(fileParts, file, userRequest,
+                                                 fileExcerpts != excerpts.end() ? &fileExcerpts->second : nullptr,
+                                                 std::min(contextLimits_.sectionBytes, remaining));
+            if (sentSections > 0) {
+                budgetUsed += sentSections;
+                sectioned = true;
+                sent.insert(file.relativePath);
+                continue;
+            }
+        }
+        
+        budgetUsed += sentBytes;
+        sent.insert(file.relativePath);
+        
+        if (copied && !truncated) {
+            usedBlocks.insert(newBlocks.begin(), newBlocks.end());
+            fileParts.appendEscaped("CURRENT FILE: " + file.relativePath + " (" + std::to_string(file.size) +
+                                    (minify ? " bytes, shown minified - write it with normal indentation)\n```\n"
+                                            : " bytes)\n```\n"));
+            fileParts.appendEscaped(promptCopy->second);
+            fileParts.appendEscaped("\n```\n\n");
+            continue;
+        }
+        
+        size_t shownSize = truncated ? sentBytes + truncationNote.size() : file.size;
+        fileParts.appendEscaped("CURRENT FILE: " + file.relativePath + " (" + std::to_string(shownSize) + " bytes)\n```\n");
+        fileParts.appendFile(file.fullPath, sentBytes);
+        if (truncated) {
+            fileParts.appendEscaped(truncationNote);
+        }
+        fileParts.appendEscaped("\n```\n\n");
     }
     
-    context << "\n\n=== EXISTING PROJECT FILES ===\n";
-    context << "Below are the current files. To modify any file, you MUST output the COMPLETE updated content.\n";
-    context << "Use the format: FILE: filename.ext followed by code block with FULL content.\n\n";
+    if (!usedBlocks.empty()) {
+        context.appendEscaped("=== SHARED BLOCKS ===\n"
+                              "These blocks appear in several files below, where each is replaced by a line like " +
+                              blockReference(blocks[*usedBlocks.begin()].id) + ".\n"
+                              "When you output such a file you may keep a reference line as-is (alone on its line) "
+                              "where the block is unchanged; it is expanded when the file is written. "
+                              "To change a block in a file, write its full text there instead.\n\n");
+        for (size_t index : usedBlocks) {
+            const SharedBlock& block = blocks[index];
+            context.appendEscaped("BLOCK " + block.id + " (used " + std::to_string(block.uses) + " times)\n```\n");
+            context.appendEscaped(block.text);
+            context.appendEscaped("```\n\n");
+            sharedBlocks_[block.id] = block.text;
+        }
+    }
+    context.append(fileParts);
     
-    for (const auto& [path, content] : existingFiles) {
-        context << "CURRENT FILE: " << path << " (" << content.length() << " bytes)\n```\n" << content << "\n```\n\n";
+    // Files that did not fit are still named, with what they contain
+    if (summaryCache_) {
+        std::vector<WorkspaceEntry> leftOut;
+        for (const auto& file : candidates) {
+            if (sent.count(file.relativePath) == 0) leftOut.push_back(file);
+        }
+        appendSummaries(context, leftOut);
     }
     
-    context << "=== END EXISTING FILES ===\n";
-    context << "IMPORTANT: When modifying files above, output the ENTIRE file with all changes included.\n";
-    context << "When creating NEW files, use FILE: newfilename.ext format.\n";
+    std::string footer = "=== END EXISTING FILES ===\n";
+    footer += "IMPORTANT: When modifying files above, output the ENTIRE file with all changes included.\n";
+    if (!structuredOutput_) {
+        footer += "When creating NEW files, use FILE: newfilename.ext format.\n";
+    }
+    if (sectioned) {
+        footer += "EXCEPTION: files split into sections are changed one section at a time - NEVER output them whole.\n";
+        if (structuredOutput_) {
+            footer += "Use \"path\": \"filename.ext#ID\" with the COMPLETE new text of that section as \"content\".\n";
+        } else {
+            footer += "Use the format: SECTION: filename.ext#ID followed by a code block with the COMPLETE new text of that section.\n";
+        }
+        footer += "Only the sections you output are replaced; the rest of the file is kept.\n";
+    }
+    context.appendEscaped(footer);
     
-    return context.str();
+    // Sections are picked by the request's words, so a sectioned context
+    // is only reused for the same request
+    cachedSectioned_ = sectioned;
+    if (watcher_) {
+        cachedContext_ = context;
+        contextCached_ = true;
+    }
+    return context;
+}
+
+RequestBody Agent::buildUserMessage(const RequestBody& existingFiles, const std::string& userRequest) const {
+    RequestBody message;
+    if (!existingFiles.empty()) {
+        message.append(existingFiles);
+        message.appendEscaped("\n=== REQUEST ===\n");
+    }
+    message.appendEscaped(userRequest);
+    return message;
+}
+
+void Agent::selectRelevantFiles(std::vector<WorkspaceEntry>& files, const std::string& userRequest,
+                                std::map<std::string, std::vector<ContextChunk>>& excerpts) {
+    // Nothing to choose if everything fits anyway
+    size_t totalBytes = 0;
+    bool anyTruncated = false;
+    for (const auto& file : files) {
+        totalBytes += file.size;
+        anyTruncated = anyTruncated || file.size > contextLimits_.maxFileBytes;
+    }
+    bool fits = files.size() <= contextLimits_.maxFiles && !anyTruncated &&
+                (contextLimits_.maxTotalBytes == 0 || totalBytes <= contextLimits_.maxTotalBytes);
+    
+    std::vector<ChunkMatch> matches;
+    if (!fits) {
+        embeddingIndex_->setWorkspace(fileManager_.getWorkingDirectory());
+        if (embeddingIndex_->update(*client_, files)) {
+            matches = embeddingIndex_->query(*client_, userRequest, retrievalTopK_);
+        }
+        if (matches.empty()) {
+            outputMessage("[!] Retrieval unavailable, using directory order: " + embeddingIndex_->getLastError());
+        }
+    }
+    if (matches.empty()) {
+        if (files.size() > contextLimits_.maxFiles) {
+            files.resize(contextLimits_.maxFiles);
+        }
+        return;
+    }
+    
+    // Files are ranked by their best chunk; files without a match follow in
+    // directory order, filling what the budget has left
+    std::map<std::string, float> bestScore;
+    for (const auto& match : matches) {
+        auto it = bestScore.find(match.chunk.relativePath);
+        if (it == bestScore.end()) {
+            bestScore[match.chunk.relativePath] = match.score;
+        }
+        excerpts[match.chunk.relativePath].push_back(match.chunk);
+    }
+    auto rank = [&](const WorkspaceEntry& file) {
+        auto it = bestScore.find(file.relativePath);
+        return it == bestScore.end() ? -std::numeric_limits<float>::infinity() : it->second;
+    };
+    std::stable_sort(files.begin(), files.end(), [&](const WorkspaceEntry& a, const WorkspaceEntry& b) {
+        return rank(a) > rank(b);
+    });
+    if (files.size() > contextLimits_.maxFiles) {
+        files.resize(contextLimits_.maxFiles);
+    }
+    for (auto& [path, chunks] : excerpts) {
+        std::sort(chunks.begin(), chunks.end(), [](const ContextChunk& a, const ContextChunk& b) {
+            return a.offset < b.offset;
+        });
+    }
+    
+    if (verbose_) {
+        outputMessage("[i] Retrieval: " + std::to_string(matches.size()) + " chunk(s) from " +
+                      std::to_string(bestScore.size()) + " file(s)");
+    }
+}
+
+void Agent::appendSummaries(RequestBody& context, const std::vector<WorkspaceEntry>& files) const {
+    if (files.empty()) return;
+    
+    // Summaries missing from the cache are computed in the background for
+    // later turns; a local extraction stands in meanwhile
+    summaryCache_->refresh(files);
+    
+    std::string block = "OTHER PROJECT FILES (contents not included, summaries only - "
+                        "do not rewrite these files unless the request needs it):\n";
+    size_t listed = 0;
+    for (const auto& file : files) {
+        std::string line = "- " + file.relativePath + " (" + std::to_string(file.size) + " bytes): " +
+                           summaryCache_->get(file) + "\n";
+        if (block.size() + line.size() > contextLimits_.summaryBytes) break;
+        block += line;
+        listed++;
+    }
+    if (listed < files.size()) {
+        block += "- ... " + std::to_string(files.size() - listed) + " more file(s)\n";
+    }
+    context.appendEscaped(block + "\n");
+    
+    if (verbose_) {
+        outputMessage("[i] Summaries: " + std::to_string(listed) + " file(s) left out of the context, " +
+                      std::to_string(summaryCache_->getPending()) + " summary(ies) pending");
+    }
+}
+
+size_t Agent::appendSections(RequestBody& context, const WorkspaceEntry& file, const std::string& userRequest,
+                             const std::vector<ContextChunk>* retrieved, size_t maxBytes) const {
+    std::ifstream in(file.fullPath, std::ios::binary);
+    if (!in) return 0;
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<FileSection> sections = splitIntoSections(content, pathExtension(file.relativePath));
+    if (sections.empty()) return 0;
+    
+    // Line ranges make the outline readable
+    std::vector<std::pair<size_t, size_t>> lines;
+    size_t line = 1;
+    for (const auto& section : sections) {
+        std::string_view text(content.data() + section.offset, section.length);
+        size_t breaks = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+        bool endsWithBreak = !text.empty() && text.back() == '\n';
+        lines.push_back({line, line + breaks - (endsWithBreak && breaks > 0 ? 1 : 0)});
+        line += breaks;
+    }
+    
+    // The outline takes at most half the allowance
+    std::string outline = "Sections (ID, lines, first line):\n";
+    for (size_t i = 0; i < sections.size(); i++) {
+        std::string entry = "  " + sections[i].id + "  " + std::to_string(lines[i].first) + "-" +
+                            std::to_string(lines[i].second) + "  " + sections[i].label + "\n";
+        if (outline.size() + entry.size() > maxBytes / 2) {
+            outline += "  ... " + std::to_string(sections.size() - i) + " more section(s)\n";
+            break;
+        }
+        outline += entry;
+    }
+    if (outline.size() >= maxBytes) return 0;
+    size_t bodyBudget = maxBytes - outline.size();
+    
+    // Rank the candidate sections: retrieved ones in match order, otherwise
+    // by the number of request words they contain
+    std::vector<size_t> ranked;
+    bool prefixOnly = false;
+    if (retrieved) {
+        for (const auto& chunk : *retrieved) {
+            for (size_t i = 0; i < sections.size(); i++) {
+                if (sections[i].id == chunk.id) ranked.push_back(i);
+            }
+        }
+    } else {
+        static const std::set<std::string> stopWords = {
+            "the", "and", "for", "with", "this", "that", "add", "make", "please", "into", "from",
+            "all", "new", "use", "can", "should", "file", "page"
+        };
+        std::set<std::string> terms;
+        std::string word;
+        for (char c : userRequest + " ") {
+            if (std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-') {
+                word += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            } else {
+                if (word.size() >= 3 && stopWords.count(word) == 0) terms.insert(word);
+                word.clear();
+            }
+        }
+        
+        std::vector<size_t> scores(sections.size(), 0);
+        for (size_t i = 0; i < sections.size(); i++) {
+            std::string text = toLower(content.substr(sections[i].offset, sections[i].length));
+            for (const auto& term : terms) {
+                if (text.find(term) != std::string::npos) scores[i]++;
+            }
+            if (scores[i] > 0) ranked.push_back(i);
+        }
+        std::stable_sort(ranked.begin(), ranked.end(), [&](size_t a, size_t b) {
+            return scores[a] > scores[b];
+        });
+        
+        // Nothing matched: show the start of the file, as truncation did
+        if (ranked.empty()) {
+            prefixOnly = true;
+            bodyBudget = std::min(bodyBudget, std::max(contextLimits_.truncatedBytes, sections.front().length));
+            for (size_t i = 0; i < sections.size(); i++) ranked.push_back(i);
+        }
+    }
+    
+    std::vector<size_t> chosen;
+    size_t bodyBytes = 0;
+    for (size_t index : ranked) {
+        if (bodyBytes + sections[index].length > bodyBudget) {
+            if (prefixOnly) break;
+            continue;
+        }
+        if (std::find(chosen.begin(), chosen.end(), index) != chosen.end()) continue;
+        chosen.push_back(index);
+        bodyBytes += sections[index].length;
+    }
+    std::sort(chosen.begin(), chosen.end());
+    
+    context.appendEscaped("CURRENT FILE: " + file.relativePath + " (" + std::to_string(file.size) + " bytes, split into " +
+                          std::to_string(sections.size()) + " sections - only the relevant ones are shown)\n");
+    context.appendEscaped(outline);
+    context.appendEscaped("```\n");
+    for (size_t index : chosen) {
+        const FileSection& section = sections[index];
+        context.appendEscaped("... [SECTION " + section.id + ", lines " + std::to_string(lines[index].first) + "-" +
+                              std::to_string(lines[index].second) + "] ...\n");
+        context.appendEscaped(content.substr(section.offset, section.length));
+        if (section.length > 0 && content[section.offset + section.length - 1] != '\n') {
+            context.appendEscaped("\n");
+        }
+    }
+    context.appendEscaped("... [END OF SECTIONS] ...\n```\n\n");
+    return outline.size() + bodyBytes;
+}
+
+void Agent::setRetrieval(const std::string& embedModel, size_t topK) {
+    if (embedModel.empty()) {
+        embeddingIndex_.reset();
+    } else if (!embeddingIndex_ || embeddingIndex_->getModel() != embedModel) {
+        embeddingIndex_ = std::make_unique<EmbeddingIndex>(embedModel, fileManager_.getWorkingDirectory());
+    }
+    retrievalTopK_ = std::max<size_t>(topK, 1);
+    contextCached_ = false;
+}
+
+std::string Agent::getRetrievalModel() const {
+    return embeddingIndex_ ? embeddingIndex_->getModel() : "";
+}
+
+void Agent::setSummaryCache(std::shared_ptr<SummaryCache> cache) {
+    summaryCache_ = std::move(cache);
+    contextCached_ = false;
+}
+
+void Agent::setMinify(const std::set<std::string>& languages) {
+    minifyLanguages_ = languages;
+    contextCached_ = false;
+}
+
+const std::set<std::string>& Agent::getMinify() const {
+    return minifyLanguages_;
+}
+
+void Agent::setDeduplication(bool enabled) {
+    deduplicate_ = enabled;
+    contextCached_ = false;
+}
+
+bool Agent::isDeduplication() const {
+    return deduplicate_;
 }
 
 std::string Agent::buildSystemPrompt() const {
+    if (structuredOutput_) {
+        return R"(You are a code generation assistant that creates and modifies files.
+
+OUTPUT FORMAT - Respond with a single JSON object and nothing else:
+{"files":[{"path":"index.html","content":"<!DOCTYPE html>..."},{"path":"styles.css","content":"body {...}"}]}
+
+CRITICAL RULES:
+1. Add one entry per file; "path" is relative to the working directory
+2. "content" holds the COMPLETE file - never partial files or diffs
+3. When modifying: output the FULL updated file, not just the changed parts
+4. If user asks for links/navigation: update ALL pages that need the links
+
+Working directory: )" + fileManager_.getWorkingDirectory();
+    }
+    
     return R"(You are a code generation assistant that creates and modifies files.
 
 OUTPUT FORMAT - You MUST use this EXACT format for EVERY file:
@@ -125,307 +788,146 @@ Working directory: )" + fileManager_.getWorkingDirectory() + R"(
 Remember: Output COMPLETE files. Every file needs FILE: marker followed by code block.)";
 }
 
-std::string Agent::trimString(const std::string& str) const {
-    size_t start = str.find_first_not_of(" \t\n\r");
-    if (start == std::string::npos) return "";
-    size_t end = str.find_last_not_of(" \t\n\r");
-    return str.substr(start, end - start + 1);
-}
-
-std::string Agent::extractFilenameFromText(const std::string& text) const {
-    std::string cleaned = text;
-    
-    // Remove markdown formatting
-    size_t pos = 0;
-    while ((pos = cleaned.find('*')) != std::string::npos) cleaned.erase(pos, 1);
-    while ((pos = cleaned.find('`')) != std::string::npos) cleaned.erase(pos, 1);
-    while ((pos = cleaned.find('#')) != std::string::npos) cleaned.erase(pos, 1);
-    
-    // Remove "FILE:" prefix if present
-    std::string upper = cleaned;
-    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-    if (upper.find("FILE:") == 0 || upper.find("FILE :") == 0) {
-        size_t colonPos = cleaned.find(':');
-        if (colonPos != std::string::npos) {
-            cleaned = cleaned.substr(colonPos + 1);
-        }
+std::vector<ParsedFile> Agent::parseFilesFromResponse(const std::string& response) const {
+    ParserLogCallback log;
+    if (verbose_) {
+        log = [this](const std::string& message) { outputMessage(message); };
     }
     
-    return trimString(cleaned);
-}
-
-bool Agent::looksLikeFilename(const std::string& text) const {
-    std::string trimmed = trimString(text);
-    
-    // Must have an extension (dot followed by letters)
-    size_t dotPos = trimmed.rfind('.');
-    if (dotPos == std::string::npos || dotPos == 0 || dotPos >= trimmed.length() - 1) {
-        return false;
-    }
+    StreamingFileParser parser(log);
+    parser.feed(response);
+    parser.finish();
     
-    // Extension should be 1-5 alphanumeric characters
-    std::string ext = trimmed.substr(dotPos + 1);
-    if (ext.length() < 1 || ext.length() > 5) return false;
+    const std::vector<ParsedFile>& files = parser.getFiles();
     
-    for (char c : ext) {
-        if (!std::isalnum(c)) return false;
+    if (verbose_ && files.empty()) {
+        outputMessage("[Parser] No files detected. Code blocks found: " + std::to_string(parser.getCodeBlockCount()));
     }
     
-    // Filename part should be reasonable
-    std::string name = trimmed.substr(0, dotPos);
-    if (name.empty() || name.length() > 100) return false;
-    
-    // Should contain valid filename characters
-    for (char c : name) {
-        if (!std::isalnum(c) && c != '_' && c != '-' && c != '/' && c != '\\' && c != '.') {
-            return false;
-        }
+    // Check if model seems to be ignoring instructions
+    if (verbose_ && !files.empty()) {
+        outputMessage("[Parser] Total unique files: " + std::to_string(files.size()));
     }
     
-    return true;
+    return files;
 }
 
-std::vector<ParsedFile> Agent::parseFilesFromResponse(const std::string& response) const {
-    std::vector<ParsedFile> files;
-    std::map<std::string, size_t> fileIndexByName;  // Track files by name to deduplicate
-    
-    std::istringstream stream(response);
-    std::string line;
-    std::string pendingFilename;
-    std::string currentContent;
-    std::string currentLang;
-    bool inCodeBlock = false;
-    int codeBlockCount = 0;
-    std::vector<std::string> recentLines;  // Keep track of recent lines before code block
-    
-    // Language to extension mapping
-    std::map<std::string, std::string> langToExt = {
-        {"html", "html"}, {"htm", "html"},
-        {"css", "css"}, {"scss", "scss"},
-        {"javascript", "js"}, {"js", "js"}, {"jsx", "jsx"},
-        {"typescript", "ts"}, {"ts", "ts"}, {"tsx", "tsx"},
-        {"python", "py"}, {"py", "py"},
-        {"cpp", "cpp"}, {"c++", "cpp"}, {"cxx", "cpp"},
-        {"c", "c"}, {"java", "java"},
-        {"rust", "rs"}, {"go", "go"},
-        {"ruby", "rb"}, {"php", "php"},
-        {"json", "json"}, {"xml", "xml"},
-        {"yaml", "yaml"}, {"yml", "yml"},
-        {"bash", "sh"}, {"sh", "sh"}, {"shell", "sh"},
-        {"bat", "bat"}, {"cmd", "cmd"},
-        {"sql", "sql"}, {"md", "md"}
-    };
-    
-    auto generateFilename = [&](const std::string& lang, int index) -> std::string {
-        std::string lowerLang = lang;
-        std::transform(lowerLang.begin(), lowerLang.end(), lowerLang.begin(), ::tolower);
-        
-        auto it = langToExt.find(lowerLang);
-        std::string ext = (it != langToExt.end()) ? it->second : lang;
-        
-        if (ext == "html") return (index == 0) ? "index.html" : "page" + std::to_string(index) + ".html";
-        if (ext == "css") return (index == 0) ? "styles.css" : "styles" + std::to_string(index) + ".css";
-        if (ext == "js") return (index == 0) ? "script.js" : "script" + std::to_string(index) + ".js";
-        
-        return "file" + std::to_string(index) + "." + ext;
-    };
-    
-    // Helper to find filename in recent lines
-    auto findFilenameInRecentLines = [&]() -> std::string {
-        for (auto it = recentLines.rbegin(); it != recentLines.rend(); ++it) {
-            std::string trimmed = trimString(*it);
-            if (trimmed.empty()) continue;
-            
-            // Check various patterns
-            std::string upper = trimmed;
-            std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-            
-            // FILE: pattern
-            if (upper.find("FILE:") != std::string::npos || upper.find("FILE :") != std::string::npos) {
-                size_t colonPos = trimmed.find(':');
-                if (colonPos != std::string::npos) {
-                    std::string possibleFile = extractFilenameFromText(trimmed.substr(colonPos + 1));
-                    if (looksLikeFilename(possibleFile)) return possibleFile;
-                }
-            }
-            
-            // Direct filename patterns (with or without markdown)
-            std::string extracted = extractFilenameFromText(trimmed);
-            if (looksLikeFilename(extracted)) return extracted;
-            
-            // Pattern: "Updated index.html:" or "Here's the index.html file:"
-            std::regex filenameRegex(R"(([a-zA-Z0-9_\-./]+\.[a-zA-Z0-9]{1,5}))");
-            std::smatch match;
-            if (std::regex_search(trimmed, match, filenameRegex)) {
-                std::string found = match[1].str();
-                if (looksLikeFilename(found)) return found;
+std::vector<ParsedFile> Agent::applySectionEdits(const std::vector<ParsedFile>& files, bool& allSuccess) const {
+    std::vector<ParsedFile> resolved;
+    std::map<std::string, std::map<std::string, const ParsedFile*>> edits;
+    std::set<std::string> wholeFiles;
+    for (const auto& file : files) {
+        std::string path;
+        std::string id;
+        if (parseSectionReference(file.filename, path, id)) {
+            // Two edits of one section would both replace its original
+            // range; the last one wins
+            auto& edit = edits[path][id];
+            if (edit) {
+                outputMessage("[Write] " + path + ": section " + id + " given more than once, using the last");
             }
+            edit = &file;
+        } else {
+            wholeFiles.insert(std::string(file.filename));
+            resolved.push_back(file);
         }
-        return "";
-    };
+    }
     
-    while (std::getline(stream, line)) {
-        std::string trimmedLine = trimString(line);
-        
-        // Check for code block markers - be more flexible
-        bool isCodeBlockMarker = false;
-        size_t tickPos = line.find("```");
-        if (tickPos != std::string::npos) {
-            isCodeBlockMarker = true;
+    for (const auto& [path, sectionEdits] : edits) {
+        if (wholeFiles.count(path)) {
+            outputMessage("[Write] " + path + ": section edits ignored, the whole file was given");
+            continue;
         }
         
-        if (isCodeBlockMarker) {
-            if (!inCodeBlock) {
-                // Starting a code block
-                inCodeBlock = true;
-                currentContent.clear();
-                
-                // Extract language hint after ```
-                size_t langStart = tickPos + 3;
-                if (langStart < line.length()) {
-                    currentLang = line.substr(langStart);
-                    // Remove any trailing characters
-                    size_t spacePos = currentLang.find(' ');
-                    if (spacePos != std::string::npos) {
-                        currentLang = currentLang.substr(0, spacePos);
-                    }
-                    currentLang = trimString(currentLang);
-                }
-                
-                // Try to find filename from pending or recent lines
-                if (pendingFilename.empty()) {
-                    pendingFilename = findFilenameInRecentLines();
-                }
-            } else {
-                // Ending a code block
-                inCodeBlock = false;
-                
-                // Determine filename
-                std::string filename;
-                
-                if (!pendingFilename.empty()) {
-                    filename = pendingFilename;
-                    pendingFilename.clear();
-                } else if (!currentLang.empty()) {
-                    filename = generateFilename(currentLang, codeBlockCount);
-                }
-                
-                // Save the file if we have content
-                std::string trimmedContent = trimString(currentContent);
-                if (!filename.empty() && !trimmedContent.empty()) {
-                    ParsedFile file;
-                    file.filename = filename;
-                    file.content = currentContent;
-                    
-                    // Trim trailing whitespace from content
-                    size_t endPos = file.content.find_last_not_of(" \t\n\r");
-                    if (endPos != std::string::npos) {
-                        file.content = file.content.substr(0, endPos + 1);
-                    }
-                    
-                    // Get extension as language
-                    size_t dotPos = filename.rfind('.');
-                    if (dotPos != std::string::npos) {
-                        file.language = filename.substr(dotPos + 1);
-                    }
-                    
-                    // Check for duplicate filename - keep the latest version
-                    auto it = fileIndexByName.find(filename);
-                    if (it != fileIndexByName.end()) {
-                        // Replace existing file with newer version
-                        files[it->second] = file;
-                        if (verbose_) {
-                            outputMessage("[Parser] Updated file: " + filename + " (" + std::to_string(file.content.length()) + " bytes) - replacing previous version");
-                        }
-                    } else {
-                        // New file
-                        fileIndexByName[filename] = files.size();
-                        files.push_back(file);
-                        if (verbose_) {
-                            outputMessage("[Parser] Found file: " + filename + " (" + std::to_string(file.content.length()) + " bytes)");
-                        }
-                    }
-                    codeBlockCount++;
-                }
-                
-                currentContent.clear();
-                currentLang.clear();
-                recentLines.clear();  // Clear recent lines after processing a code block
-            }
+        // Sections are found again in the current content, so the IDs the
+        // model saw resolve to the same ranges
+        std::string content = fileManager_.readFile(path);
+        if (content.empty()) {
+            outputMessage("  [!] FAILED: " + path + " - no existing file to replace sections in");
+            allSuccess = false;
             continue;
         }
+        std::vector<FileSection> sections = splitIntoSections(content, pathExtension(path));
         
-        if (inCodeBlock) {
-            // Inside code block - accumulate content
-            if (!currentContent.empty()) {
-                currentContent += "\n";
-            }
-            currentContent += line;
-        } else {
-            // Outside code block - track recent lines and look for filename indicators
-            recentLines.push_back(line);
-            if (recentLines.size() > 5) {
-                recentLines.erase(recentLines.begin());
-            }
-            
-            std::string upperLine = trimmedLine;
-            std::transform(upperLine.begin(), upperLine.end(), upperLine.begin(), ::toupper);
-            
-            // Check for "FILE: filename" pattern - priority
-            if (upperLine.find("FILE:") != std::string::npos || upperLine.find("FILE :") != std::string::npos) {
-                size_t colonPos = trimmedLine.find(':');
-                if (colonPos != std::string::npos) {
-                    std::string possibleFile = extractFilenameFromText(trimmedLine.substr(colonPos + 1));
-                    if (looksLikeFilename(possibleFile)) {
-                        pendingFilename = possibleFile;
-                        if (verbose_) {
-                            outputMessage("[Parser] Found FILE: marker -> " + pendingFilename);
-                        }
-                    }
-                }
-            }
-            // Check for **filename.ext** or `filename.ext` patterns
-            else if (looksLikeFilename(extractFilenameFromText(trimmedLine))) {
-                std::string extracted = extractFilenameFromText(trimmedLine);
-                if (trimmedLine.length() < 100) {
-                    pendingFilename = extracted;
-                    if (verbose_) {
-                        outputMessage("[Parser] Found filename pattern -> " + pendingFilename);
-                    }
-                }
+        std::vector<std::pair<const FileSection*, std::string_view>> replacements;
+        for (const auto& [id, edit] : sectionEdits) {
+            auto it = std::find_if(sections.begin(), sections.end(), [&](const FileSection& section) {
+                return section.id == id;
+            });
+            if (it == sections.end()) {
+                outputMessage("  [!] FAILED: " + path + " - unknown section " + id + " (file changed?)");
+                allSuccess = false;
+                replacements.clear();
+                break;
             }
+            replacements.push_back({&*it, edit->content});
         }
+        if (replacements.empty()) continue;
+        
+        // Replace from the end so earlier offsets stay valid; the parser trims
+        // trailing whitespace, so the section's own is kept
+        std::sort(replacements.begin(), replacements.end(), [](const auto& a, const auto& b) {
+            return a.first->offset > b.first->offset;
+        });
+        for (const auto& [section, text] : replacements) {
+            std::string_view original(content.data() + section->offset, section->length);
+            size_t end = original.find_last_not_of(" \t\r\n");
+            std::string tail(end == std::string_view::npos ? original : original.substr(end + 1));
+            content.replace(section->offset, section->length, std::string(text) + tail);
+        }
+        
+        auto storage = std::make_shared<ResponseArena>();
+        ParsedFile patched;
+        patched.filename = storage->copy(path);
+        patched.language = storage->copy(pathExtension(path));
+        patched.content = storage->adopt(std::move(content));
+        patched.storage = storage;
+        resolved.push_back(patched);
+        outputMessage("[Write] " + path + ": " + std::to_string(replacements.size()) + " section(s) replaced");
     }
-    
-    if (verbose_ && files.empty()) {
-        outputMessage("[Parser] No files detected. Code blocks found: " + std::to_string(codeBlockCount));
-    }
-    
-    // Check if model seems to be ignoring instructions
-    if (verbose_ && !files.empty()) {
-        outputMessage("[Parser] Total unique files: " + std::to_string(files.size()));
+    return resolved;
+}
+
+std::vector<ParsedFile> Agent::expandSharedBlocks(const std::vector<ParsedFile>& files) const {
+    std::vector<ParsedFile> resolved;
+    for (const auto& file : files) {
+        std::string expanded;
+        if (!expandBlockReferences(file.content, sharedBlocks_, expanded)) {
+            resolved.push_back(file);
+            continue;
+        }
+        
+        auto storage = std::make_shared<ResponseArena>();
+        ParsedFile complete;
+        complete.filename = storage->copy(file.filename);
+        complete.language = storage->copy(file.language);
+        complete.content = storage->adopt(std::move(expanded));
+        complete.storage = storage;
+        resolved.push_back(complete);
+        outputMessage("[Write] " + std::string(file.filename) + ": shared block references expanded");
     }
-    
-    return files;
+    return resolved;
 }
 
-bool Agent::executeFileCreation(const std::vector<ParsedFile>& files) {
+bool Agent::executeFileCreation(const std::vector<ParsedFile>& generated) {
     createdFiles_.clear();
     bool allSuccess = true;
     std::string workDir = fileManager_.getWorkingDirectory();
     
     outputMessage("[Write] Target directory: " + workDir);
+    std::vector<ParsedFile> files = expandSharedBlocks(applySectionEdits(generated, allSuccess));
     
     for (const auto& file : files) {
-        std::string fullPath = workDir + "/" + file.filename;
+        std::string filename(file.filename);
+        std::string fullPath = workDir + "/" + filename;
         // Normalize path separators for Windows
         std::replace(fullPath.begin(), fullPath.end(), '/', '\\');
         
         // Check if file exists and get old size
-        std::string existingContent = fileManager_.readFile(file.filename);
+        std::string existingContent = fileManager_.readFile(filename);
         bool fileExists = !existingContent.empty();
         
-        outputMessage("[Write] " + file.filename + ":");
+        outputMessage("[Write] " + filename + ":");
         outputMessage("        Full path: " + fullPath);
         outputMessage("        New content: " + std::to_string(file.content.length()) + " bytes");
         if (fileExists) {
@@ -439,26 +941,30 @@ bool Agent::executeFileCreation(const std::vector<ParsedFile>& files) {
         
         if (verbose_) {
             // Show first 200 chars of content being written
-            std::string preview = file.content.substr(0, 200);
+            std::string preview(file.content.substr(0, 200));
             if (file.content.length() > 200) preview += "...";
             outputMessage("        Preview: " + preview);
         }
-        
-        if (fileManager_.createFile(file.filename, file.content)) {
-            createdFiles_.push_back(file.filename);
-            
-            // Verify the write
-            std::string verifyContent = fileManager_.readFile(file.filename);
-            if (verifyContent == file.content) {
-                outputMessage("  [+] SUCCESS: " + file.filename + " (" + std::to_string(file.content.length()) + " bytes written)");
-            } else if (verifyContent.empty()) {
-                outputMessage("  [!] VERIFY FAILED: File appears empty after write!");
-                allSuccess = false;
-            } else {
-                outputMessage("  [?] PARTIAL: Written " + std::to_string(verifyContent.length()) + " of " + std::to_string(file.content.length()) + " bytes");
-            }
+    }
+    
+    // Content is written straight from the response arena by the writer
+    // stage; results arrive in completion order
+    if (!fileWriter_) {
+        fileWriter_ = std::make_shared<FileWriter>();
+    }
+    if (verbose_) {
+        outputMessage("[Write] Backend: " + fileWriter_->getBackendName());
+    }
+    uint64_t batch = fileWriter_->submit(workDir, files);
+    
+    WriteResult result;
+    while (fileWriter_->nextResult(batch, result)) {
+        if (result.success) {
+            createdFiles_.push_back(result.filename);
+            outputMessage("  [+] SUCCESS: " + result.filename + " (" + std::to_string(result.bytes) + " bytes written)");
+            publishEvent(AgentEventType::FileWritten, result.filename);
         } else {
-            outputMessage("  [!] FAILED: " + file.filename + " - " + fileManager_.getLastError());
+            outputMessage("  [!] FAILED: " + result.filename + " - " + result.error);
             allSuccess = false;
         }
     }
@@ -473,7 +979,7 @@ std::string Agent::extractExplanation(const std::string& response) const {
     bool inCodeBlock = false;
     
     while (std::getline(stream, line)) {
-        if (line.find("```") == 0 || trimString(line).find("```") == 0) {
+        if (line.find("```") == 0 || StreamingFileParser::trim(line).find("```") == 0) {
             inCodeBlock = !inCodeBlock;
             continue;
         }
@@ -482,7 +988,7 @@ std::string Agent::extractExplanation(const std::string& response) const {
             // Skip lines that look like file headers
             std::string upper = line;
             std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
-            if (upper.find("FILE:") != std::string::npos) continue;
+            if (upper.find("FILE:") != std::string::npos || upper.find("SECTION:") == 0) continue;
             
             explanation += line + "\n";
         }
@@ -495,7 +1001,49 @@ void Agent::setOutputCallback(OutputCallback callback) {
     outputCallback_ = callback;
 }
 
+void Agent::setClient(OllamaClient& client) {
+    client_ = &client;
+}
+
+void Agent::setEventQueue(std::shared_ptr<AgentEventQueue> queue) {
+    eventQueue_ = queue;
+}
+
+bool Agent::publishEvent(AgentEventType type, const std::string& text, const GenerationStats& stats) const {
+    if (!eventQueue_) {
+        return false;
+    }
+    AgentEvent event;
+    event.type = type;
+    event.text = text;
+    event.stats = stats;
+    return eventQueue_->tryPush(std::move(event));
+}
+
 void Agent::outputMessage(const std::string& message) const {
+    // With a queue, status lines only go through it, so they stay in order
+    // with what is already queued. A full queue gets a moment to drain;
+    // after that the line is dropped and counted, and the count is
+    // reported ahead of the next line that gets through.
+    if (eventQueue_) {
+        auto deadline = std::chrono::steady_clock::now() + kStatusQueueWait;
+        size_t dropped = droppedStatus_.load();
+        std::string text = dropped > 0
+            ? "[!] " + std::to_string(dropped) + " status message(s) dropped (output queue full)\n" + message
+            : message;
+        while (!publishEvent(AgentEventType::Status, text)) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                droppedStatus_++;
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        droppedStatus_ -= dropped;
+        return;
+    }
+    if (prefillThread) {
+        return;
+    }
     if (outputCallback_) {
         outputCallback_(message);
     } else {
@@ -516,15 +1064,14 @@ bool Agent::processRequest(const std::string& userRequest) {
     std::string systemPrompt = buildSystemPrompt();
     
     // Get existing files context
-    std::string existingFiles = getExistingFilesContext();
+    RequestBody existingFiles = getExistingFilesContext(userRequest);
     
-    // Combine user request with existing files
-    std::string fullRequest = userRequest;
+    // Combine user request with existing files (contents stay on disk until sent)
+    RequestBody fullRequest = buildUserMessage(existingFiles, userRequest);
     if (!existingFiles.empty()) {
-        fullRequest = userRequest + existingFiles;
         outputMessage("[i] Including existing project files in context...");
         if (verbose_) {
-            outputMessage("[i] Context size: " + std::to_string(existingFiles.length()) + " bytes");
+            outputMessage("[i] Context size: " + std::to_string(existingFiles.getSourceSize()) + " bytes");
         }
     } else {
         if (verbose_) {
@@ -533,24 +1080,74 @@ bool Agent::processRequest(const std::string& userRequest) {
     }
     
     printStatus("Sending request to Ollama...");
-    std::string response = client_.chat(systemPrompt, fullRequest);
+    std::vector<ParsedFile> files;
+    bool fanOut = (fanOut_ > 0) && !structuredOutput_;
+    bool racing = (raceModels_.size() >= 2) && !structuredOutput_ && !fanOut;
+    std::string response;
+    if (fanOut) {
+        // Falls through to a single request if no multi-file plan comes back
+        response = fanOutChat(systemPrompt, fullRequest);
+        fanOut = !response.empty();
+    }
+    if (fanOut) {
+        // Files were generated separately and assembled into response
+    } else if (structuredOutput_) {
+        response = structuredChat(systemPrompt, fullRequest, files);
+    } else if (racing) {
+        response = raceChat(systemPrompt, fullRequest, userRequest);
+    } else if (earlyStop_ || checkpointLog_) {
+        response = streamedChat(systemPrompt, fullRequest, userRequest);
+    } else {
+        response = client_->chat(systemPrompt, fullRequest);
+    }
     
     if (response.empty()) {
-        lastResponse_ = "Error: Failed to get response from Ollama. " + client_.getLastError();
+        lastResponse_ = "Error: Failed to get response from Ollama. " + client_->getLastError();
         outputMessage(lastResponse_);
         return false;
     }
     
+    GenerationStats stats = client_->getLastStats();
+    if (!racing && !fanOut && stats.valid) {
+        publishEvent(AgentEventType::Stats, client_->getModel(), stats);
+        if (stats.loadMs >= 1000) {
+            outputMessage("[i] Model load took " + std::to_string(stats.loadMs / 1000) + "." +
+                          std::to_string((stats.loadMs % 1000) / 100) + " s (cold start)");
+        }
+        if (verbose_) {
+            long long tokensPerSec = stats.evalMs > 0 ? stats.evalCount * 1000 / stats.evalMs : 0;
+            outputMessage("[Stats] load " + std::to_string(stats.loadMs) + " ms, prompt " +
+                          std::to_string(stats.promptEvalCount) + " tokens in " +
+                          std::to_string(stats.promptEvalMs) + " ms, output " +
+                          std::to_string(stats.evalCount) + " tokens in " +
+                          std::to_string(stats.evalMs) + " ms (" + std::to_string(tokensPerSec) + " tok/s)");
+        }
+    }
+    
+    if (client_->getLastAttemptCount() > 1) {
+        printStatus("Request succeeded after " + std::to_string(client_->getLastAttemptCount()) + " attempts");
+    }
+    
     lastResponse_ = response;
     printStatus("Received response from Ollama");
+    if (client_->wasLastResponseCached()) {
+        outputMessage("[i] Response served from cache");
+    }
     
     // Debug: show raw response in verbose mode
     if (verbose_) {
         outputMessage("\n=== RAW RESPONSE ===\n" + response + "\n=== END RESPONSE ===\n");
     }
     
-    // Parse files from response
-    std::vector<ParsedFile> files = parseFilesFromResponse(response);
+    // Parse files from response (structured output is already decoded)
+    if (!structuredOutput_) {
+        files = parseFilesFromResponse(response);
+    } else if (files.empty()) {
+        outputMessage("\n" + response);
+        outputMessage("\n[No files decoded from structured response]");
+        outputMessage("Tip: The model may not support structured output - try /structured off.");
+        return true;
+    }
     
     if (files.empty()) {
         outputMessage("\n" + response);
@@ -574,7 +1171,7 @@ bool Agent::processRequest(const std::string& userRequest) {
     }
     
     // Print explanation
-    std::string explanation = extractExplanation(response);
+    std::string explanation = structuredOutput_ ? "" : extractExplanation(response);
     if (!explanation.empty()) {
         outputMessage("\n" + explanation);
     }
@@ -589,35 +1186,22 @@ bool Agent::processRequest(const std::string& userRequest) {
     }
     
     // Check if model might have ignored parts of the request
-    std::string lowerRequest = userRequest;
-    std::transform(lowerRequest.begin(), lowerRequest.end(), lowerRequest.begin(), ::tolower);
-    
-    bool expectedCss = (lowerRequest.find("css") != std::string::npos || 
-                        lowerRequest.find("style") != std::string::npos);
-    bool expectedNewPages = (lowerRequest.find("page") != std::string::npos && 
-                            (lowerRequest.find("new") != std::string::npos || 
-                             lowerRequest.find("create") != std::string::npos ||
-                             lowerRequest.find("add") != std::string::npos));
-    bool expectedNav = (lowerRequest.find("nav") != std::string::npos || 
-                       lowerRequest.find("menu") != std::string::npos ||
-                       lowerRequest.find("link") != std::string::npos);
+    RequestExpectations expected = analyzeRequest(userRequest);
     
     bool hasCss = false;
-    bool hasMultipleHtml = false;
     int htmlCount = 0;
     for (const auto& f : createdFiles_) {
         if (f.find(".css") != std::string::npos) hasCss = true;
         if (f.find(".html") != std::string::npos || f.find(".htm") != std::string::npos) htmlCount++;
     }
-    hasMultipleHtml = (htmlCount > 1);
     
     // Warn if model seems to have ignored the request
     bool mightHaveIgnored = false;
-    if (expectedCss && !hasCss) {
+    if (expected.css && !hasCss) {
         outputMessage("\n[!] WARNING: You asked for CSS/styles but no .css file was created.");
         mightHaveIgnored = true;
     }
-    if (expectedNewPages && !hasMultipleHtml && htmlCount <= 1) {
+    if (expected.newPages && htmlCount <= 1) {
         outputMessage("[!] WARNING: You asked for new pages but only " + std::to_string(htmlCount) + " HTML file(s) created.");
         mightHaveIgnored = true;
     }
@@ -638,6 +1222,554 @@ bool Agent::processRequest(const std::string& userRequest) {
     return success;
 }
 
+std::string Agent::raceChat(const std::string& systemPrompt, const RequestBody& fullRequest,
+                            const std::string& userRequest) {
+    RequestExpectations expected = analyzeRequest(userRequest);
+    
+    struct Racer {
+        std::unique_ptr<OllamaClient> client;
+        CancellationToken token;
+        std::string response;
+        bool valid = false;
+        bool aborted = false;
+        long long elapsedMs = 0;
+    };
+    
+    std::vector<Racer> racers(raceModels_.size());
+    std::string modelList;
+    for (size_t i = 0; i < raceModels_.size(); ++i) {
+        racers[i].client = std::make_unique<OllamaClient>(client_->getConfig());
+        racers[i].client->setModel(raceModels_[i]);
+        racers[i].client->setRetryPolicy(client_->getRetryPolicy());
+        racers[i].client->setCancellationToken(racers[i].token);
+        if (i > 0) modelList += ", ";
+        modelList += raceModels_[i];
+    }
+    outputMessage("[Race] Racing " + std::to_string(racers.size()) + " models: " + modelList);
+    
+    std::mutex winnerMutex;
+    int winner = -1;
+    std::atomic<size_t> finished{0};
+    auto start = std::chrono::steady_clock::now();
+    
+    auto cancelOthers = [&](size_t keep) {
+        for (size_t j = 0; j < racers.size(); ++j) {
+            if (j != keep) racers[j].token.cancel();
+        }
+    };
+    
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < racers.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            Racer& racer = racers[i];
+            StreamingFileParser parser;
+            bool stoppedEarly = false;
+            
+            racer.response = racer.client->chatStream(systemPrompt, fullRequest,
+                [&](const std::string& chunk) {
+                    parser.feed(chunk);
+                    if (earlyStop_ && isResponseComplete(parser, expected)) {
+                        stoppedEarly = true;
+                        return false;
+                    }
+                    return true;
+                });
+            parser.finish();
+            
+            racer.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            racer.aborted = racer.token.isCancelled();
+            
+            // Valid = complete transfer (or cut off once complete), all fences
+            // closed, expected files present
+            bool transferOk = stoppedEarly || racer.client->getLastErrorKind() == RequestError::None;
+            racer.valid = !racer.aborted && !racer.response.empty() && transferOk &&
+                          !parser.isInCodeBlock() &&
+                          meetsExpectations(expected, parser.getFiles());
+            
+            if (racer.valid) {
+                std::lock_guard<std::mutex> lock(winnerMutex);
+                if (winner < 0) {
+                    winner = static_cast<int>(i);
+                    cancelOthers(i);
+                }
+            }
+            finished++;
+        });
+    }
+    
+    // Forward cancellation of the main request to every racer
+    const CancellationToken& parentToken = client_->getCancellationToken();
+    while (finished.load() < racers.size()) {
+        if (parentToken.isCancelled()) {
+            cancelOthers(racers.size());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    
+    if (parentToken.isCancelled()) {
+        outputMessage("[Race] Cancelled");
+        return "";
+    }
+    
+    if (verbose_) {
+        for (size_t i = 0; i < racers.size(); ++i) {
+            const Racer& racer = racers[i];
+            std::string status = racer.aborted ? "aborted"
+                : racer.valid ? "valid"
+                : racer.client->getLastErrorKind() != RequestError::None ? "failed: " + racer.client->getLastError()
+                : "invalid";
+            outputMessage("[Race] " + raceModels_[i] + ": " + status + " after " +
+                          std::to_string(racer.elapsedMs) + " ms");
+        }
+    }
+    
+    // No valid response - fall back to the first complete one
+    if (winner < 0) {
+        long long bestMs = -1;
+        for (size_t i = 0; i < racers.size(); ++i) {
+            if (racers[i].aborted || racers[i].response.empty()) continue;
+            if (bestMs < 0 || racers[i].elapsedMs < bestMs) {
+                bestMs = racers[i].elapsedMs;
+                winner = static_cast<int>(i);
+            }
+        }
+        if (winner < 0) {
+            outputMessage("[Race] All models failed");
+            return "";
+        }
+        outputMessage("[Race] No response passed validation, using " + raceModels_[winner]);
+    } else {
+        outputMessage("[Race] Winner: " + raceModels_[winner] + " (" +
+                      std::to_string(racers[winner].elapsedMs) + " ms)");
+    }
+    
+    return racers[winner].response;
+}
+
+std::string Agent::structuredChat(const std::string& systemPrompt, const RequestBody& fullRequest,
+                                  std::vector<ParsedFile>& files) {
+    ParserLogCallback log;
+    if (verbose_) {
+        log = [this](const std::string& message) { outputMessage(message); };
+    }
+    
+    // Files are decoded one by one as their JSON objects complete
+    StructuredFileDecoder decoder(log);
+    size_t reported = 0;
+    std::string response = client_->chatStream(systemPrompt, fullRequest,
+        [&](const std::string& chunk) {
+            publishEvent(AgentEventType::TokenDelta, chunk);  // Dropped if the queue is full
+            decoder.feed(chunk);
+            while (reported < decoder.getFiles().size()) {
+                printStatus("Received " + std::string(decoder.getFiles()[reported].filename));
+                reported++;
+            }
+            // Nothing useful follows the closing brace (some models keep
+            // emitting whitespace until num_predict runs out)
+            return !(earlyStop_ && decoder.isComplete());
+        },
+        StructuredFileDecoder::schema());
+    
+    bool stoppedEarly = earlyStop_ && decoder.isComplete() &&
+                        client_->getLastErrorKind() == RequestError::Aborted;
+    if (client_->getLastErrorKind() != RequestError::None && !stoppedEarly) {
+        return "";
+    }
+    
+    files = decoder.getFiles();
+    return response;
+}
+
+std::string Agent::fanOutChat(const std::string& systemPrompt, const RequestBody& fullRequest) {
+    // Step 1: a small structured request for the file manifest
+    std::string planPrompt =
+        "You plan the files for a code generation task. Do not write any code.\n"
+        "List every file that must be created or modified to fulfil the request, "
+        "each with a one-line purpose.\n"
+        "Respond with a single JSON object: "
+        "{\"files\":[{\"path\":\"index.html\",\"purpose\":\"Home page linking to all other pages\"}]}\n\n"
+        "Working directory: " + fileManager_.getWorkingDirectory();
+    std::vector<PlannedFile> plan = parsePlan(client_->chat(planPrompt, fullRequest, planSchema()));
+    if (plan.size() < 2) {
+        printStatus("Plan has fewer than two files, using a single request");
+        return "";
+    }
+    
+    std::string manifest;
+    std::string names;
+    for (const auto& file : plan) {
+        manifest += "- " + file.path + ": " + file.purpose + "\n";
+        names += (names.empty() ? "" : ", ") + file.path;
+    }
+    outputMessage("[Plan] " + std::to_string(plan.size()) + " files: " + names);
+    
+    // Step 2: one request per file. Everything but the last line is shared,
+    // so the requests have a common prompt prefix.
+    RequestBody shared = fullRequest;
+    shared.appendEscaped("\n\n=== FILE PLAN ===\n" + manifest + "=== END FILE PLAN ===\n");
+    
+    struct FileJob {
+        std::string content;
+        std::string error;
+        long long elapsedMs = 0;
+    };
+    std::vector<FileJob> jobs(plan.size());
+    
+    CancellationToken fanOutToken;
+    std::atomic<size_t> nextJob{0};
+    std::atomic<size_t> finishedWorkers{0};
+    size_t workerCount = std::min(static_cast<size_t>(fanOut_), plan.size());
+    auto start = std::chrono::steady_clock::now();
+    
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < workerCount; ++w) {
+        workers.emplace_back([&]() {
+            OllamaClient worker(client_->getConfig());
+            worker.setRetryPolicy(client_->getRetryPolicy());
+            worker.setCancellationToken(fanOutToken);
+            
+            size_t i;
+            while ((i = nextJob++) < plan.size()) {
+                const PlannedFile& planned = plan[i];
+                FileJob& job = jobs[i];
+                
+                RequestBody body = shared;
+                body.appendEscaped("\nOutput ONLY the file " + planned.path + " (" + planned.purpose +
+                                   ") as a COMPLETE file in the FILE: format. The other files in the plan "
+                                   "are generated separately; keep names and links consistent with the plan.\n");
+                
+                RequestExpectations expected;
+                expected.files.push_back(toLower(baseName(planned.path)));
+                StreamingFileParser parser;
+                bool stoppedEarly = false;
+                
+                worker.chatStream(systemPrompt, body, [&](const std::string& chunk) {
+                    parser.feed(chunk);
+                    if (earlyStop_ && isResponseComplete(parser, expected)) {
+                        stoppedEarly = true;
+                        return false;
+                    }
+                    return true;
+                });
+                parser.finish();
+                job.elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                
+                if (!stoppedEarly && worker.getLastErrorKind() != RequestError::None) {
+                    job.error = worker.getLastError();
+                    continue;
+                }
+                
+                // Take the planned file; a single unnamed or misnamed file is accepted as it
+                const std::vector<ParsedFile>& found = parser.getFiles();
+                auto match = std::find_if(found.begin(), found.end(), [&](const ParsedFile& f) {
+                    return toLower(baseName(f.filename)) == expected.files[0];
+                });
+                if (match == found.end() && found.size() == 1) {
+                    match = found.begin();
+                }
+                if (match == found.end()) {
+                    job.error = "no file in response";
+                } else {
+                    job.content = std::string(match->content);
+                }
+            }
+            finishedWorkers++;
+        });
+    }
+    
+    // Forward cancellation of the main request to every worker
+    const CancellationToken& parentToken = client_->getCancellationToken();
+    while (finishedWorkers.load() < workerCount) {
+        if (parentToken.isCancelled()) {
+            fanOutToken.cancel();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    if (parentToken.isCancelled()) {
+        return "";
+    }
+    
+    // Step 3: assemble the files as one response in the usual format
+    std::string assembled;
+    size_t generated = 0;
+    long long slowestMs = 0;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        const FileJob& job = jobs[i];
+        if (!job.error.empty()) {
+            outputMessage("[Fan-out] " + plan[i].path + " failed: " + job.error);
+            continue;
+        }
+        if (verbose_) {
+            outputMessage("[Fan-out] " + plan[i].path + " done after " + std::to_string(job.elapsedMs) + " ms");
+        }
+        size_t dotPos = plan[i].path.rfind('.');
+        assembled += "FILE: " + plan[i].path + "\n```" + plan[i].path.substr(dotPos + 1) + "\n" +
+                     job.content + "\n```\n\n";
+        slowestMs = std::max(slowestMs, job.elapsedMs);
+        generated++;
+    }
+    outputMessage("[Fan-out] Generated " + std::to_string(generated) + "/" + std::to_string(plan.size()) +
+                  " files in " + std::to_string(slowestMs) + " ms");
+    return assembled;
+}
+
+std::string Agent::streamedChat(const std::string& systemPrompt, const RequestBody& fullRequest,
+                                const std::string& userRequest) {
+    RequestExpectations expected = analyzeRequest(userRequest);
+    StreamingFileParser parser;
+    bool stoppedEarly = false;
+    
+    // Output logged by an interrupted run of the same request is continued;
+    // the files it completed are parsed again from the log
+    std::string key;
+    std::string response;
+    if (checkpointLog_) {
+        key = CheckpointLog::makeKey(client_->getModel(), systemPrompt, fullRequest);
+        response = checkpointLog_->load(key);
+        if (!response.empty()) {
+            outputMessage("[i] Resuming interrupted generation (" + std::to_string(response.size()) +
+                          " bytes from checkpoint)");
+            publishEvent(AgentEventType::TokenDelta, response);
+            parser.feed(response);
+        }
+        if (!checkpointLog_->open(key)) {
+            outputMessage("[!] " + checkpointLog_->getLastError());
+        }
+    }
+    
+    auto onChunk = [&](const std::string& chunk) {
+        publishEvent(AgentEventType::TokenDelta, chunk);  // Dropped if the queue is full
+        if (checkpointLog_) {
+            checkpointLog_->append(chunk);
+        }
+        parser.feed(chunk);
+        if (earlyStop_ && isResponseComplete(parser, expected)) {
+            stoppedEarly = true;
+            return false;
+        }
+        return true;
+    };
+    
+    // A stream cut off by the connection or the timeout is continued with
+    // what arrived as the start of the reply, as long as it makes progress
+    for (int resumes = 0; ; resumes++) {
+        if (earlyStop_ && !response.empty() && isResponseComplete(parser, expected)) {
+            stoppedEarly = true;
+            break;
+        }
+        size_t received = response.size();
+        response += response.empty()
+            ? client_->chatStream(systemPrompt, fullRequest, onChunk)
+            : client_->continueChatStream(systemPrompt, fullRequest, response, onChunk);
+        
+        RequestError error = client_->getLastErrorKind();
+        if (stoppedEarly || error == RequestError::None) break;
+        bool resumable = checkpointLog_ && response.size() > received && resumes < kMaxStreamResumes &&
+                         (error == RequestError::ConnectFailed || error == RequestError::Timeout);
+        if (!resumable) break;
+        outputMessage("[i] Stream interrupted after " + std::to_string(response.size()) + " bytes (" +
+                      client_->getLastError() + "), continuing...");
+    }
+    
+    bool complete = stoppedEarly || client_->getLastErrorKind() == RequestError::None;
+    if (checkpointLog_) {
+        if (complete) {
+            checkpointLog_->remove(key);
+        } else {
+            checkpointLog_->close();
+            if (!response.empty()) {
+                outputMessage("[i] " + std::to_string(response.size()) +
+                              " bytes of output checkpointed; send the same request again to resume");
+            }
+        }
+    }
+    
+    if (stoppedEarly) {
+        // Only the transfer is dropped; the model stays loaded for keep_alive
+        printStatus("Stopped generation after the last expected file");
+        return response;
+    }
+    if (!complete) {
+        return "";
+    }
+    return response;
+}
+
+void Agent::setStructuredOutput(bool enabled) {
+    structuredOutput_ = enabled;
+    contextCached_ = false;  // Header and footer differ
+}
+
+bool Agent::isStructuredOutput() const {
+    return structuredOutput_;
+}
+
+void Agent::setFanOut(int maxParallel) {
+    fanOut_ = std::max(0, maxParallel);
+}
+
+int Agent::getFanOut() const {
+    return fanOut_;
+}
+
+void Agent::setEarlyStop(bool enabled) {
+    earlyStop_ = enabled;
+}
+
+bool Agent::isEarlyStop() const {
+    return earlyStop_;
+}
+
+void Agent::setCheckpointLog(std::shared_ptr<CheckpointLog> log) {
+    checkpointLog_ = std::move(log);
+}
+
+void Agent::setPrefill(bool enabled) {
+    prefill_ = enabled;
+}
+
+bool Agent::isPrefill() const {
+    return prefill_;
+}
+
+void Agent::startPrefill() {
+    stopPrefill();
+    bool fanOut = (fanOut_ > 0) && !structuredOutput_;
+    bool racing = (raceModels_.size() >= 2) && !structuredOutput_ && !fanOut;
+    if (!prefill_ || embeddingIndex_ || fanOut || racing) return;
+    
+    {
+        std::lock_guard<std::mutex> lock(prefillMutex_);
+        prefillStop_ = false;
+    }
+    // The connection is copied now; the client may be handed elsewhere meanwhile
+    prefillThread_ = std::thread(&Agent::prefillLoop, this, client_->getConfig());
+}
+
+void Agent::stopPrefill() {
+    {
+        std::lock_guard<std::mutex> lock(prefillMutex_);
+        prefillStop_ = true;
+    }
+    prefillWake_.notify_all();
+    if (prefillThread_.joinable()) {
+        prefillThread_.join();
+    }
+}
+
+void Agent::prefillLoop(OllamaConfig config) {
+    prefillThread = true;
+    
+    // A failed prefill only costs the request its head start; don't retry
+    OllamaClient primer(config);
+    RetryPolicy policy;
+    policy.maxAttempts = 1;
+    primer.setRetryPolicy(policy);
+    
+    // The context is rebuilt when files change and when a background
+    // summary lands, and either makes the prefilled prefix stale
+    auto summaryVersion = [this]() { return summaryCache_ ? summaryCache_->getVersion() : 0; };
+    bool primed = false;
+    uint64_t primedGeneration = 0;
+    uint64_t primedSummaryVersion = 0;
+    std::unique_lock<std::mutex> lock(prefillMutex_);
+    while (!prefillStop_) {
+        uint64_t generation = watcher_ ? watcher_->getGeneration() : 0;
+        uint64_t summaries = summaryVersion();
+        if (primed && generation == primedGeneration && summaries == primedSummaryVersion) {
+            prefillWake_.wait_for(lock, kPrefillPollInterval, [this]() { return prefillStop_; });
+            continue;
+        }
+        lock.unlock();
+        
+        // The same system prompt and context the next request starts with
+        std::string systemPrompt = buildSystemPrompt();
+        RequestBody prefix = buildUserMessage(getExistingFilesContext(""), "");
+        
+        // Sections are picked for the request, which isn't known yet: such
+        // a context can't be prefilled, and the one built for "" is dropped
+        if (cachedSectioned_) {
+            contextCached_ = false;
+            lock.lock();
+            primed = true;
+            primedGeneration = generation;
+            primedSummaryVersion = summaries;
+            continue;
+        }
+        
+        CancellationToken token;
+        primer.setCancellationToken(token);
+        std::atomic<bool> finished{false};
+        std::thread request([&]() {
+            primer.prefillChat(systemPrompt, prefix);
+            finished = true;
+        });
+        
+        // A change makes the prefix stale: cancel and send the new one
+        bool changed = false;
+        lock.lock();
+        while (!finished) {
+            prefillWake_.wait_for(lock, kPrefillPollInterval, [this]() { return prefillStop_; });
+            if (prefillStop_) {
+                token.cancel();
+            } else if (!changed && ((watcher_ && watcher_->getGeneration() != generation) ||
+                                    summaryVersion() != summaries)) {
+                changed = true;
+                token.cancel();
+            }
+        }
+        lock.unlock();
+        request.join();
+        lock.lock();
+        
+        if (!changed) {
+            primed = true;
+            primedGeneration = generation;
+            primedSummaryVersion = summaries;
+            GenerationStats stats = primer.getLastStats();
+            if (stats.valid) {
+                printStatus("Prefilled " + std::to_string(stats.promptEvalCount) + " prompt tokens in " +
+                            std::to_string(stats.promptEvalMs) + " ms");
+            }
+        }
+    }
+}
+
+void Agent::setContextLimits(const ContextLimits& limits) {
+    contextLimits_ = limits;
+    contextCached_ = false;
+}
+
+void Agent::setFileWriter(std::shared_ptr<FileWriter> writer) {
+    fileWriter_ = std::move(writer);
+}
+
+void Agent::setWorkspaceWatcher(std::shared_ptr<WorkspaceWatcher> watcher) {
+    watcher_ = std::move(watcher);
+    contextCached_ = false;
+}
+
+const ContextLimits& Agent::getContextLimits() const {
+    return contextLimits_;
+}
+
+void Agent::setRaceModels(const std::vector<std::string>& models) {
+    raceModels_ = models;
+}
+
+std::vector<std::string> Agent::getRaceModels() const {
+    return raceModels_;
+}
+
 std::string Agent::getLastResponse() const {
     return lastResponse_;
 }
@@ -0,0 +1,506 @@
+#include "agent_server.hpp"
+#include "json_parser.hpp"
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <cctype>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketHandle = SOCKET;
+static const SocketHandle kInvalidSocket = INVALID_SOCKET;
+static void closeSocket(SocketHandle s) { closesocket(s); }
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+using SocketHandle = int;
+static const SocketHandle kInvalidSocket = -1;
+static void closeSocket(SocketHandle s) { close(s); }
+#endif
+
+namespace ollama_agent {
+
+static const size_t kMaxHeaderBytes = 64 * 1024;
+static const size_t kMaxBodyBytes = 16 * 1024 * 1024;
+
+// ---------------------------------------------------------------------------
+// ClientPool
+
+ClientPool::Lease::Lease(ClientPool& pool, OllamaClient* client) : pool_(&pool), client_(client) {}
+
+ClientPool::Lease::Lease(Lease&& other) noexcept : pool_(other.pool_), client_(other.client_) {
+    other.client_ = nullptr;
+}
+
+ClientPool::Lease::~Lease() {
+    if (client_) {
+        pool_->release(client_);
+    }
+}
+
+ClientPool::ClientPool(const OllamaClient& prototype, size_t size) {
+    if (size == 0) size = 1;
+    for (size_t i = 0; i < size; ++i) {
+        auto client = std::make_unique<OllamaClient>(prototype.getConfig());
+        client->setRetryPolicy(prototype.getRetryPolicy());
+        client->setResponseCache(prototype.getResponseCache());
+        idle_.push_back(client.get());
+        clients_.push_back(std::move(client));
+    }
+}
+
+ClientPool::Lease ClientPool::acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    available_.wait(lock, [this] { return !idle_.empty(); });
+    OllamaClient* client = idle_.back();
+    idle_.pop_back();
+    return Lease(*this, client);
+}
+
+void ClientPool::release(OllamaClient* client) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle_.push_back(client);
+    }
+    available_.notify_one();
+}
+
+// ---------------------------------------------------------------------------
+// HTTP helpers
+
+static const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        default:  return "Internal Server Error";
+    }
+}
+
+static bool sendAll(SocketHandle socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int n = send(socket, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Read headers and a Content-Length body; returns false on malformed input
+static bool readRequest(SocketHandle socket, HttpRequest& request, int& status) {
+    std::string data;
+    char buffer[8192];
+    size_t headerEnd = std::string::npos;
+    
+    while ((headerEnd = data.find("\r\n\r\n")) == std::string::npos) {
+        if (data.size() > kMaxHeaderBytes) {
+            status = 413;
+            return false;
+        }
+        int n = recv(socket, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            status = 400;
+            return false;
+        }
+        data.append(buffer, static_cast<size_t>(n));
+    }
+    
+    std::istringstream headerStream(data.substr(0, headerEnd));
+    std::string requestLine;
+    std::getline(headerStream, requestLine);
+    std::istringstream requestLineStream(requestLine);
+    requestLineStream >> request.method >> request.path;
+    if (request.method.empty() || request.path.empty()) {
+        status = 400;
+        return false;
+    }
+    
+    size_t contentLength = 0;
+    std::string header;
+    while (std::getline(headerStream, header)) {
+        size_t colon = header.find(':');
+        if (colon == std::string::npos) continue;
+        std::string name = header.substr(0, colon);
+        for (auto& c : name) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        if (name == "content-length") {
+            try {
+                contentLength = std::stoul(header.substr(colon + 1));
+            } catch (...) {
+                status = 400;
+                return false;
+            }
+        }
+    }
+    
+    if (contentLength > kMaxBodyBytes) {
+        status = 413;
+        return false;
+    }
+    
+    request.body = data.substr(headerEnd + 4);
+    while (request.body.size() < contentLength) {
+        int n = recv(socket, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            status = 400;
+            return false;
+        }
+        request.body.append(buffer, static_cast<size_t>(n));
+    }
+    request.body.resize(contentLength);
+    return true;
+}
+
+static std::string errorJson(const std::string& message) {
+    return "{\"error\":\"" + JsonParser::escapeJson(message) + "\"}";
+}
+
+static std::string stringArrayJson(const std::vector<std::string>& items) {
+    std::string json = "[";
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (i > 0) json += ",";
+        json += "\"" + JsonParser::escapeJson(items[i]) + "\"";
+    }
+    return json + "]";
+}
+
+static SchedulerConfig schedulerConfig(const ServerConfig& config) {
+    SchedulerConfig scheduler = config.scheduler;
+    scheduler.maxConcurrent = std::max(1, config.clientPoolSize);
+    return scheduler;
+}
+
+static std::string newSessionId() {
+    thread_local std::mt19937_64 rng(std::random_device{}());
+    std::ostringstream id;
+    id << std::hex << rng();
+    return id.str();
+}
+
+// ---------------------------------------------------------------------------
+// AgentServer
+
+AgentServer::AgentServer(const OllamaClient& prototype, const ServerConfig& config)
+    : config_(config),
+      defaultModel_(prototype.getModel()),
+      clientConfig_(prototype.getConfig()),
+      clientPool_(prototype, static_cast<size_t>(config.clientPoolSize)),
+      fileWriter_(std::make_shared<FileWriter>()),
+      scheduler_(schedulerConfig(config)) {}
+
+AgentServer::~AgentServer() {
+    stop();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+std::string AgentServer::getLastError() const {
+    return lastError_;
+}
+
+void AgentServer::stop() {
+    running_ = false;
+    queueReady_.notify_all();
+}
+
+bool AgentServer::run() {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        lastError_ = "Failed to initialize Winsock";
+        return false;
+    }
+#endif
+
+    SocketHandle listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == kInvalidSocket) {
+        lastError_ = "Failed to create socket";
+        return false;
+    }
+    
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+    
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<unsigned short>(config_.port));
+    if (inet_pton(AF_INET, config_.bindAddress.c_str(), &address.sin_addr) != 1) {
+        lastError_ = "Invalid bind address: " + config_.bindAddress;
+        closeSocket(listener);
+        return false;
+    }
+    
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, 64) != 0) {
+        lastError_ = "Cannot listen on " + config_.bindAddress + ":" + std::to_string(config_.port);
+        closeSocket(listener);
+        return false;
+    }
+    
+    running_ = true;
+    for (int i = 0; i < std::max(1, config_.workerThreads); ++i) {
+        workers_.emplace_back(&AgentServer::workerLoop, this);
+    }
+    
+    // Wake up periodically so stop() is noticed without a new connection
+    while (running_) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(listener, &readSet);
+        timeval timeout{0, 200000};
+        int ready = select(static_cast<int>(listener) + 1, &readSet, nullptr, nullptr, &timeout);
+        if (ready <= 0) continue;
+        
+        SocketHandle connection = accept(listener, nullptr, nullptr);
+        if (connection == kInvalidSocket) continue;
+        
+        {
+            std::lock_guard<std::mutex> lock(queueMutex_);
+            pendingConnections_.push_back(static_cast<long long>(connection));
+        }
+        queueReady_.notify_one();
+    }
+    
+    closeSocket(listener);
+    queueReady_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) worker.join();
+    }
+    workers_.clear();
+
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return true;
+}
+
+void AgentServer::workerLoop() {
+    while (true) {
+        long long connection;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex_);
+            queueReady_.wait(lock, [this] { return !pendingConnections_.empty() || !running_; });
+            if (pendingConnections_.empty()) return;
+            connection = pendingConnections_.front();
+            pendingConnections_.pop_front();
+        }
+        handleConnection(connection);
+    }
+}
+
+void AgentServer::handleConnection(long long socket) {
+    SocketHandle connection = static_cast<SocketHandle>(socket);
+    
+    HttpRequest request;
+    int status = 200;
+    std::string body;
+    if (readRequest(connection, request, status)) {
+        try {
+            body = route(request, status);
+        } catch (const std::exception& e) {
+            status = 500;
+            body = errorJson(e.what());
+        }
+    } else {
+        body = errorJson("Malformed request");
+    }
+    
+    std::ostringstream response;
+    response << "HTTP/1.1 " << status << " " << statusText(status) << "\r\n"
+             << "Content-Type: application/json\r\n"
+             << "Content-Length: " << body.size() << "\r\n"
+             << "Connection: close\r\n\r\n"
+             << body;
+    sendAll(connection, response.str());
+    closeSocket(connection);
+}
+
+std::shared_ptr<Session> AgentServer::findSession(const std::string& id) {
+    std::lock_guard<std::mutex> lock(sessionsMutex_);
+    auto it = sessions_.find(id);
+    return (it != sessions_.end()) ? it->second : nullptr;
+}
+
+std::string AgentServer::route(const HttpRequest& request, int& status) {
+    const std::string& path = request.path;
+    
+    if (path == "/health") {
+        std::lock_guard<std::mutex> lock(sessionsMutex_);
+        return "{\"status\":\"ok\",\"model\":\"" + JsonParser::escapeJson(defaultModel_) +
+               "\",\"sessions\":" + std::to_string(sessions_.size()) +
+               ",\"running\":" + std::to_string(scheduler_.getRunningCount()) +
+               ",\"queued\":" + std::to_string(scheduler_.getQueuedCount()) +
+               ",\"loadedModel\":\"" + JsonParser::escapeJson(scheduler_.getLoadedModel()) + "\"}";
+    }
+    
+    if (path == "/sessions") {
+        if (request.method == "POST") return createSession(request, status);
+        if (request.method == "GET") return listSessions();
+        status = 405;
+        return errorJson("Method not allowed");
+    }
+    
+    const std::string prefix = "/sessions/";
+    if (path.compare(0, prefix.size(), prefix) == 0) {
+        std::string rest = path.substr(prefix.size());
+        size_t slash = rest.find('/');
+        std::string id = rest.substr(0, slash);
+        std::string action = (slash == std::string::npos) ? "" : rest.substr(slash + 1);
+        
+        auto session = findSession(id);
+        if (!session) {
+            status = 404;
+            return errorJson("Unknown session: " + id);
+        }
+        
+        if (action.empty() && request.method == "GET") {
+            return describeSession(session);
+        }
+        if (action.empty() && request.method == "DELETE") {
+            std::lock_guard<std::mutex> lock(sessionsMutex_);
+            sessions_.erase(id);
+            scheduler_.removeSession(id);
+            return "{\"deleted\":\"" + JsonParser::escapeJson(id) + "\"}";
+        }
+        if (action == "requests" && request.method == "POST") {
+            return runRequest(session, request, status);
+        }
+        status = 405;
+        return errorJson("Method not allowed");
+    }
+    
+    status = 404;
+    return errorJson("Not found");
+}
+
+std::string AgentServer::createSession(const HttpRequest& request, int& status) {
+    auto session = std::make_shared<Session>();
+    session->id = newSessionId();
+    session->model = JsonParser::getString(request.body, "model").value_or(defaultModel_);
+    if (session->model.empty()) session->model = defaultModel_;
+    
+    std::string workDir = JsonParser::getString(request.body, "workdir").value_or(config_.defaultWorkingDir);
+    try {
+        session->fileManager = std::make_unique<FileManager>(workDir.empty() ? config_.defaultWorkingDir : workDir);
+    } catch (const std::exception& e) {
+        status = 400;
+        return errorJson(std::string("Invalid working directory: ") + e.what());
+    }
+    
+    // The agent is bound to a pooled client only while a request runs;
+    // taking one here would wait behind running jobs
+    OllamaConfig clientConfig = clientConfig_;
+    clientConfig.model = session->model;
+    session->idleClient = std::make_unique<OllamaClient>(clientConfig);
+    session->agent = std::make_unique<Agent>(*session->idleClient, *session->fileManager);
+    session->agent->setStructuredOutput(JsonParser::getBool(request.body, "structured").value_or(false));
+    session->agent->setEarlyStop(JsonParser::getBool(request.body, "early_stop").value_or(false));
+    session->agent->setContextLimits(config_.contextLimits);
+    session->agent->setFileWriter(fileWriter_);
+    session->agent->setWorkspaceWatcher(
+        std::make_shared<WorkspaceWatcher>(session->fileManager->getWorkingDirectory()));
+    
+    Session* raw = session.get();
+    session->agent->setOutputCallback([raw](const std::string& message) {
+        std::lock_guard<std::mutex> lock(raw->statusMutex);
+        raw->output.push_back(message);
+    });
+    // No prefill here: each session would send its own prompt evaluation
+    // past the scheduler's concurrency cap and model grouping
+    
+    auto weight = JsonParser::getInt(request.body, "weight");
+    if (weight.has_value() && weight.value() > 0) {
+        scheduler_.setSessionWeight(session->id, static_cast<double>(weight.value()));
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex_);
+        sessions_[session->id] = session;
+    }
+    
+    status = 201;
+    return describeSession(session);
+}
+
+std::string AgentServer::listSessions() {
+    std::vector<std::string> ids;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex_);
+        for (const auto& entry : sessions_) {
+            ids.push_back(entry.first);
+        }
+    }
+    return "{\"sessions\":" + stringArrayJson(ids) + "}";
+}
+
+std::string AgentServer::describeSession(const std::shared_ptr<Session>& session) {
+    // Only the status lock: this must answer while a request runs
+    std::lock_guard<std::mutex> lock(session->statusMutex);
+    std::ostringstream json;
+    json << "{\"id\":\"" << JsonParser::escapeJson(session->id) << "\","
+         << "\"model\":\"" << JsonParser::escapeJson(session->model) << "\","
+         << "\"workdir\":\"" << JsonParser::escapeJson(session->fileManager->getWorkingDirectory()) << "\","
+         << "\"requests\":" << session->requestCount << ","
+         << "\"busy\":" << (session->busy ? "true" : "false") << ","
+         << "\"lastResponse\":\"" << JsonParser::escapeJson(session->lastResponse) << "\"}";
+    return json.str();
+}
+
+std::string AgentServer::runRequest(const std::shared_ptr<Session>& session, const HttpRequest& request,
+                                    int& status) {
+    auto prompt = JsonParser::getString(request.body, "prompt");
+    if (!prompt.has_value() || prompt->empty()) {
+        status = 400;
+        return errorJson("Missing \"prompt\"");
+    }
+    
+    JobPriority priority = (JsonParser::getString(request.body, "priority").value_or("") == "batch")
+                               ? JobPriority::Batch
+                               : JobPriority::Interactive;
+    
+    std::lock_guard<std::mutex> sessionLock(session->mutex);
+    {
+        std::lock_guard<std::mutex> lock(session->statusMutex);
+        session->output.clear();
+        session->busy = true;
+    }
+    
+    bool success;
+    {
+        // The scheduler caps total in-flight jobs at the pool size, so the lease never blocks
+        auto ticket = scheduler_.admit(session->id, session->model, priority);
+        auto lease = clientPool_.acquire();
+        lease->setModel(session->model);
+        session->agent->setClient(*lease);
+        success = session->agent->processRequest(prompt.value());
+        session->agent->setClient(*session->idleClient);  // The lease goes back to the pool
+    }
+    
+    std::vector<std::string> output;
+    {
+        std::lock_guard<std::mutex> lock(session->statusMutex);
+        session->requestCount++;
+        session->busy = false;
+        session->lastResponse = session->agent->getLastResponse();
+        output.swap(session->output);
+    }
+    
+    std::ostringstream json;
+    json << "{\"success\":" << (success ? "true" : "false") << ","
+         << "\"files\":" << stringArrayJson(session->agent->getCreatedFiles()) << ","
+         << "\"output\":" << stringArrayJson(output) << "}";
+    return json.str();
+}
+
+} // namespace ollama_agent
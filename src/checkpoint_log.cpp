@@ -0,0 +1,110 @@
+#include "checkpoint_log.hpp"
+#include "content_hash.hpp"
+#include "response_cache.hpp"
+#include <sstream>
+#include <chrono>
+
+namespace ollama_agent {
+
+static const auto kMaxLogAge = std::chrono::hours(24 * 7);
+
+CheckpointLog::CheckpointLog(const std::string& directory)
+    : directory_(directory.empty() ? std::filesystem::path(defaultCacheDirectory()) / "checkpoints"
+                                   : std::filesystem::path(directory)) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    pruneStale();
+}
+
+CheckpointLog::~CheckpointLog() {
+    close();
+}
+
+std::string CheckpointLog::makeKey(const std::string& model, const std::string& systemPrompt,
+                                   const RequestBody& userContent) {
+    ContentHasher hasher;
+    hasher.update(model);
+    hasher.update(std::string_view("\n", 1));
+    hasher.update(systemPrompt);
+    hasher.update(std::string_view("\n", 1));
+    
+    RequestBody::Reader reader(userContent);
+    char buffer[16384];
+    size_t n;
+    while ((n = reader.read(buffer, sizeof(buffer))) > 0) {
+        hasher.update(std::string_view(buffer, n));
+    }
+    return hasher.hexDigest();
+}
+
+std::filesystem::path CheckpointLog::entryPath(const std::string& key) const {
+    return directory_ / (key + ".log");
+}
+
+std::string CheckpointLog::load(const std::string& key) const {
+    std::ifstream file(entryPath(key), std::ios::binary);
+    if (!file) return "";
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+bool CheckpointLog::open(const std::string& key) {
+    close();
+    openPath_ = entryPath(key);
+    file_.open(openPath_, std::ios::binary | std::ios::app);
+    if (!file_) {
+        lastError_ = "Cannot write checkpoint: " + openPath_.string();
+        openPath_.clear();
+        return false;
+    }
+    return true;
+}
+
+void CheckpointLog::append(std::string_view delta) {
+    if (!file_.is_open()) return;
+    // Flushed per delta: a crash loses at most the delta being written
+    file_.write(delta.data(), static_cast<std::streamsize>(delta.size()));
+    file_.flush();
+}
+
+void CheckpointLog::close() {
+    if (!file_.is_open()) return;
+    file_.close();
+    std::error_code ec;
+    if (std::filesystem::file_size(openPath_, ec) == 0 && !ec) {
+        std::filesystem::remove(openPath_, ec);
+    }
+    openPath_.clear();
+}
+
+void CheckpointLog::remove(const std::string& key) {
+    if (file_.is_open() && openPath_ == entryPath(key)) {
+        file_.close();
+        openPath_.clear();
+    }
+    std::error_code ec;
+    std::filesystem::remove(entryPath(key), ec);
+}
+
+std::string CheckpointLog::getDirectory() const {
+    return directory_.string();
+}
+
+std::string CheckpointLog::getLastError() const {
+    return lastError_;
+}
+
+void CheckpointLog::pruneStale() {
+    std::error_code ec;
+    auto now = std::filesystem::file_time_type::clock::now();
+    for (const auto& entry : std::filesystem::directory_iterator(directory_, ec)) {
+        if (entry.path().extension() != ".log") continue;
+        auto mtime = entry.last_write_time(ec);
+        if (!ec && now - mtime > kMaxLogAge) {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+} // namespace ollama_agent
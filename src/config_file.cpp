@@ -0,0 +1,233 @@
+#include "config_file.hpp"
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <set>
+
+namespace ollama_agent {
+
+// Keys accepted in the [agent] section; anything else is most likely a typo
+static const std::set<std::string> kAgentKeys = {
+    "host", "port", "model", "timeout", "keep_alive", "compress", "models_ttl",
+    "retries", "deadline", "structured", "early_stop", "checkpoint", "prefill", "fan_out", "embed_model", "top_k",
+    "summaries", "summary_model", "minify", "dedup",
+    "cache", "cache_dir", "cache_entries", "cache_bytes",
+    "server_port", "workers", "parallel", "per_model",
+    "context_files", "context_file_bytes", "context_budget", "context_section_bytes", "context_summary_bytes"
+};
+
+// [agent] keys holding non-negative integers and booleans; the rest are strings
+static const std::set<std::string> kIntKeys = {
+    "port", "timeout", "models_ttl", "retries", "deadline", "fan_out", "top_k",
+    "cache_entries", "cache_bytes", "server_port", "workers", "parallel", "per_model",
+    "context_files", "context_file_bytes", "context_budget", "context_section_bytes", "context_summary_bytes"
+};
+static const std::set<std::string> kBoolKeys = {
+    "compress", "structured", "early_stop", "checkpoint", "prefill", "summaries", "dedup", "cache"
+};
+
+static std::string trimmed(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+static std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+static std::optional<long long> parseInt(const std::string& text) {
+    if (text.empty()) return std::nullopt;
+    char* end = nullptr;
+    long long value = std::strtoll(text.c_str(), &end, 10);
+    if (*end != '\0') return std::nullopt;
+    return value;
+}
+
+static std::optional<double> parseDouble(const std::string& text) {
+    if (text.empty()) return std::nullopt;
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (*end != '\0') return std::nullopt;
+    return value;
+}
+
+std::string defaultConfigPath() {
+#ifdef _WIN32
+    if (const char* appData = std::getenv("APPDATA")) {
+        return (std::filesystem::path(appData) / "OllamaAgent" / "config.ini").string();
+    }
+#else
+    if (const char* xdg = std::getenv("XDG_CONFIG_HOME")) {
+        if (*xdg) return (std::filesystem::path(xdg) / "ollama_agent" / "config.ini").string();
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return (std::filesystem::path(home) / ".config" / "ollama_agent" / "config.ini").string();
+    }
+#endif
+    return "ollama_agent.ini";
+}
+
+bool ConfigFile::setProfileValue(ModelProfile& profile, const std::string& key, const std::string& value) {
+    if (key == "keep_alive") {
+        profile.keepAlive = value;
+        return !value.empty();
+    }
+    if (key == "temperature") {
+        auto number = parseDouble(value);
+        if (!number.has_value() || *number < 0) return false;
+        profile.options.temperature = number;
+        return true;
+    }
+    
+    auto number = parseInt(value);
+    if (!number.has_value()) return false;
+    int intValue = static_cast<int>(*number);
+    if (key == "num_ctx" && intValue > 0) {
+        profile.options.numCtx = intValue;
+    } else if (key == "num_predict" && intValue >= -2) {
+        profile.options.numPredict = intValue;
+    } else if (key == "num_thread" && intValue > 0) {
+        profile.options.numThread = intValue;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string ConfigFile::checkAgentValue(const std::string& key, const std::string& value) {
+    if (kIntKeys.count(key)) {
+        auto number = parseInt(value);
+        if (!number.has_value()) return "'" + key + "' expects a number, got '" + value + "'";
+        if (*number < 0) return "'" + key + "' must not be negative";
+    } else if (kBoolKeys.count(key)) {
+        std::string text = lowercase(value);
+        if (text != "true" && text != "yes" && text != "on" && text != "1" &&
+            text != "false" && text != "no" && text != "off" && text != "0") {
+            return "'" + key + "' expects on/off, got '" + value + "'";
+        }
+    }
+    return "";
+}
+
+bool ConfigFile::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        lastError_ = "Cannot open " + path;
+        return false;
+    }
+    
+    settings_.clear();
+    profiles_.clear();
+    warnings_.clear();
+    
+    std::string section = "agent";
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = trimmed(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';') continue;
+        
+        std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+        
+        if (line.front() == '[') {
+            if (line.back() != ']') {
+                lastError_ = where + "unterminated section header";
+                return false;
+            }
+            section = trimmed(line.substr(1, line.size() - 2));
+            if (section.compare(0, 6, "model ") == 0) {
+                // Model names are case-sensitive and may contain ':'
+                std::string name = trimmed(section.substr(6));
+                section = "model " + name;
+                profiles_[name];
+            } else if (lowercase(section) == "agent") {
+                section = "agent";
+            } else {
+                lastError_ = where + "unknown section [" + section + "]";
+                return false;
+            }
+            continue;
+        }
+        
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            lastError_ = where + "expected key = value";
+            return false;
+        }
+        std::string key = lowercase(trimmed(line.substr(0, equals)));
+        std::string value = trimmed(line.substr(equals + 1));
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
+        } else {
+            // Trailing comment after whitespace: "num_ctx = 8192  # for 16 GB"
+            size_t comment = value.find_first_of("#;");
+            while (comment != std::string::npos && comment > 0 &&
+                   value[comment - 1] != ' ' && value[comment - 1] != '\t') {
+                comment = value.find_first_of("#;", comment + 1);
+            }
+            if (comment != std::string::npos) {
+                value = trimmed(value.substr(0, comment));
+            }
+        }
+        
+        if (section == "agent") {
+            if (kAgentKeys.count(key) == 0) {
+                lastError_ = where + "unknown setting '" + key + "'";
+                return false;
+            }
+            std::string problem = checkAgentValue(key, value);
+            if (!problem.empty()) {
+                warnings_.push_back(where + problem + "; using the default");
+                continue;
+            }
+            settings_[key] = value;
+        } else if (!setProfileValue(profiles_[section.substr(6)], key, value)) {
+            lastError_ = where + "invalid model setting '" + key + "'";
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+std::optional<std::string> ConfigFile::getString(const std::string& key) const {
+    auto it = settings_.find(key);
+    if (it == settings_.end()) return std::nullopt;
+    return it->second;
+}
+
+std::optional<long long> ConfigFile::getInt(const std::string& key) const {
+    auto value = getString(key);
+    if (!value.has_value()) return std::nullopt;
+    return parseInt(*value);
+}
+
+std::optional<bool> ConfigFile::getBool(const std::string& key) const {
+    auto value = getString(key);
+    if (!value.has_value()) return std::nullopt;
+    std::string text = lowercase(*value);
+    if (text == "true" || text == "yes" || text == "on" || text == "1") return true;
+    if (text == "false" || text == "no" || text == "off" || text == "0") return false;
+    return std::nullopt;
+}
+
+const std::map<std::string, ModelProfile>& ConfigFile::getProfiles() const {
+    return profiles_;
+}
+
+const std::vector<std::string>& ConfigFile::getWarnings() const {
+    return warnings_;
+}
+
+std::string ConfigFile::getLastError() const {
+    return lastError_;
+}
+
+} // namespace ollama_agent
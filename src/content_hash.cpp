@@ -0,0 +1,45 @@
+#include "content_hash.hpp"
+#include <cstdio>
+
+namespace ollama_agent {
+
+static constexpr uint64_t kFnvPrime = 1099511628211ULL;
+static constexpr uint64_t kFnvOffset = 14695981039346656037ULL;
+static constexpr uint64_t kSecondLaneSeed = 0x9E3779B97F4A7C15ULL;
+
+uint64_t fnv1a64(std::string_view data, uint64_t seed) {
+    uint64_t hash = seed;
+    for (unsigned char c : data) {
+        hash ^= c;
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+ContentHasher::ContentHasher() : lo_(kFnvOffset), hi_(kFnvOffset ^ kSecondLaneSeed) {}
+
+void ContentHasher::update(std::string_view data) {
+    lo_ = fnv1a64(data, lo_);
+    // Second lane uses a different mixing step so the two lanes collide independently
+    for (unsigned char c : data) {
+        hi_ ^= static_cast<uint64_t>(c) + 0x9E;
+        hi_ *= kFnvPrime;
+        hi_ ^= hi_ >> 29;
+    }
+}
+
+std::string ContentHasher::hexDigest() const {
+    char buffer[33];
+    std::snprintf(buffer, sizeof(buffer), "%016llx%016llx",
+                  static_cast<unsigned long long>(hi_),
+                  static_cast<unsigned long long>(lo_));
+    return std::string(buffer);
+}
+
+std::string contentHash(std::string_view data) {
+    ContentHasher hasher;
+    hasher.update(data);
+    return hasher.hexDigest();
+}
+
+} // namespace ollama_agent
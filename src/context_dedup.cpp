@@ -0,0 +1,221 @@
+#include "context_dedup.hpp"
+#include "content_hash.hpp"
+#include <unordered_map>
+#include <algorithm>
+
+namespace ollama_agent {
+
+static const uint64_t kRollingBase = 1099511628211ULL;
+static const size_t kMaxWindowOccurrences = 64;    // Per window hash; repetitive lines stay cheap
+
+// A text split into lines (without their line breaks) and line hashes
+struct LineTable {
+    std::vector<std::string_view> lines;
+    std::vector<uint64_t> hashes;
+    std::vector<uint64_t> windows;   // Rolling hash of the window starting at each line
+    bool finalBreak = false;
+};
+
+static LineTable splitLines(std::string_view text, size_t window) {
+    LineTable table;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos) eol = text.size();
+        table.lines.push_back(text.substr(pos, eol - pos));
+        table.hashes.push_back(fnv1a64(table.lines.back()));
+        pos = eol + 1;
+    }
+    table.finalBreak = !text.empty() && text.back() == '\n';
+    
+    // h(i+1) = (h(i) - line(i) * base^(window-1)) * base + line(i+window)
+    if (table.lines.size() < window) return table;
+    uint64_t top = 1;
+    for (size_t k = 1; k < window; k++) top *= kRollingBase;
+    uint64_t hash = 0;
+    for (size_t k = 0; k < window; k++) hash = hash * kRollingBase + table.hashes[k];
+    table.windows.push_back(hash);
+    for (size_t i = 1; i + window <= table.lines.size(); i++) {
+        hash = (hash - table.hashes[i - 1] * top) * kRollingBase + table.hashes[i + window - 1];
+        table.windows.push_back(hash);
+    }
+    return table;
+}
+
+static bool sameLine(const LineTable& a, size_t i, const LineTable& b, size_t j) {
+    return a.hashes[i] == b.hashes[j] && a.lines[i] == b.lines[j];
+}
+
+// Count the equal lines from a[i] and b[j] onwards
+static size_t commonRun(const LineTable& a, size_t i, const LineTable& b, size_t j) {
+    size_t length = 0;
+    while (i + length < a.lines.size() && j + length < b.lines.size() && sameLine(a, i + length, b, j + length)) {
+        length++;
+    }
+    return length;
+}
+
+static size_t runBytes(const LineTable& table, size_t start, size_t length) {
+    size_t bytes = 0;
+    for (size_t k = start; k < start + length; k++) bytes += table.lines[k].size() + 1;
+    return bytes;
+}
+
+std::string blockReference(const std::string& id) {
+    return "[[BLOCK " + id + "]]";
+}
+
+DeduplicatedFiles deduplicateBlocks(const std::vector<std::string_view>& texts, size_t minBytes, size_t minLines) {
+    size_t window = std::max<size_t>(minLines, 1);
+    std::vector<LineTable> tables;
+    std::unordered_map<uint64_t, std::vector<std::pair<size_t, size_t>>> occurrences;
+    for (size_t f = 0; f < texts.size(); f++) {
+        tables.push_back(splitLines(texts[f], window));
+        for (size_t i = 0; i < tables[f].windows.size(); i++) {
+            auto& list = occurrences[tables[f].windows[i]];
+            if (list.size() < kMaxWindowOccurrences) list.push_back({f, i});
+        }
+    }
+    
+    // A block is stored as the file and line range it was first found at
+    struct Candidate {
+        size_t file;
+        size_t start;
+        size_t length;
+        size_t uses;
+    };
+    struct Run {
+        size_t start;
+        size_t length;
+        size_t block;
+    };
+    std::vector<Candidate> candidates;
+    std::unordered_map<uint64_t, std::vector<size_t>> candidatesByWindow;
+    std::vector<std::vector<Run>> runs(texts.size());
+    
+    for (size_t f = 0; f < tables.size(); f++) {
+        const LineTable& table = tables[f];
+        size_t i = 0;
+        while (i < table.windows.size()) {
+            uint64_t hash = table.windows[i];
+            
+            // Reuse a block found earlier, so every copy references the same one
+            size_t best = candidates.size();
+            for (size_t index : candidatesByWindow[hash]) {
+                const Candidate& candidate = candidates[index];
+                if (commonRun(table, i, tables[candidate.file], candidate.start) >= candidate.length &&
+                    (best == candidates.size() || candidate.length > candidates[best].length)) {
+                    best = index;
+                }
+            }
+            if (best < candidates.size()) {
+                candidates[best].uses++;
+                runs[f].push_back({i, candidates[best].length, best});
+                i += candidates[best].length;
+                continue;
+            }
+            
+            // Otherwise the longest run this window shares with another file
+            size_t longest = 0;
+            for (const auto& [g, j] : occurrences[hash]) {
+                if (g != f) longest = std::max(longest, commonRun(table, i, tables[g], j));
+            }
+            if (longest >= window && runBytes(table, i, longest) >= minBytes) {
+                candidatesByWindow[hash].push_back(candidates.size());
+                runs[f].push_back({i, longest, candidates.size()});
+                candidates.push_back({f, i, longest, 1});
+                i += longest;
+                continue;
+            }
+            i++;
+        }
+    }
+    
+    // Only blocks used at least twice are worth a definition
+    DeduplicatedFiles result;
+    std::vector<size_t> blockOf(candidates.size(), std::string::npos);
+    for (size_t index = 0; index < candidates.size(); index++) {
+        const Candidate& candidate = candidates[index];
+        if (candidate.uses < 2) continue;
+        
+        SharedBlock block;
+        block.id = "B" + std::to_string(result.blocks.size() + 1);
+        block.uses = candidate.uses;
+        const LineTable& table = tables[candidate.file];
+        for (size_t k = candidate.start; k < candidate.start + candidate.length; k++) {
+            block.text.append(table.lines[k]);
+            block.text += '\n';
+        }
+        blockOf[index] = result.blocks.size();
+        result.blocks.push_back(std::move(block));
+    }
+    
+    for (size_t f = 0; f < tables.size(); f++) {
+        const LineTable& table = tables[f];
+        std::string text;
+        std::vector<size_t> references;
+        size_t next = 0;
+        size_t line = 0;
+        while (line < table.lines.size()) {
+            if (line > 0) text += '\n';
+            if (next < runs[f].size() && runs[f][next].start == line && blockOf[runs[f][next].block] != std::string::npos) {
+                size_t block = blockOf[runs[f][next].block];
+                text += blockReference(result.blocks[block].id);
+                if (std::find(references.begin(), references.end(), block) == references.end()) {
+                    references.push_back(block);
+                }
+                line += runs[f][next].length;
+                next++;
+                continue;
+            }
+            if (next < runs[f].size() && runs[f][next].start == line) next++;
+            text.append(table.lines[line]);
+            line++;
+        }
+        if (table.finalBreak) text += '\n';
+        result.texts.push_back(std::move(text));
+        result.references.push_back(std::move(references));
+    }
+    return result;
+}
+
+bool expandBlockReferences(std::string_view text, const std::map<std::string, std::string>& blocks,
+                           std::string& expanded) {
+    static const std::string_view prefix = "[[BLOCK ";
+    if (blocks.empty() || text.find(prefix) == std::string_view::npos) return false;
+    
+    std::string result;
+    bool found = false;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        size_t lineEnd = (eol == std::string_view::npos) ? text.size() : eol + 1;
+        std::string_view line = text.substr(pos, lineEnd - pos);
+        pos = lineEnd;
+        
+        // The reference must be alone on its line (indentation aside)
+        size_t start = line.find_first_not_of(" \t");
+        size_t end = line.find_last_not_of(" \t\r\n");
+        if (start != std::string_view::npos && line.compare(start, prefix.size(), prefix) == 0 &&
+            end > start && line.substr(end - 1, 2) == "]]") {
+            auto block = blocks.find(std::string(line.substr(start + prefix.size(), end - 1 - start - prefix.size())));
+            if (block != blocks.end()) {
+                std::string_view blockText = block->second;
+                // Keep the reference line's own line break (or its absence)
+                if (line.back() != '\n' && !blockText.empty() && blockText.back() == '\n') {
+                    blockText.remove_suffix(1);
+                }
+                result.append(blockText);
+                found = true;
+                continue;
+            }
+        }
+        result.append(line);
+    }
+    if (found) {
+        expanded = std::move(result);
+    }
+    return found;
+}
+
+} // namespace ollama_agent
@@ -0,0 +1,341 @@
+#include "context_minifier.hpp"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace ollama_agent {
+
+static std::string_view trimView(std::string_view text) {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos) return {};
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+static std::string_view trimRight(std::string_view text) {
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return end == std::string_view::npos ? std::string_view() : text.substr(0, end + 1);
+}
+
+static bool startsWith(std::string_view text, std::string_view prefix) {
+    return text.substr(0, prefix.size()) == prefix;
+}
+
+static std::string toLower(std::string_view text) {
+    std::string lower(text);
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    return lower;
+}
+
+// Collects output lines, keeping at most maxBlank blank lines in a row
+class LineSink {
+public:
+    explicit LineSink(int maxBlank) : maxBlank_(maxBlank) {}
+    
+    void line(std::string_view text) {
+        if (text.empty()) {
+            // Leading blank lines are dropped too
+            if (out_.empty() || blankRun_ >= maxBlank_) return;
+            blankRun_++;
+        } else {
+            blankRun_ = 0;
+        }
+        out_.append(text);
+        out_ += '\n';
+    }
+    
+    // Keep a line as-is, blank or not (string contents)
+    void raw(std::string_view text) {
+        blankRun_ = 0;
+        out_.append(text);
+        out_ += '\n';
+    }
+    
+    std::string take() {
+        while (!out_.empty() && out_.back() == '\n') out_.pop_back();
+        return std::move(out_);
+    }
+
+private:
+    int maxBlank_;
+    int blankRun_ = 0;
+    std::string out_;
+};
+
+// Minifies C-like lines (CSS, JS, JSON, C/C++): strips indentation,
+// tracking strings, template literals, raw strings, regex literals and
+// comments so the contents of multi-line strings are left alone
+class CodeLines {
+public:
+    explicit CodeLines(std::string_view language)
+        : lineComments_(language == "js" || language == "cpp"),
+          blockComments_(language != "json"),
+          templates_(language == "js"),
+          rawStrings_(language == "cpp") {}
+    
+    void process(std::string_view line, LineSink& sink) {
+        // Inside a multi-line string every character counts
+        if (inTemplate_ || !rawEnd_.empty()) {
+            std::string_view text = trimRight(line);
+            scan(text);
+            sink.raw(text);
+            return;
+        }
+        
+        std::string_view trimmed = trimView(line);
+        scan(trimmed);
+        sink.line(trimmed);
+    }
+
+private:
+    bool lineComments_;
+    bool blockComments_;
+    bool templates_;
+    bool rawStrings_;
+    bool inComment_ = false;
+    bool inTemplate_ = false;
+    std::string rawEnd_;             // Closing sequence of an open raw string
+    
+    // Follow the string/comment state through a line that is kept
+    void scan(std::string_view text) {
+        char quote = 0;
+        for (size_t i = 0; i < text.size(); i++) {
+            char c = text[i];
+            char next = i + 1 < text.size() ? text[i + 1] : '\0';
+            if (!rawEnd_.empty()) {
+                size_t end = text.find(rawEnd_, i);
+                if (end == std::string_view::npos) return;
+                i = end + rawEnd_.size() - 1;
+                rawEnd_.clear();
+            } else if (inComment_) {
+                if (c == '*' && next == '/') {
+                    inComment_ = false;
+                    i++;
+                }
+            } else if (inTemplate_ || quote) {
+                if (c == '\\') {
+                    i++;
+                } else if (c == (inTemplate_ ? '`' : quote)) {
+                    inTemplate_ = false;
+                    quote = 0;
+                }
+            } else if (c == '/' && next == '/' && lineComments_) {
+                return;
+            } else if (c == '/' && next == '*' && blockComments_) {
+                inComment_ = true;
+                i++;
+            } else if (rawStrings_ && c == 'R' && next == '"' &&
+                       (i == 0 || !std::isalnum(static_cast<unsigned char>(text[i - 1])))) {
+                size_t open = text.find('(', i + 2);
+                if (open == std::string_view::npos) return;
+                rawEnd_ = ")" + std::string(text.substr(i + 2, open - i - 2)) + "\"";
+                i = open;
+            } else if (c == '/' && templates_ && regexCanStart(text, i)) {
+                // A regex literal may hold quotes and backticks; one that
+                // does not close on this line was a division after all
+                size_t end = regexEnd(text, i + 1);
+                if (end != std::string_view::npos) i = end;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '`' && templates_) {
+                inTemplate_ = true;
+            }
+        }
+    }
+    
+    // A '/' starts a regex where an operand is expected: at the start of
+    // the line, after an operator or punctuation, or after a keyword
+    static bool regexCanStart(std::string_view text, size_t slash) {
+        if (slash == 0) return true;
+        size_t end = text.find_last_not_of(" \t", slash - 1);
+        if (end == std::string_view::npos) return true;
+        char previous = text[end];
+        if (std::string_view("(,=:[!&|?{};+-*%<>~^").find(previous) != std::string_view::npos) return true;
+        if (!std::isalpha(static_cast<unsigned char>(previous))) return false;
+        size_t start = end;
+        while (start > 0 && std::isalnum(static_cast<unsigned char>(text[start - 1]))) start--;
+        std::string_view word = text.substr(start, end - start + 1);
+        for (std::string_view keyword : {"return", "typeof", "case", "in", "of", "void", "yield",
+                                         "delete", "throw", "new", "else", "do", "await"}) {
+            if (word == keyword) return true;
+        }
+        return false;
+    }
+    
+    // Find the '/' closing a regex literal, skipping escapes and [...] classes
+    static size_t regexEnd(std::string_view text, size_t from) {
+        bool inClass = false;
+        for (size_t i = from; i < text.size(); i++) {
+            char c = text[i];
+            if (c == '\\') {
+                i++;
+            } else if (c == '[') {
+                inClass = true;
+            } else if (c == ']') {
+                inClass = false;
+            } else if (c == '/' && !inClass) {
+                return i;
+            }
+        }
+        return std::string_view::npos;
+    }
+};
+
+static std::string minifyCode(std::string_view text, std::string_view language) {
+    LineSink sink(language == "css" || language == "json" ? 0 : 1);
+    CodeLines code(language);
+    std::istringstream lines{std::string(text)};
+    std::string line;
+    while (std::getline(lines, line)) {
+        code.process(line, sink);
+    }
+    return sink.take();
+}
+
+// Python: indentation is syntax, so only trailing whitespace and runs of
+// blank lines go
+static std::string minifyPython(std::string_view text) {
+    LineSink sink(1);
+    std::string tripleQuote;         // Delimiter of an open triple-quoted string
+    std::istringstream lines{std::string(text)};
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::string_view kept = trimRight(line);
+        bool inString = !tripleQuote.empty();
+        
+        // An odd number of triple quotes opens or closes a string
+        for (const char* delimiter : {"\"\"\"", "'''"}) {
+            if (!tripleQuote.empty() && tripleQuote != delimiter) continue;
+            size_t count = 0;
+            for (size_t pos = kept.find(delimiter); pos != std::string_view::npos; pos = kept.find(delimiter, pos + 3)) {
+                count++;
+            }
+            if (count % 2 == 1) {
+                tripleQuote = tripleQuote.empty() ? delimiter : "";
+                break;
+            }
+        }
+        if (inString) {
+            sink.raw(kept);
+        } else {
+            sink.line(kept);
+        }
+    }
+    return sink.take();
+}
+
+// HTML: markup lines lose indentation; <script> and <style>
+// bodies are minified as JS and CSS, <pre> and <textarea> are kept verbatim
+static std::string minifyHtml(std::string_view text) {
+    LineSink sink(0);
+    std::string embedded;            // "js" or "css" while inside <script>/<style>
+    CodeLines script("js");
+    CodeLines style("css");
+    bool verbatim = false;
+    bool inComment = false;
+    std::istringstream lines{std::string(text)};
+    std::string line;
+    
+    while (std::getline(lines, line)) {
+        std::string lower = toLower(line);
+        std::string_view trimmed = trimView(line);
+        
+        if (verbatim) {
+            sink.raw(trimRight(line));
+            if (lower.find("</pre") != std::string::npos || lower.find("</textarea") != std::string::npos) {
+                verbatim = false;
+            }
+            continue;
+        }
+        if (!embedded.empty()) {
+            const char* closeTag = embedded == "js" ? "</script" : "</style";
+            if (lower.find(closeTag) != std::string::npos) {
+                sink.line(trimmed);
+                embedded.clear();
+            } else {
+                (embedded == "js" ? script : style).process(line, sink);
+            }
+            continue;
+        }
+        
+        if (trimmed.empty()) continue;
+        sink.line(trimmed);
+        
+        // Tags inside a comment open nothing
+        std::string_view markup = trimmed;
+        if (inComment) {
+            size_t end = markup.find("-->");
+            if (end == std::string_view::npos) continue;
+            inComment = false;
+            markup = trimView(markup.substr(end + 3));
+        }
+        if (startsWith(markup, "<!--") && !startsWith(markup, "<!--[")) {
+            size_t end = markup.find("-->", 4);
+            if (end == std::string_view::npos) {
+                inComment = true;
+                continue;
+            }
+            markup = trimView(markup.substr(end + 3));
+        }
+        
+        std::string lowerTrimmed = toLower(markup);
+        auto opens = [&](const char* open, const char* close) {
+            size_t pos = lowerTrimmed.rfind(open);
+            return pos != std::string::npos && lowerTrimmed.find(close, pos) == std::string::npos;
+        };
+        if (opens("<pre", "</pre") || opens("<textarea", "</textarea")) {
+            verbatim = true;
+        } else if (opens("<script", "</script")) {
+            embedded = "js";
+        } else if (opens("<style", "</style")) {
+            embedded = "css";
+        }
+    }
+    return sink.take();
+}
+
+const std::vector<std::string>& minifyLanguages() {
+    static const std::vector<std::string> languages = {"html", "css", "js", "json", "py", "cpp"};
+    return languages;
+}
+
+std::string minifyLanguageFor(std::string_view extension) {
+    if (extension == "html" || extension == "htm" || extension == "xml" || extension == "svg") return "html";
+    if (extension == "css" || extension == "scss") return "css";
+    if (extension == "js" || extension == "jsx" || extension == "ts" || extension == "tsx" ||
+        extension == "mjs") return "js";
+    if (extension == "json") return "json";
+    if (extension == "py") return "py";
+    if (extension == "c" || extension == "cpp" || extension == "cc" || extension == "h" ||
+        extension == "hpp" || extension == "java" || extension == "cs") return "cpp";
+    return "";
+}
+
+std::set<std::string> parseMinifyLanguages(const std::string& list, std::vector<std::string>* unknown) {
+    std::set<std::string> languages;
+    std::istringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        std::string name = toLower(trimView(item));
+        if (name.empty() || name == "off" || name == "none") continue;
+        if (name == "all" || name == "on") {
+            languages.insert(minifyLanguages().begin(), minifyLanguages().end());
+        } else if (std::find(minifyLanguages().begin(), minifyLanguages().end(), name) != minifyLanguages().end()) {
+            languages.insert(name);
+        } else if (unknown) {
+            unknown->push_back(name);
+        }
+    }
+    return languages;
+}
+
+std::string minifyForPrompt(std::string_view text, std::string_view language) {
+    if (language == "html") return minifyHtml(text);
+    if (language == "py") return minifyPython(text);
+    if (language == "css" || language == "js" || language == "json" || language == "cpp") {
+        return minifyCode(text, language);
+    }
+    return std::string(text);
+}
+
+} // namespace ollama_agent
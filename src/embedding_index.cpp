@@ -0,0 +1,442 @@
+#include "embedding_index.hpp"
+#include "content_hash.hpp"
+#include "response_cache.hpp"
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cctype>
+#include <cstdio>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OLLAMA_AGENT_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ollama_agent {
+
+static const char kStoreMagic[8] = {'O', 'A', 'E', 'M', 'B', 'E', 'D', '1'};
+static const size_t kHeaderSize = 16;          // Magic, dimension, reserved
+static const size_t kHashSize = 32;            // Hex content hash
+static const size_t kEmbedBatch = 32;          // Chunks per /api/embed request
+static const size_t kMinCompactRecords = 256;  // Stale vectors worth rewriting the store for
+static const size_t kMaxIndexedFileBytes = 1024 * 1024;  // Skip bundles and data dumps
+
+float dotProduct(const float* a, const float* b, size_t count) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(__AVX__)
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    sum = _mm_cvtss_f32(half);
+#elif defined(OLLAMA_AGENT_SSE)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    sum = _mm_cvtss_f32(acc);
+#elif defined(__ARM_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= count; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+    float lanes[4];
+    vst1q_f32(lanes, acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void normalize(std::vector<float>& vector) {
+    float norm = std::sqrt(dotProduct(vector.data(), vector.data(), vector.size()));
+    if (norm > 0.0f) {
+        for (float& value : vector) value /= norm;
+    }
+}
+
+static std::string readRange(const std::filesystem::path& path, size_t offset, size_t length) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return "";
+    file.seekg(static_cast<std::streamoff>(offset));
+    std::string text(length, '\0');
+    file.read(&text[0], static_cast<std::streamsize>(length));
+    text.resize(static_cast<size_t>(file.gcount()));
+    return text;
+}
+
+std::string defaultEmbeddingStorePath(const std::string& model, const std::string& workspaceRoot) {
+    std::error_code ec;
+    std::string root = std::filesystem::absolute(workspaceRoot, ec).lexically_normal().generic_string();
+    char rootHash[17];
+    std::snprintf(rootHash, sizeof(rootHash), "%016llx", static_cast<unsigned long long>(fnv1a64(root)));
+    std::string name = "embeddings-" + model + "-" + rootHash + ".bin";
+    for (char& c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-') c = '_';
+    }
+    return (std::filesystem::path(defaultCacheDirectory()) / name).string();
+}
+
+// Exclusive lock on a store's lock file, so one process at a time writes
+// it; held until destroyed
+class StoreLock {
+public:
+    explicit StoreLock(const std::filesystem::path& path) {
+#ifdef _WIN32
+        handle_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            OVERLAPPED overlapped = {};
+            locked_ = LockFileEx(handle_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped) != 0;
+        }
+#else
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        locked_ = fd_ >= 0 && flock(fd_, LOCK_EX) == 0;
+#endif
+    }
+    
+    ~StoreLock() {
+#ifdef _WIN32
+        if (handle_ != INVALID_HANDLE_VALUE) {
+            if (locked_) {
+                OVERLAPPED overlapped = {};
+                UnlockFileEx(handle_, 0, 1, 0, &overlapped);
+            }
+            CloseHandle(handle_);
+        }
+#else
+        if (fd_ >= 0) close(fd_);   // Releases the lock
+#endif
+    }
+    
+    StoreLock(const StoreLock&) = delete;
+    StoreLock& operator=(const StoreLock&) = delete;
+    
+    // Check if the lock was taken
+    bool locked() const {
+        return locked_;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+    bool locked_ = false;
+};
+
+// Vector file, mapped read-only for lookups.
+// Layout: "OAEMBED1", uint32 dimension, uint32 reserved, then records of
+// a 32-character content hash followed by dimension floats.
+class VectorStore {
+public:
+    explicit VectorStore(std::filesystem::path path) : path_(std::move(path)) {
+        map();
+    }
+    
+    ~VectorStore() {
+        unmap();
+    }
+    
+    // Get the vector stored under a hash (nullptr if none)
+    const float* find(const std::string& hash) const {
+        auto it = records_.find(hash);
+        if (it == records_.end()) return nullptr;
+        return reinterpret_cast<const float*>(data_ + it->second + kHashSize);
+    }
+    
+    // Get the vector length (0 while the store is empty)
+    size_t dimension() const {
+        return dimension_;
+    }
+    
+    // Add normalized vectors and remap once. New records are appended,
+    // unless the vectors of hashes not in live outnumber the others: then
+    // the file is rewritten without them. A new dimension starts it over.
+    bool write(const std::vector<std::string>& hashes, const std::vector<std::vector<float>>& vectors,
+               const std::unordered_set<std::string>& live) {
+        // Other processes indexing the same workspace share the file: write
+        // under its lock, starting from what they have written meanwhile
+        std::error_code ec;
+        std::filesystem::create_directories(path_.parent_path(), ec);
+        StoreLock lock(path_.string() + ".lock");
+        if (!lock.locked()) return false;
+        unmap();
+        map();
+        
+        size_t dimension = vectors.empty() ? dimension_ : vectors.front().size();
+        if (dimension == 0) return vectors.empty();
+        
+        bool restart = dimension_ != dimension;
+        size_t stale = 0;
+        if (!restart) {
+            for (const auto& record : records_) {
+                if (!live.count(record.first)) stale++;
+            }
+        }
+        bool compact = restart || (stale >= kMinCompactRecords && stale > records_.size() - stale);
+        if (!compact && vectors.empty()) return true;
+        
+        std::filesystem::path target = compact ? std::filesystem::path(path_.string() + ".tmp") : path_;
+        {
+            std::ofstream file(target, std::ios::binary | (compact ? std::ios::trunc : std::ios::app));
+            if (!file) return false;
+            if (compact) {
+                uint32_t header[2] = {static_cast<uint32_t>(dimension), 0};
+                file.write(kStoreMagic, sizeof(kStoreMagic));
+                file.write(reinterpret_cast<const char*>(header), sizeof(header));
+                size_t recordSize = kHashSize + dimension * sizeof(float);
+                for (const auto& [hash, offset] : records_) {
+                    if (!restart && live.count(hash)) {
+                        file.write(data_ + offset, static_cast<std::streamsize>(recordSize));
+                    }
+                }
+            }
+            for (size_t i = 0; i < vectors.size(); i++) {
+                if (vectors[i].size() != dimension || hashes[i].size() != kHashSize) continue;
+                if (!restart && records_.count(hashes[i])) continue;   // Written by another process
+                file.write(hashes[i].data(), kHashSize);
+                file.write(reinterpret_cast<const char*>(vectors[i].data()),
+                           static_cast<std::streamsize>(dimension * sizeof(float)));
+            }
+        }
+        unmap();
+        if (compact) {
+            std::filesystem::rename(target, path_, ec);
+            if (ec) {
+                std::filesystem::remove(target, ec);
+                map();
+                return false;
+            }
+        }
+        map();
+        return dimension_ == dimension;
+    }
+
+private:
+    std::filesystem::path path_;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t dimension_ = 0;
+    std::unordered_map<std::string, size_t> records_;   // Hash -> record offset
+#ifdef _WIN32
+    std::vector<char> buffer_;
+#endif
+
+    void map() {
+        records_.clear();
+        dimension_ = 0;
+#ifdef _WIN32
+        std::ifstream file(path_, std::ios::binary);
+        if (!file) return;
+        buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+#else
+        int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size >= static_cast<off_t>(kHeaderSize)) {
+            void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data_ = static_cast<const char*>(mapped);
+                size_ = static_cast<size_t>(info.st_size);
+            }
+        }
+        close(fd);
+#endif
+        if (!data_ || size_ < kHeaderSize || std::memcmp(data_, kStoreMagic, sizeof(kStoreMagic)) != 0) {
+            return;
+        }
+        
+        uint32_t dimension = 0;
+        std::memcpy(&dimension, data_ + sizeof(kStoreMagic), sizeof(dimension));
+        dimension_ = dimension;
+        size_t recordSize = kHashSize + dimension_ * sizeof(float);
+        for (size_t offset = kHeaderSize; dimension_ > 0 && offset + recordSize <= size_; offset += recordSize) {
+            records_[std::string(data_ + offset, kHashSize)] = offset;
+        }
+    }
+    
+    void unmap() {
+#ifndef _WIN32
+        if (data_) munmap(const_cast<char*>(data_), size_);
+#else
+        buffer_.clear();
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+};
+
+EmbeddingIndex::EmbeddingIndex(const std::string& model, const std::string& workspaceRoot)
+    : model_(model) {
+    setWorkspace(workspaceRoot);
+}
+
+void EmbeddingIndex::setWorkspace(const std::string& workspaceRoot) {
+    std::string storePath = defaultEmbeddingStorePath(model_, workspaceRoot);
+    if (store_ && storePath == storePath_) return;
+    storePath_ = storePath;
+    store_ = std::make_unique<VectorStore>(storePath);
+    files_.clear();
+}
+
+EmbeddingIndex::~EmbeddingIndex() = default;
+
+std::string EmbeddingIndex::getModel() const {
+    return model_;
+}
+
+std::string EmbeddingIndex::getLastError() const {
+    return lastError_;
+}
+
+bool EmbeddingIndex::embedAndStore(OllamaClient& client, const std::vector<std::string>& hashes,
+                                   const std::vector<std::string>& texts) {
+    std::vector<std::string> embeddedHashes;
+    std::vector<std::vector<float>> vectors;
+    bool embedded = true;
+    for (size_t first = 0; first < texts.size(); first += kEmbedBatch) {
+        size_t last = std::min(first + kEmbedBatch, texts.size());
+        std::vector<std::string> batch(texts.begin() + first, texts.begin() + last);
+        
+        std::vector<std::vector<float>> batchVectors = client.embed(model_, batch);
+        if (batchVectors.empty()) {
+            lastError_ = "Embedding failed: " + client.getLastError();
+            embedded = false;
+            break;
+        }
+        for (size_t i = 0; i < batchVectors.size() && first + i < last; i++) {
+            normalize(batchVectors[i]);
+            embeddedHashes.push_back(hashes[first + i]);
+            vectors.push_back(std::move(batchVectors[i]));
+        }
+    }
+    
+    // Vectors of chunks no indexed file has any more are stale; the store
+    // is written and remapped once per pass, keeping what was embedded
+    // before a failure
+    std::unordered_set<std::string> live;
+    for (const auto& [path, fileChunks] : files_) {
+        for (const auto& chunk : fileChunks.chunks) {
+            live.insert(chunk.hash);
+        }
+    }
+    if (!store_->write(embeddedHashes, vectors, live)) {
+        lastError_ = "Cannot write embedding store";
+        return false;
+    }
+    return embedded;
+}
+
+bool EmbeddingIndex::update(OllamaClient& client, const std::vector<WorkspaceEntry>& files) {
+    std::map<std::string, FileChunks> current;
+    std::vector<std::string> missingHashes;
+    std::vector<std::string> missingTexts;
+    std::unordered_map<std::string, bool> queued;
+    
+    for (const auto& entry : files) {
+        if (entry.size > kMaxIndexedFileBytes) continue;
+        
+        auto previous = files_.find(entry.relativePath);
+        bool unchanged = previous != files_.end() && previous->second.size == entry.size &&
+                         previous->second.mtime == entry.mtime;
+        FileChunks& fileChunks = current[entry.relativePath];
+        std::string content;
+        
+        if (unchanged) {
+            fileChunks = std::move(previous->second);
+        } else {
+            content = readRange(entry.fullPath, 0, entry.size);
+            fileChunks.size = entry.size;
+            fileChunks.mtime = entry.mtime;
+            for (const auto& section : splitIntoSections(content, pathExtension(entry.relativePath))) {
+                std::string_view text(content.data() + section.offset, section.length);
+                fileChunks.chunks.push_back({entry.relativePath, section.id, section.offset, section.length,
+                                             contentHash(text)});
+            }
+        }
+        
+        for (const auto& chunk : fileChunks.chunks) {
+            if (store_->find(chunk.hash) || queued.count(chunk.hash)) continue;
+            queued[chunk.hash] = true;
+            missingHashes.push_back(chunk.hash);
+            missingTexts.push_back(unchanged ? readRange(entry.fullPath, chunk.offset, chunk.length)
+                                             : content.substr(chunk.offset, chunk.length));
+        }
+    }
+    
+    files_ = std::move(current);
+    return embedAndStore(client, missingHashes, missingTexts);
+}
+
+std::vector<ChunkMatch> EmbeddingIndex::query(OllamaClient& client, const std::string& text, size_t k) {
+    std::vector<std::vector<float>> vectors = client.embed(model_, {text});
+    if (vectors.empty()) {
+        lastError_ = "Embedding failed: " + client.getLastError();
+        return {};
+    }
+    std::vector<float>& queryVector = vectors.front();
+    if (queryVector.size() != store_->dimension()) {
+        lastError_ = "Embedding size changed; index is rebuilt on the next update";
+        return {};
+    }
+    normalize(queryVector);
+    
+    std::vector<ChunkMatch> matches;
+    for (const auto& [path, fileChunks] : files_) {
+        for (const auto& chunk : fileChunks.chunks) {
+            const float* vector = store_->find(chunk.hash);
+            if (!vector) continue;
+            matches.push_back({chunk, dotProduct(queryVector.data(), vector, queryVector.size())});
+        }
+    }
+    
+    size_t count = std::min(k, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + count, matches.end(),
+                      [](const ChunkMatch& a, const ChunkMatch& b) { return a.score > b.score; });
+    matches.resize(count);
+    return matches;
+}
+
+} // namespace ollama_agent
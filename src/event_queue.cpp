@@ -0,0 +1,87 @@
+#include "event_queue.hpp"
+
+namespace ollama_agent {
+
+static size_t roundUpToPowerOfTwo(size_t value) {
+    size_t result = 2;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+AgentEventQueue::AgentEventQueue(size_t capacity) {
+    size_t size = roundUpToPowerOfTwo(capacity);
+    slots_ = std::make_unique<Slot[]>(size);
+    mask_ = size - 1;
+    for (size_t i = 0; i < size; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool AgentEventQueue::tryPush(AgentEvent&& event) {
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots_[pos & mask_];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        
+        if (diff == 0) {
+            // Slot is free for this position; claim it
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.event = std::move(event);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // Slot still holds an event from the previous lap: full
+            return false;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool AgentEventQueue::tryPop(AgentEvent& event) {
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots_[pos & mask_];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+        
+        if (diff == 0) {
+            // Slot is filled for this position; claim it
+            if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                event = std::move(slot.event);
+                slot.event.text.clear();
+                slot.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // Nothing published at this position yet: empty
+            return false;
+        } else {
+            pos = dequeuePos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t AgentEventQueue::drain(std::vector<AgentEvent>& out, size_t maxEvents) {
+    size_t count = 0;
+    AgentEvent event;
+    while (count < maxEvents && tryPop(event)) {
+        out.push_back(std::move(event));
+        count++;
+    }
+    return count;
+}
+
+bool AgentEventQueue::empty() const {
+    return dequeuePos_.load(std::memory_order_acquire) >= enqueuePos_.load(std::memory_order_acquire);
+}
+
+size_t AgentEventQueue::capacity() const {
+    return mask_ + 1;
+}
+
+} // namespace ollama_agent
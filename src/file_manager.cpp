@@ -44,7 +44,7 @@ bool FileManager::ensureParentDirs(const std::filesystem::path& path) {
     }
 }
 
-bool FileManager::createFile(const std::string& relativePath, const std::string& content) {
+bool FileManager::createFile(const std::string& relativePath, std::string_view content) {
     try {
         std::filesystem::path fullPath = resolvePath(relativePath);
         
@@ -0,0 +1,501 @@
+#include "file_writer.hpp"
+#include <fstream>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <set>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef IORING_FILE_INDEX_ALLOC  // Headers new enough for direct descriptors
+#define OLLAMA_AGENT_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace ollama_agent {
+
+// Target of one write, resolved before any I/O is issued
+struct PreparedWrite {
+    std::filesystem::path target;
+    std::filesystem::path temporary;
+    std::string_view content;
+    unsigned mode = 0644;
+    bool inPlace = false;             // Symlinks are written through, not replaced
+    std::string error;
+};
+
+static std::filesystem::path resolveTarget(const std::filesystem::path& workDir, std::string_view filename) {
+    std::filesystem::path path{std::string(filename)};
+    return path.is_absolute() ? path : workDir / path;
+}
+
+static PreparedWrite prepareWrite(const std::filesystem::path& workDir, const ParsedFile& file) {
+    static std::atomic<unsigned> counter{0};
+    
+    PreparedWrite write;
+    write.target = resolveTarget(workDir, file.filename);
+    write.content = file.content;
+    // Hidden, so directory scans and the workspace watcher skip it
+    write.temporary = write.target.parent_path() /
+        ("." + write.target.filename().string() + ".tmp" + std::to_string(counter++));
+    
+    std::error_code ec;
+    std::filesystem::path parent = write.target.parent_path();
+    if (!parent.empty() && !std::filesystem::exists(parent, ec)) {
+        std::filesystem::create_directories(parent, ec);
+        if (ec) {
+            write.error = "Failed to create parent directories: " + ec.message();
+            return write;
+        }
+    }
+
+#ifndef _WIN32
+    struct stat info;
+    if (lstat(write.target.c_str(), &info) == 0) {
+        write.inPlace = S_ISLNK(info.st_mode);
+        write.mode = info.st_mode & 07777;  // Keep permissions of the file being replaced
+    }
+#endif
+    return write;
+}
+
+static bool writeBlocking(const PreparedWrite& write, std::string& error) {
+    const std::filesystem::path& path = write.inPlace ? write.target : write.temporary;
+
+#ifdef _WIN32
+    {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            error = "Failed to open file for writing: " + path.string();
+            return false;
+        }
+        file << write.content;
+        file.close();
+        if (!file) {
+            error = "Failed to write " + path.string();
+            return false;
+        }
+    }
+#else
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, write.mode);
+    if (fd < 0) {
+        error = "Failed to open file for writing: " + path.string() + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+    size_t written = 0;
+    while (written < write.content.size()) {
+        ssize_t count = ::write(fd, write.content.data() + written, write.content.size() - written);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            error = "Failed to write " + path.string() + " (" + std::strerror(errno) + ")";
+            close(fd);
+            return false;
+        }
+        written += static_cast<size_t>(count);
+    }
+    if (fsync(fd) != 0 || close(fd) != 0) {
+        error = "Failed to flush " + path.string() + " (" + std::strerror(errno) + ")";
+        return false;
+    }
+#endif
+
+    if (!write.inPlace) {
+        std::error_code ec;
+        std::filesystem::rename(write.temporary, write.target, ec);
+        if (ec) {
+            error = "Failed to replace " + write.target.string() + ": " + ec.message();
+            std::filesystem::remove(write.temporary, ec);
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef OLLAMA_AGENT_HAVE_IO_URING
+
+// Minimal io_uring driver (raw system calls, no liburing dependency).
+// Each file is one linked chain; the descriptor opened by the chain lives
+// in a registered slot so later links can use it before it is known.
+class UringQueue {
+public:
+    static constexpr unsigned kSlots = 32;          // Files in flight per submission
+    static constexpr unsigned kSteps = 5;           // open, write, fsync, close, rename
+    static constexpr size_t kMaxWrite = 1u << 30;   // Larger files take the blocking path
+    
+    ~UringQueue() {
+        if (sqes_ != MAP_FAILED) munmap(sqes_, sqesSize_);
+        if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        if (sqRing_ != MAP_FAILED) munmap(sqRing_, sqRingSize_);
+        if (ringFd_ >= 0) close(ringFd_);
+    }
+    
+    // Set up the ring; returns false if the kernel lacks anything the chains need
+    bool init() {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd_ = static_cast<int>(syscall(__NR_io_uring_setup, kSlots * kSteps, &params));
+        if (ringFd_ < 0) return false;
+        
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ringFd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) return false;
+        cqRing_ = singleMap ? sqRing_ : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                                             MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) return false;
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     ringFd_, IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED) return false;
+        
+        char* sq = static_cast<char*>(sqRing_);
+        char* cq = static_cast<char*>(cqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        
+        std::vector<int> emptySlots(kSlots, -1);
+        if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_FILES, emptySlots.data(), kSlots) < 0) {
+            return false;
+        }
+        
+        std::vector<char> probeBuffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(probeBuffer.data());
+        if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PROBE, probe, 256) < 0) {
+            return false;
+        }
+        for (int op : {IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_CLOSE, IORING_OP_RENAMEAT}) {
+            if (!(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        
+        // Direct descriptors (5.15+) aren't covered by the probe; write one file
+        std::error_code ec;
+        PreparedWrite test;
+        test.target = std::filesystem::temp_directory_path(ec) /
+            (".ollama_agent_uring" + std::to_string(getpid()));
+        test.temporary = test.target.string() + ".tmp";
+        test.content = "ok";
+        std::vector<PreparedWrite> writes{test};
+        std::string error = "not run";
+        run(writes, [&](size_t, const std::string& result) { error = result; });
+        std::filesystem::remove(test.target, ec);
+        return error.empty();
+    }
+    
+    // Write up to kSlots prepared files; done is called as each one finishes.
+    // Returns false if the ring itself failed: done was not called for the
+    // files still in flight, and the ring must not be used again.
+    bool run(std::vector<PreparedWrite>& writes, const std::function<void(size_t, const std::string&)>& done) {
+        struct State {
+            int results[kSteps] = {0, 0, 0, 0, 0};
+            unsigned completed = 0;
+            unsigned expected = 0;
+        };
+        std::vector<State> states(writes.size());
+        
+        unsigned queued = 0;
+        for (size_t i = 0; i < writes.size(); i++) {
+            const PreparedWrite& write = writes[i];
+            const std::filesystem::path& openPath = write.inPlace ? write.target : write.temporary;
+            unsigned slot = static_cast<unsigned>(i);
+            unsigned steps = write.inPlace ? kSteps - 1 : kSteps;
+            states[i].expected = steps;
+            
+            queued += steps;
+            io_uring_sqe* sqe = nextSqe();
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = reinterpret_cast<uint64_t>(openPath.c_str());
+            sqe->len = write.mode;
+            sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;  // O_CLOEXEC is invalid for direct descriptors
+            sqe->file_index = slot + 1;
+            sqe->flags = IOSQE_IO_LINK;
+            sqe->user_data = i * kSteps + 0;
+            
+            sqe = nextSqe();
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = static_cast<int>(slot);
+            sqe->addr = reinterpret_cast<uint64_t>(write.content.data());
+            sqe->len = static_cast<unsigned>(write.content.size());
+            sqe->off = 0;
+            sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;  // A short write breaks the chain
+            sqe->user_data = i * kSteps + 1;
+            
+            sqe = nextSqe();
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = static_cast<int>(slot);
+            sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+            sqe->user_data = i * kSteps + 2;
+            
+            sqe = nextSqe();
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->file_index = slot + 1;
+            sqe->flags = write.inPlace ? 0 : IOSQE_IO_LINK;
+            sqe->user_data = i * kSteps + 3;
+            
+            if (!write.inPlace) {
+                sqe = nextSqe();
+                sqe->opcode = IORING_OP_RENAMEAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<uint64_t>(write.temporary.c_str());
+                sqe->len = static_cast<unsigned>(AT_FDCWD);
+                sqe->addr2 = reinterpret_cast<uint64_t>(write.target.c_str());
+                sqe->user_data = i * kSteps + 4;
+            }
+        }
+        __atomic_store_n(sqTail_, sqTailLocal_, __ATOMIC_RELEASE);
+        
+        unsigned toSubmit = queued;
+        unsigned outstanding = queued;
+        while (outstanding > 0) {
+            long entered = syscall(__NR_io_uring_enter, ringFd_, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (entered < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            toSubmit -= std::min(toSubmit, static_cast<unsigned>(entered));
+            
+            unsigned head = *cqHead_;
+            unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                const io_uring_cqe& cqe = cqes_[head & cqMask_];
+                size_t index = static_cast<size_t>(cqe.user_data / kSteps);
+                State& state = states[index];
+                state.results[cqe.user_data % kSteps] = cqe.res;
+                outstanding--;
+                if (++state.completed == state.expected) {
+                    done(index, finishWrite(writes[index], state.results, static_cast<unsigned>(index)));
+                }
+            }
+            __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+        }
+        
+        return outstanding == 0;
+    }
+
+private:
+    int ringFd_ = -1;
+    void* sqRing_ = MAP_FAILED;
+    void* cqRing_ = MAP_FAILED;
+    void* sqes_ = MAP_FAILED;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+    size_t sqesSize_ = 0;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqTailLocal_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    
+    io_uring_sqe* nextSqe() {
+        unsigned index = sqTailLocal_ & sqMask_;
+        io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes_) + index;
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[index] = index;
+        sqTailLocal_++;
+        return sqe;
+    }
+    
+    // Turn a chain's completion codes into an error message ("" on success)
+    std::string finishWrite(const PreparedWrite& write, const int* results, unsigned slot) {
+        static const char* const kStepNames[kSteps] = {"open", "write", "fsync", "close", "rename"};
+        std::string error;
+        for (unsigned step = 0; step < kSteps && error.empty(); step++) {
+            if (results[step] == -ECANCELED) continue;  // Follows the failing link
+            if (results[step] < 0) {
+                error = std::string(kStepNames[step]) + " failed: " + std::strerror(-results[step]);
+            } else if (step == 1 && static_cast<size_t>(results[step]) != write.content.size()) {
+                error = "short write (" + std::to_string(results[step]) + " of " +
+                        std::to_string(write.content.size()) + " bytes)";
+            }
+        }
+        if (error.empty() && results[0] == -ECANCELED) {
+            error = "cancelled";
+        }
+        if (!error.empty()) {
+            // The close link may not have run; release the slot and the temporary
+            int none = -1;
+            io_uring_files_update update;
+            std::memset(&update, 0, sizeof(update));
+            update.offset = slot;
+            update.fds = reinterpret_cast<uint64_t>(&none);
+            syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_FILES_UPDATE, &update, 1);
+            if (!write.inPlace) {
+                std::error_code ec;
+                std::filesystem::remove(write.temporary, ec);
+            }
+        }
+        return error;
+    }
+};
+
+#else
+
+// Placeholder so the writer compiles where io_uring isn't available
+class UringQueue {
+public:
+    static constexpr unsigned kSlots = 1;
+    static constexpr size_t kMaxWrite = 0;
+    bool init() { return false; }
+    bool run(std::vector<PreparedWrite>&, const std::function<void(size_t, const std::string&)>&) { return false; }
+};
+
+#endif
+
+FileWriter::FileWriter(size_t threads) {
+    auto uring = std::make_unique<UringQueue>();
+    if (uring->init()) {
+        // One thread feeds the ring; the kernel does the writes in parallel
+        uring_ = std::move(uring);
+        threads = 1;
+    }
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; i++) {
+        workers_.emplace_back(&FileWriter::workerLoop, this);
+    }
+}
+
+FileWriter::~FileWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    jobReady_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+std::string FileWriter::getBackendName() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return uring_ ? "io_uring" : "threads";
+}
+
+uint64_t FileWriter::submit(const std::filesystem::path& workDir, const std::vector<ParsedFile>& files) {
+    auto batch = std::make_shared<Batch>();
+    batch->workDir = workDir;
+    
+    // Files of a batch are written concurrently, so a name given twice
+    // would end up with whichever write lands last: keep the last block
+    std::set<std::string_view> seen;
+    for (auto file = files.rbegin(); file != files.rend(); ++file) {
+        if (seen.insert(file->filename).second) {
+            batch->files.push_back(*file);
+        }
+    }
+    std::reverse(batch->files.begin(), batch->files.end());
+    batch->pending = batch->files.size();
+    const std::vector<ParsedFile>& unique = batch->files;
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t id = nextBatchId_++;
+    batches_[id] = batch;
+    
+    size_t jobSize = uring_ ? UringQueue::kSlots : 1;
+    for (size_t first = 0; first < unique.size(); first += jobSize) {
+        jobs_.push_back({batch, first, std::min(jobSize, unique.size() - first)});
+    }
+    jobReady_.notify_all();
+    return id;
+}
+
+bool FileWriter::nextResult(uint64_t batchId, WriteResult& result) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = batches_.find(batchId);
+    if (it == batches_.end()) return false;
+    std::shared_ptr<Batch> batch = it->second;
+    
+    resultReady_.wait(lock, [&] { return !batch->finished.empty() || batch->pending == 0; });
+    if (batch->finished.empty()) {
+        batches_.erase(batchId);
+        return false;
+    }
+    result = std::move(batch->finished.front());
+    batch->finished.pop_front();
+    return true;
+}
+
+void FileWriter::finish(Batch& batch, WriteResult&& result) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        batch.finished.push_back(std::move(result));
+        batch.pending--;
+    }
+    resultReady_.notify_all();
+}
+
+void FileWriter::workerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobReady_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (stopping_ && jobs_.empty()) return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        Batch& batch = *job.batch;
+        
+        // Resolve targets and create directories; files that fail here
+        // never reach the ring
+        std::vector<PreparedWrite> writes;
+        std::vector<size_t> fileIndex;
+        for (size_t i = job.first; i < job.first + job.count; i++) {
+            const ParsedFile& file = batch.files[i];
+            PreparedWrite write = prepareWrite(batch.workDir, file);
+            if (!write.error.empty()) {
+                finish(batch, {std::string(file.filename), 0, false, write.error});
+            } else {
+                writes.push_back(std::move(write));
+                fileIndex.push_back(i);
+            }
+        }
+        
+        std::vector<char> reported(writes.size(), 0);
+        auto report = [&](size_t index, const std::string& error) {
+            const ParsedFile& file = batch.files[fileIndex[index]];
+            reported[index] = 1;
+            finish(batch, {std::string(file.filename), file.content.size(), error.empty(), error});
+        };
+        
+        bool oversized = std::any_of(writes.begin(), writes.end(), [](const PreparedWrite& write) {
+            return write.content.size() >= UringQueue::kMaxWrite;
+        });
+        if (uring_ && !oversized && !uring_->run(writes, report)) {
+            // Completions left in a failed ring would be read by the next
+            // run; drop it and write the rest, and every later batch, here
+            std::lock_guard<std::mutex> lock(mutex_);
+            uring_.reset();
+        }
+        for (size_t i = 0; i < writes.size(); i++) {
+            if (reported[i]) continue;
+            std::string error;
+            writeBlocking(writes[i], error);
+            report(i, error);
+        }
+    }
+}
+
+} // namespace ollama_agent
@@ -19,6 +19,7 @@
 #include "agent.hpp"
 #include "ollama_client.hpp"
 #include "file_manager.hpp"
+#include "config_file.hpp"
 
 #pragma comment(lib, "comctl32.lib")
 #pragma comment(lib, "dwmapi.lib")
@@ -133,6 +134,7 @@ Theme* g_theme = &g_themes[0];
 #define ID_VERBOSE_CHECK    111
 #define ID_TITLE_LABEL      112
 #define ID_THEME_COMBO      113
+#define ID_EVENT_TIMER      120
 
 // Global variables
 HWND g_hWnd = NULL;
@@ -160,6 +162,7 @@ HFONT g_hTitleFont = NULL;
 std::unique_ptr<ollama_agent::OllamaClient> g_client;
 std::unique_ptr<ollama_agent::FileManager> g_fileManager;
 std::unique_ptr<ollama_agent::Agent> g_agent;
+std::shared_ptr<ollama_agent::AgentEventQueue> g_events;
 
 std::mutex g_outputMutex;
 bool g_isProcessing = false;
@@ -175,6 +178,8 @@ void RefreshFileList();
 void BrowseForFolder();
 void SendRequest();
 void AppendOutput(const std::wstring& text);
+void DrainAgentEvents();
+std::wstring NormalizeNewlines(const std::wstring& text);
 void ClearOutput();
 std::wstring StringToWString(const std::string& str);
 std::string WStringToString(const std::wstring& wstr);
@@ -472,6 +477,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         case WM_CREATE:
             InitializeControls(hWnd);
             InitializeOllama();
+            SetTimer(hWnd, ID_EVENT_TIMER, 30, NULL);
             break;
 
         case WM_CTLCOLOREDIT:
@@ -583,7 +589,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
                         if (idx != CB_ERR) {
                             wchar_t buffer[256];
                             SendMessage(g_hModelCombo, CB_GETLBTEXT, idx, (LPARAM)buffer);
-                            if (g_client) g_client->setModel(WStringToString(buffer));
+                            if (g_client) {
+                                g_client->setModel(WStringToString(buffer));
+                                g_client->preloadModelAsync(WStringToString(buffer));
+                            }
                         }
                     }
                     break;
@@ -605,7 +614,14 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             return 1;
         }
 
+        case WM_TIMER:
+            if (wParam == ID_EVENT_TIMER) {
+                DrainAgentEvents();
+            }
+            break;
+
         case WM_DESTROY:
+            KillTimer(hWnd, ID_EVENT_TIMER);
             PostQuitMessage(0);
             break;
 
@@ -620,7 +636,8 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         }
 
         case WM_USER + 2: {
-            // Handle request completion
+            // Handle request completion (after any output still queued)
+            DrainAgentEvents();
             bool success = (wParam != 0);
             std::vector<std::string>* files = (std::vector<std::string>*)lParam;
             
@@ -736,6 +753,21 @@ void InitializeOllama() {
     config.port = 11434;
     config.timeoutSeconds = 300;
 
+    // Same config file as the CLI: connection settings and model profiles
+    ollama_agent::ConfigFile configFile;
+    std::string configPath = ollama_agent::defaultConfigPath();
+    if (GetFileAttributesA(configPath.c_str()) != INVALID_FILE_ATTRIBUTES) {
+        if (configFile.load(configPath)) {
+            config.host = configFile.getString("host").value_or(config.host);
+            config.port = static_cast<int>(configFile.getInt("port").value_or(config.port));
+            config.timeoutSeconds = static_cast<int>(configFile.getInt("timeout").value_or(config.timeoutSeconds));
+            config.keepAlive = configFile.getString("keep_alive").value_or(config.keepAlive);
+            config.profiles = configFile.getProfiles();
+        } else {
+            AppendOutput(L"[WARN] " + StringToWString(configFile.getLastError()) + L"\r\n");
+        }
+    }
+
     g_client = std::make_unique<ollama_agent::OllamaClient>(config);
     
     wchar_t currentDir[MAX_PATH];
@@ -746,19 +778,15 @@ void InitializeOllama() {
     
     // Set output callback for verbose mode and status messages
     g_agent->setOutputCallback([](const std::string& message) {
+        // Only used when the event queue is full
         std::lock_guard<std::mutex> lock(g_outputMutex);
-        std::wstring wmsg = StringToWString(message);
-        // Normalize line endings for Windows
-        std::wstring normalized;
-        for (size_t i = 0; i < wmsg.size(); i++) {
-            if (wmsg[i] == L'\n' && (i == 0 || wmsg[i-1] != L'\r')) {
-                normalized += L"\r\n";
-            } else {
-                normalized += wmsg[i];
-            }
-        }
+        std::wstring normalized = NormalizeNewlines(StringToWString(message)) + L"\r\n";
         PostMessage(g_hWnd, WM_USER + 1, 0, (LPARAM)new std::wstring(normalized));
     });
+    
+    // Agent output is queued and drained in batches on a UI timer
+    g_events = std::make_shared<ollama_agent::AgentEventQueue>();
+    g_agent->setEventQueue(g_events);
 
     if (!g_client->isAvailable()) {
         AppendOutput(L"\r\n[ERROR] Cannot connect to Ollama at 127.0.0.1:11434\r\n\r\n");
@@ -793,6 +821,7 @@ void RefreshModels() {
     }
     SendMessage(g_hModelCombo, CB_SETCURSEL, 0, 0);
     g_client->setModel(models[0]);
+    g_client->preloadModelAsync(models[0]);
     AppendOutput(L"[OK] Using model: " + StringToWString(models[0]) + L"\r\n");
 }
 
@@ -863,6 +892,57 @@ void AppendOutput(const std::wstring& text) {
     SendMessage(g_hOutputEdit, EM_SCROLLCARET, 0, 0);
 }
 
+void DrainAgentEvents() {
+    if (!g_events) return;
+    
+    // Join the whole batch into one edit-control update
+    std::wstring text;
+    bool filesChanged = false;
+    std::vector<ollama_agent::AgentEvent> batch;
+    while (g_events->drain(batch) > 0) {
+        for (const auto& event : batch) {
+            switch (event.type) {
+                case ollama_agent::AgentEventType::Status:
+                    text += NormalizeNewlines(StringToWString(event.text)) + L"\r\n";
+                    break;
+                case ollama_agent::AgentEventType::FileWritten:
+                    filesChanged = true;
+                    break;
+                case ollama_agent::AgentEventType::Stats: {
+                    long long tokensPerSec = event.stats.evalMs > 0 ? event.stats.evalCount * 1000 / event.stats.evalMs : 0;
+                    std::wstring title = L"OllamaAgent - " + StringToWString(event.text) + L" (" +
+                                         std::to_wstring(tokensPerSec) + L" tok/s)";
+                    SetWindowText(g_hWnd, title.c_str());
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        batch.clear();
+    }
+    
+    if (!text.empty()) {
+        AppendOutput(text);
+    }
+    if (filesChanged) {
+        RefreshFileList();
+    }
+}
+
+std::wstring NormalizeNewlines(const std::wstring& text) {
+    // Normalize line endings for Windows
+    std::wstring normalized;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == L'\n' && (i == 0 || text[i-1] != L'\r')) {
+            normalized += L"\r\n";
+        } else {
+            normalized += text[i];
+        }
+    }
+    return normalized;
+}
+
 void ClearOutput() { SetWindowText(g_hOutputEdit, L""); }
 
 std::wstring StringToWString(const std::string& str) {
@@ -0,0 +1,284 @@
+#include "ignore_rules.hpp"
+#include <fstream>
+
+namespace ollama_agent {
+
+// Dependency and build output directories nobody wants sent to the model;
+// a project can re-include one with a negated rule such as "!dist/"
+static const char* const kDefaultPatterns[] = {
+    "node_modules/", "bower_components/", "__pycache__/", "venv/",
+    "dist/", "build/", "target/", "CMakeFiles/"
+};
+
+static std::string baseName(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+void IgnoreRules::addDefaults() {
+    for (const char* pattern : kDefaultPatterns) {
+        addPattern(pattern);
+    }
+}
+
+void IgnoreRules::addPattern(const std::string& pattern, const std::string& baseDir) {
+    std::string text = pattern;
+    while (!text.empty() && (text.back() == '\r' || text.back() == '\n')) {
+        text.pop_back();
+    }
+    // Trailing spaces are ignored unless escaped
+    while (!text.empty() && text.back() == ' ' &&
+           !(text.size() >= 2 && text[text.size() - 2] == '\\')) {
+        text.pop_back();
+    }
+    if (text.empty() || text[0] == '#') return;
+    
+    bool negated = false;
+    if (text[0] == '!') {
+        negated = true;
+        text.erase(0, 1);
+    }
+    
+    bool directoryOnly = false;
+    if (!text.empty() && text.back() == '/') {
+        directoryOnly = true;
+        text.pop_back();
+    }
+    
+    bool anchored = false;
+    if (!text.empty() && text[0] == '/') {
+        anchored = true;
+        text.erase(0, 1);
+    }
+    if (text.find('/') != std::string::npos) {
+        anchored = true;
+    }
+    if (text.empty()) return;
+    
+    size_t index = ruleCount_++;
+    bool literal = text.find_first_of("*?[\\") == std::string::npos;
+    
+    if (literal && baseDir.empty()) {
+        LiteralRule& rule = anchored ? literalPaths_[text] : literalNames_[text];
+        if (directoryOnly) {
+            rule.directory = static_cast<long>(index);
+            rule.directoryNegated = negated;
+        } else {
+            rule.anyEntry = static_cast<long>(index);
+            rule.anyNegated = negated;
+        }
+        return;
+    }
+    
+    globRules_.push_back({index, compile(text), baseDir, anchored, directoryOnly, negated});
+}
+
+bool IgnoreRules::loadFile(const std::filesystem::path& path, const std::string& baseDir) {
+    std::ifstream file(path);
+    if (!file) return false;
+    
+    std::string line;
+    while (std::getline(file, line)) {
+        addPattern(line, baseDir);
+    }
+    return true;
+}
+
+void IgnoreRules::loadDirectory(const std::filesystem::path& root, const std::string& relativeDir) {
+    std::filesystem::path dir = relativeDir.empty() ? root : root / relativeDir;
+    for (const char* name : {".gitignore", ".agentignore"}) {
+        std::error_code ec;
+        if (std::filesystem::is_regular_file(dir / name, ec)) {
+            loadFile(dir / name, relativeDir);
+        }
+    }
+}
+
+bool IgnoreRules::isIgnored(const std::string& relativePath, bool isDirectory) const {
+    long best = -1;
+    bool bestNegated = false;
+    
+    auto consider = [&](const std::unordered_map<std::string, LiteralRule>& table, const std::string& key) {
+        auto it = table.find(key);
+        if (it == table.end()) return;
+        if (it->second.anyEntry > best) {
+            best = it->second.anyEntry;
+            bestNegated = it->second.anyNegated;
+        }
+        if (isDirectory && it->second.directory > best) {
+            best = it->second.directory;
+            bestNegated = it->second.directoryNegated;
+        }
+    };
+    
+    std::string name = baseName(relativePath);
+    consider(literalNames_, name);
+    consider(literalPaths_, relativePath);
+    
+    // Glob rules are tried newest first, and only while they could still
+    // override the best literal match
+    for (auto it = globRules_.rbegin(); it != globRules_.rend(); ++it) {
+        const GlobRule& rule = *it;
+        if (static_cast<long>(rule.index) <= best) break;
+        if (rule.directoryOnly && !isDirectory) continue;
+        
+        std::string subject = relativePath;
+        if (!rule.baseDir.empty()) {
+            const std::string prefix = rule.baseDir + "/";
+            if (relativePath.compare(0, prefix.size(), prefix) != 0) continue;
+            subject = relativePath.substr(prefix.size());
+        }
+        if (matches(rule.tokens, rule.anchored ? subject : name)) {
+            best = static_cast<long>(rule.index);
+            bestNegated = rule.negated;
+            break;
+        }
+    }
+    
+    return best >= 0 && !bestNegated;
+}
+
+bool IgnoreRules::empty() const {
+    return ruleCount_ == 0;
+}
+
+std::vector<IgnoreRules::Token> IgnoreRules::compile(const std::string& glob) {
+    std::vector<Token> tokens;
+    size_t i = 0;
+    while (i < glob.size()) {
+        char c = glob[i];
+        Token token;
+        
+        if (c == '\\' && i + 1 < glob.size()) {
+            token.literal = glob[i + 1];
+            i += 2;
+        } else if (c == '*') {
+            if (i + 1 < glob.size() && glob[i + 1] == '*') {
+                if (i + 2 < glob.size() && glob[i + 2] == '/') {
+                    token.type = TokenType::DirStar;   // "**/": zero or more directories
+                    i += 3;
+                } else {
+                    token.type = TokenType::DoubleStar;
+                    i += 2;
+                    while (i < glob.size() && glob[i] == '*') i++;
+                }
+            } else {
+                token.type = TokenType::Star;
+                i++;
+            }
+        } else if (c == '?') {
+            token.type = TokenType::AnyChar;
+            i++;
+        } else if (c == '[') {
+            size_t j = i + 1;
+            Token charClass;
+            charClass.type = TokenType::CharClass;
+            if (j < glob.size() && (glob[j] == '!' || glob[j] == '^')) {
+                charClass.negatedClass = true;
+                j++;
+            }
+            size_t first = j;
+            while (j < glob.size() && (glob[j] != ']' || j == first)) {
+                char low = glob[j];
+                if (j + 2 < glob.size() && glob[j + 1] == '-' && glob[j + 2] != ']') {
+                    charClass.ranges.push_back({low, glob[j + 2]});
+                    j += 3;
+                } else {
+                    charClass.ranges.push_back({low, low});
+                    j++;
+                }
+            }
+            if (j < glob.size()) {
+                token = charClass;
+                i = j + 1;
+            } else {
+                token.literal = '[';   // Unterminated: match it literally
+                i++;
+            }
+        } else {
+            token.literal = c;
+            i++;
+        }
+        tokens.push_back(std::move(token));
+    }
+    return tokens;
+}
+
+bool IgnoreRules::matches(const std::vector<Token>& tokens, const std::string& text) {
+    const size_t count = tokens.size();
+    std::vector<char> current(count + 1, 0);
+    std::vector<char> next(count + 1, 0);
+    
+    // Stars may match nothing, so reaching one also reaches the token after it.
+    // A "**/" part way through a path segment (state kMidSegment) may not:
+    // it only skips to the next token at the start of a segment.
+    const char kMidSegment = 2;
+    auto close = [&](std::vector<char>& states) {
+        for (size_t i = 0; i < count; i++) {
+            if (states[i] && tokens[i].type != TokenType::Literal &&
+                tokens[i].type != TokenType::AnyChar && tokens[i].type != TokenType::CharClass &&
+                states[i] != kMidSegment) {
+                states[i + 1] = 1;
+            }
+        }
+    };
+    
+    current[0] = 1;
+    close(current);
+    
+    for (char c : text) {
+        std::fill(next.begin(), next.end(), 0);
+        bool alive = false;
+        for (size_t i = 0; i < count; i++) {
+            if (!current[i]) continue;
+            const Token& token = tokens[i];
+            switch (token.type) {
+                case TokenType::Literal:
+                    if (c == token.literal) next[i + 1] = 1;
+                    break;
+                case TokenType::AnyChar:
+                    if (c != '/') next[i + 1] = 1;
+                    break;
+                case TokenType::CharClass: {
+                    if (c == '/') break;
+                    bool inClass = false;
+                    for (const auto& range : token.ranges) {
+                        if (c >= range.first && c <= range.second) {
+                            inClass = true;
+                            break;
+                        }
+                    }
+                    if (inClass != token.negatedClass) next[i + 1] = 1;
+                    break;
+                }
+                case TokenType::Star:
+                    if (c != '/') next[i] = 1;
+                    break;
+                case TokenType::DoubleStar:
+                    next[i] = 1;
+                    break;
+                case TokenType::DirStar:
+                    if (c == '/') {
+                        next[i] = 1;
+                        next[i + 1] = 1;
+                    } else if (!next[i]) {
+                        next[i] = kMidSegment;
+                    }
+                    break;
+            }
+        }
+        close(next);
+        for (char state : next) {
+            if (state) {
+                alive = true;
+                break;
+            }
+        }
+        if (!alive) return false;
+        current.swap(next);
+    }
+    
+    return current[count] != 0;
+}
+
+} // namespace ollama_agent
@@ -0,0 +1,197 @@
+#include "job_scheduler.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace ollama_agent {
+
+// ---------------------------------------------------------------------------
+// Ticket
+
+JobScheduler::Ticket::Ticket(JobScheduler* scheduler, const std::string& model)
+    : scheduler_(scheduler), model_(model) {}
+
+JobScheduler::Ticket::Ticket(Ticket&& other) noexcept
+    : scheduler_(other.scheduler_), model_(std::move(other.model_)) {
+    other.scheduler_ = nullptr;
+}
+
+JobScheduler::Ticket& JobScheduler::Ticket::operator=(Ticket&& other) noexcept {
+    if (this != &other) {
+        release();
+        scheduler_ = other.scheduler_;
+        model_ = std::move(other.model_);
+        other.scheduler_ = nullptr;
+    }
+    return *this;
+}
+
+JobScheduler::Ticket::~Ticket() {
+    release();
+}
+
+void JobScheduler::Ticket::release() {
+    if (scheduler_) {
+        scheduler_->release(model_);
+        scheduler_ = nullptr;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// JobScheduler
+
+JobScheduler::JobScheduler(const SchedulerConfig& config) : config_(config) {
+    config_.maxConcurrent = std::max(1, config_.maxConcurrent);
+    config_.defaultModelConcurrency = std::max(1, config_.defaultModelConcurrency);
+}
+
+int JobScheduler::modelLimit(const std::string& model) const {
+    auto it = config_.modelConcurrency.find(model);
+    int limit = (it != config_.modelConcurrency.end()) ? it->second : config_.defaultModelConcurrency;
+    return std::max(1, limit);
+}
+
+JobScheduler::Ticket JobScheduler::admit(const std::string& sessionId, const std::string& model,
+                                         JobPriority priority, const CancellationToken* token) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    
+    // Weighted fair queuing: each job costs 1/weight of virtual time for its session
+    auto weightIt = sessionWeights_.find(sessionId);
+    double weight = (weightIt != sessionWeights_.end()) ? weightIt->second : 1.0;
+    double start = std::max(virtualTime_, sessionFinish_[sessionId]);
+    
+    Job job;
+    job.sequence = nextSequence_++;
+    job.sessionId = sessionId;
+    job.model = model;
+    job.priority = priority;
+    job.virtualStart = start;
+    job.virtualFinish = start + 1.0 / weight;
+    sessionFinish_[sessionId] = job.virtualFinish;
+    
+    auto it = queue_.insert(queue_.end(), job);
+    dispatch();
+    
+    while (!it->granted) {
+        if (token) {
+            // Poll so a cancelled job leaves the queue promptly
+            changed_.wait_for(lock, std::chrono::milliseconds(100));
+            if (!it->granted && token->isCancelled()) {
+                queue_.erase(it);
+                dispatch();
+                return Ticket();
+            }
+        } else {
+            changed_.wait(lock);
+        }
+    }
+    
+    queue_.erase(it);
+    return Ticket(this, model);
+}
+
+void JobScheduler::release(const std::string& model) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_--;
+        if (--runningPerModel_[model] <= 0) {
+            runningPerModel_.erase(model);
+        }
+        dispatch();
+    }
+    changed_.notify_all();
+}
+
+void JobScheduler::dispatch() {
+    bool grantedAny = false;
+    
+    while (running_ < config_.maxConcurrent) {
+        // Is another model waiting? Only then does the streak limit matter.
+        bool otherModelWaiting = false;
+        for (const auto& job : queue_) {
+            if (!job.granted && job.model != loadedModel_) {
+                otherModelWaiting = true;
+                break;
+            }
+        }
+        bool preferLoaded = !loadedModel_.empty() &&
+                            (!otherModelWaiting || modelStreak_ < config_.maxModelStreak);
+        
+        Job* best = nullptr;
+        for (auto& job : queue_) {
+            if (job.granted) continue;
+            auto running = runningPerModel_.find(job.model);
+            if (running != runningPerModel_.end() && running->second >= modelLimit(job.model)) continue;
+            
+            if (!best) {
+                best = &job;
+                continue;
+            }
+            if (job.priority != best->priority) {
+                if (job.priority == JobPriority::Interactive) best = &job;
+                continue;
+            }
+            if (preferLoaded) {
+                bool jobLoaded = job.model == loadedModel_;
+                bool bestLoaded = best->model == loadedModel_;
+                if (jobLoaded != bestLoaded) {
+                    if (jobLoaded) best = &job;
+                    continue;
+                }
+            }
+            if (job.virtualFinish < best->virtualFinish ||
+                (job.virtualFinish == best->virtualFinish && job.sequence < best->sequence)) {
+                best = &job;
+            }
+        }
+        
+        if (!best) break;
+        
+        best->granted = true;
+        grantedAny = true;
+        running_++;
+        runningPerModel_[best->model]++;
+        virtualTime_ = std::max(virtualTime_, best->virtualStart);
+        if (best->model == loadedModel_) {
+            modelStreak_++;
+        } else {
+            loadedModel_ = best->model;
+            modelStreak_ = 1;
+        }
+    }
+    
+    if (grantedAny) {
+        changed_.notify_all();
+    }
+}
+
+void JobScheduler::setSessionWeight(const std::string& sessionId, double weight) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessionWeights_[sessionId] = (weight > 0.0) ? weight : 1.0;
+}
+
+void JobScheduler::removeSession(const std::string& sessionId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessionWeights_.erase(sessionId);
+    sessionFinish_.erase(sessionId);
+}
+
+size_t JobScheduler::getQueuedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+    for (const auto& job : queue_) {
+        if (!job.granted) count++;
+    }
+    return count;
+}
+
+size_t JobScheduler::getRunningCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(running_);
+}
+
+std::string JobScheduler::getLoadedModel() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return loadedModel_;
+}
+
+} // namespace ollama_agent
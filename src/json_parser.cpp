@@ -2,30 +2,43 @@
 #include <sstream>
 #include <algorithm>
 #include <iomanip>
+#include <cctype>
 
 namespace ollama_agent {
 
 std::string JsonParser::escapeJson(const std::string& input) {
-    std::ostringstream ss;
-    for (char c : input) {
+    std::string result;
+    result.reserve(input.size() + input.size() / 8);
+    appendEscapedJson(result, input);
+    return result;
+}
+
+void JsonParser::appendEscapedJson(std::string& out, std::string_view input) {
+    static const char hexDigits[] = "0123456789abcdef";
+    
+    // Copy runs of characters that need no escaping in one go
+    size_t runStart = 0;
+    for (size_t i = 0; i < input.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(input[i]);
+        if (c >= 0x20 && c != '\\' && c != '"') continue;
+        
+        out.append(input.data() + runStart, i - runStart);
+        runStart = i + 1;
         switch (c) {
-            case '\\': ss << "\\\\"; break;
-            case '"':  ss << "\\\""; break;
-            case '\n': ss << "\\n"; break;
-            case '\r': ss << "\\r"; break;
-            case '\t': ss << "\\t"; break;
-            case '\b': ss << "\\b"; break;
-            case '\f': ss << "\\f"; break;
+            case '\\': out += "\\\\"; break;
+            case '"':  out += "\\\""; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
             default:
-                if (static_cast<unsigned char>(c) < 0x20) {
-                    ss << "\\u" << std::hex << std::setfill('0') << std::setw(4) 
-                       << static_cast<int>(static_cast<unsigned char>(c));
-                } else {
-                    ss << c;
-                }
+                out += "\\u00";
+                out += hexDigits[c >> 4];
+                out += hexDigits[c & 0x0f];
         }
     }
-    return ss.str();
+    out.append(input.data() + runStart, input.size() - runStart);
 }
 
 size_t JsonParser::findValueStart(const std::string& json, const std::string& key) {
@@ -133,6 +146,25 @@ std::optional<bool> JsonParser::getBool(const std::string& json, const std::stri
     return std::nullopt;
 }
 
+std::optional<long long> JsonParser::getInt(const std::string& json, const std::string& key) {
+    size_t valueStart = findValueStart(json, key);
+    if (valueStart == std::string::npos) {
+        return std::nullopt;
+    }
+    
+    size_t valueEnd = valueStart;
+    if (valueEnd < json.length() && json[valueEnd] == '-') valueEnd++;
+    while (valueEnd < json.length() && std::isdigit(static_cast<unsigned char>(json[valueEnd]))) {
+        valueEnd++;
+    }
+    
+    try {
+        return std::stoll(json.substr(valueStart, valueEnd - valueStart));
+    } catch (...) {
+        return std::nullopt;
+    }
+}
+
 std::string JsonParser::extractStreamContent(const std::string& response) {
     std::ostringstream fullContent;
     std::istringstream stream(response);
@@ -156,14 +188,60 @@ std::string JsonParser::extractStreamContent(const std::string& response) {
     return fullContent.str();
 }
 
+bool GenerationOptions::empty() const {
+    return !numCtx && !numPredict && !numThread && !temperature;
+}
+
+std::string JsonParser::buildOptionFields(const RequestOptions& options) {
+    std::ostringstream json;
+    
+    if (!options.keepAlive.empty()) {
+        // Plain integers are seconds; anything else is a duration string like "30m"
+        bool numeric = options.keepAlive.find_first_not_of("-0123456789") == std::string::npos;
+        json << ",\"keep_alive\":";
+        if (numeric) {
+            json << options.keepAlive;
+        } else {
+            json << "\"" << escapeJson(options.keepAlive) << "\"";
+        }
+    }
+    
+    if (!options.format.empty()) {
+        json << ",\"format\":" << options.format;
+    }
+    
+    const GenerationOptions& generation = options.generation;
+    if (!generation.empty()) {
+        std::vector<std::string> fields;
+        if (generation.numCtx) fields.push_back("\"num_ctx\":" + std::to_string(*generation.numCtx));
+        if (generation.numPredict) fields.push_back("\"num_predict\":" + std::to_string(*generation.numPredict));
+        if (generation.numThread) fields.push_back("\"num_thread\":" + std::to_string(*generation.numThread));
+        if (generation.temperature) {
+            std::ostringstream value;
+            value << *generation.temperature;
+            fields.push_back("\"temperature\":" + value.str());
+        }
+        
+        json << ",\"options\":{";
+        for (size_t i = 0; i < fields.size(); ++i) {
+            json << (i > 0 ? "," : "") << fields[i];
+        }
+        json << "}";
+    }
+    
+    return json.str();
+}
+
 std::string JsonParser::buildRequest(const std::string& model, 
                                      const std::string& prompt,
-                                     bool stream) {
+                                     bool stream,
+                                     const RequestOptions& options) {
     std::ostringstream json;
     json << "{";
     json << "\"model\":\"" << escapeJson(model) << "\",";
     json << "\"prompt\":\"" << escapeJson(prompt) << "\",";
     json << "\"stream\":" << (stream ? "true" : "false");
+    json << buildOptionFields(options);
     json << "}";
     return json.str();
 }
@@ -171,17 +249,32 @@ std::string JsonParser::buildRequest(const std::string& model,
 std::string JsonParser::buildChatRequest(const std::string& model,
                                          const std::string& systemPrompt,
                                          const std::string& userMessage,
-                                         bool stream) {
-    std::ostringstream json;
-    json << "{";
-    json << "\"model\":\"" << escapeJson(model) << "\",";
-    json << "\"messages\":[";
-    json << "{\"role\":\"system\",\"content\":\"" << escapeJson(systemPrompt) << "\"},";
-    json << "{\"role\":\"user\",\"content\":\"" << escapeJson(userMessage) << "\"}";
-    json << "],";
-    json << "\"stream\":" << (stream ? "true" : "false");
-    json << "}";
-    return json.str();
+                                         bool stream,
+                                         const RequestOptions& options) {
+    RequestBody userContent;
+    userContent.appendEscaped(userMessage);
+    return buildChatRequestBody(model, systemPrompt, userContent, stream, options).toString();
+}
+
+RequestBody JsonParser::buildChatRequestBody(const std::string& model,
+                                             const std::string& systemPrompt,
+                                             const RequestBody& userContent,
+                                             bool stream,
+                                             const RequestOptions& options,
+                                             const std::string& assistantPrefix) {
+    RequestBody body;
+    body.appendRaw("{\"model\":\"" + escapeJson(model) + "\",\"messages\":[");
+    body.appendRaw("{\"role\":\"system\",\"content\":\"");
+    body.appendEscaped(systemPrompt);
+    body.appendRaw("\"},{\"role\":\"user\",\"content\":\"");
+    body.append(userContent);
+    if (!assistantPrefix.empty()) {
+        body.appendRaw("\"},{\"role\":\"assistant\",\"content\":\"");
+        body.appendEscaped(assistantPrefix);
+    }
+    body.appendRaw("\"}],\"stream\":" + std::string(stream ? "true" : "false") +
+                   buildOptionFields(options) + "}");
+    return body;
 }
 
 } // namespace ollama_agent
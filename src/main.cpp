@@ -1,15 +1,40 @@
 #include "agent.hpp"
 #include "ollama_client.hpp"
 #include "file_manager.hpp"
+#include "response_cache.hpp"
+#include "agent_server.hpp"
+#include "event_queue.hpp"
+#include "config_file.hpp"
 #include <iostream>
 #include <string>
 #include <algorithm>
 #include <filesystem>
+#include <sstream>
+#include <vector>
+#include <csignal>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
+// Ctrl+C cancels the request in flight instead of killing the program
+static ollama_agent::CancellationToken g_cancelToken;
+static volatile std::sig_atomic_t g_requestActive = 0;
+
+extern "C" void handleInterrupt(int signal) {
+    if (g_requestActive) {
+        g_cancelToken.cancel();
+        std::signal(SIGINT, handleInterrupt);
+    } else {
+        std::signal(signal, SIG_DFL);
+        std::raise(signal);
+    }
+}
+
 void printBanner() {
     std::cout << R"(
   ___  _ _                        _                    _   
@@ -29,11 +54,15 @@ void printHelp() {
     std::cout << "  /help           - Show this help message" << std::endl;
     std::cout << "  /models         - List available Ollama models" << std::endl;
     std::cout << "  /model <name>   - Switch to a different model" << std::endl;
+    std::cout << "  /ps             - Show models loaded in Ollama and last warm-up time" << std::endl;
+    std::cout << "  /structured     - Toggle JSON structured output mode" << std::endl;
+    std::cout << "  /race [off|<model> <model>...] - Race requests across several models" << std::endl;
     std::cout << "  /dir <path>     - Change output directory" << std::endl;
     std::cout << "  /pwd            - Show current output directory" << std::endl;
     std::cout << "  /list           - List files in output directory" << std::endl;
     std::cout << "  /verbose        - Toggle verbose/debug mode" << std::endl;
     std::cout << "  /raw            - Show raw response from last request" << std::endl;
+    std::cout << "  /cache [clear|bypass on|off] - Show or manage the response cache" << std::endl;
     std::cout << "  /clear          - Clear the screen" << std::endl;
     std::cout << "  /quit or /exit  - Exit the program" << std::endl;
     std::cout << "\nOr just type your request to generate code!" << std::endl;
@@ -55,6 +84,34 @@ std::string trim(const std::string& str) {
     return str.substr(start, end - start + 1);
 }
 
+std::vector<std::string> splitList(const std::string& str, char separator) {
+    std::vector<std::string> items;
+    std::istringstream stream(str);
+    std::string item;
+    while (std::getline(stream, item, separator)) {
+        item = trim(item);
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Print a batch of queued agent output with a single flush
+size_t printEvents(ollama_agent::AgentEventQueue& queue) {
+    std::vector<ollama_agent::AgentEvent> batch;
+    size_t count = queue.drain(batch);
+    for (const auto& event : batch) {
+        if (event.type == ollama_agent::AgentEventType::Status) {
+            std::cout << event.text << '\n';
+        }
+    }
+    if (count > 0) {
+        std::cout.flush();
+    }
+    return count;
+}
+
 int main(int argc, char* argv[]) {
 #ifdef _WIN32
     // Enable UTF-8 output on Windows
@@ -68,6 +125,99 @@ int main(int argc, char* argv[]) {
     std::string outputDir = ".";
     std::string model = "llama3.2";
     bool verbose = false;
+    bool useCache = false;
+    bool cacheBypass = false;
+    std::string cacheDir;
+    std::vector<std::string> raceModels;
+    ollama_agent::RetryPolicy retryPolicy;
+    bool structured = false;
+    bool earlyStop = false;
+    int fanOut = 0;
+    std::string embedModel;
+    int topK = 8;
+    bool summaries = false;
+    std::string summaryModel;
+    std::string minify;
+    bool dedup = false;
+    bool checkpoint = false;
+    bool prefill = false;
+    std::string keepAlive = "30m";
+    std::string host = "127.0.0.1";
+    int port = 11434;
+    bool compress = false;
+    bool fastStart = false;
+    int modelsTtl = -1;
+    bool serve = false;
+    ollama_agent::ServerConfig serverConfig;
+    int timeoutSeconds = 300;  // 5 minutes for complex requests
+    ollama_agent::ResponseCacheConfig cacheConfig;
+    ollama_agent::ContextLimits contextLimits;
+    
+    // The config file is applied first so command-line flags override it
+    std::string configPath;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--config") {
+            configPath = argv[i + 1];
+        }
+    }
+    bool explicitConfig = !configPath.empty();
+    if (!explicitConfig) {
+        configPath = ollama_agent::defaultConfigPath();
+    }
+    ollama_agent::ConfigFile configFile;
+    if (explicitConfig || std::filesystem::exists(configPath)) {
+        if (!configFile.load(configPath)) {
+            std::cerr << "ERROR: " << configFile.getLastError() << std::endl;
+            return 1;
+        }
+        std::cout << "[OK] Loaded config: " << configPath << std::endl;
+        for (const auto& warning : configFile.getWarnings()) {
+            std::cerr << "WARNING: " << warning << std::endl;
+        }
+        
+        host = configFile.getString("host").value_or(host);
+        port = static_cast<int>(configFile.getInt("port").value_or(port));
+        model = configFile.getString("model").value_or(model);
+        timeoutSeconds = static_cast<int>(configFile.getInt("timeout").value_or(timeoutSeconds));
+        keepAlive = configFile.getString("keep_alive").value_or(keepAlive);
+        compress = configFile.getBool("compress").value_or(compress);
+        modelsTtl = static_cast<int>(configFile.getInt("models_ttl").value_or(modelsTtl));
+        structured = configFile.getBool("structured").value_or(structured);
+        earlyStop = configFile.getBool("early_stop").value_or(earlyStop);
+        fanOut = static_cast<int>(configFile.getInt("fan_out").value_or(fanOut));
+        embedModel = configFile.getString("embed_model").value_or(embedModel);
+        topK = static_cast<int>(configFile.getInt("top_k").value_or(topK));
+        summaries = configFile.getBool("summaries").value_or(summaries);
+        summaryModel = configFile.getString("summary_model").value_or(summaryModel);
+        minify = configFile.getString("minify").value_or(minify);
+        dedup = configFile.getBool("dedup").value_or(dedup);
+        checkpoint = configFile.getBool("checkpoint").value_or(checkpoint);
+        prefill = configFile.getBool("prefill").value_or(prefill);
+        if (auto retries = configFile.getInt("retries")) {
+            retryPolicy.maxAttempts = std::max(1, static_cast<int>(*retries) + 1);
+        }
+        retryPolicy.deadlineSeconds = static_cast<int>(configFile.getInt("deadline").value_or(retryPolicy.deadlineSeconds));
+        
+        useCache = configFile.getBool("cache").value_or(useCache);
+        if (auto dir = configFile.getString("cache_dir")) {
+            cacheDir = *dir;
+            useCache = true;
+        }
+        cacheConfig.maxEntries = static_cast<size_t>(configFile.getInt("cache_entries").value_or(cacheConfig.maxEntries));
+        cacheConfig.maxBytes = static_cast<size_t>(configFile.getInt("cache_bytes").value_or(cacheConfig.maxBytes));
+        
+        serverConfig.port = static_cast<int>(configFile.getInt("server_port").value_or(serverConfig.port));
+        serverConfig.workerThreads = static_cast<int>(configFile.getInt("workers").value_or(serverConfig.workerThreads));
+        serverConfig.clientPoolSize = static_cast<int>(configFile.getInt("parallel").value_or(serverConfig.clientPoolSize));
+        serverConfig.scheduler.defaultModelConcurrency =
+            static_cast<int>(configFile.getInt("per_model").value_or(serverConfig.scheduler.defaultModelConcurrency));
+        
+        contextLimits.maxFiles = static_cast<size_t>(configFile.getInt("context_files").value_or(contextLimits.maxFiles));
+        contextLimits.maxFileBytes = static_cast<size_t>(configFile.getInt("context_file_bytes").value_or(contextLimits.maxFileBytes));
+        contextLimits.maxTotalBytes = static_cast<size_t>(configFile.getInt("context_budget").value_or(contextLimits.maxTotalBytes));
+        contextLimits.sectionBytes = static_cast<size_t>(configFile.getInt("context_section_bytes").value_or(contextLimits.sectionBytes));
+        contextLimits.summaryBytes = static_cast<size_t>(configFile.getInt("context_summary_bytes").value_or(contextLimits.summaryBytes));
+    }
     
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -81,12 +231,136 @@ int main(int argc, char* argv[]) {
             }
         } else if (arg == "--verbose" || arg == "-v") {
             verbose = true;
+        } else if (arg == "--retries") {
+            if (i + 1 < argc) {
+                retryPolicy.maxAttempts = std::max(1, std::atoi(argv[++i]) + 1);
+            }
+        } else if (arg == "--deadline") {
+            if (i + 1 < argc) {
+                retryPolicy.deadlineSeconds = std::max(0, std::atoi(argv[++i]));
+            }
+        } else if (arg == "--keep-alive") {
+            if (i + 1 < argc) {
+                keepAlive = argv[++i];
+            }
+        } else if (arg == "--config") {
+            i++;  // Already loaded above
+        } else if (arg == "--host") {
+            if (i + 1 < argc) {
+                host = argv[++i];
+                size_t colon = host.rfind(':');
+                if (colon != std::string::npos) {
+                    port = std::atoi(host.c_str() + colon + 1);
+                    host = host.substr(0, colon);
+                }
+            }
+        } else if (arg == "--compress") {
+            compress = true;
+        } else if (arg == "--fast-start") {
+            fastStart = true;
+        } else if (arg == "--models-ttl") {
+            if (i + 1 < argc) {
+                modelsTtl = std::max(0, std::atoi(argv[++i]));
+            }
+        } else if (arg == "--structured") {
+            structured = true;
+        } else if (arg == "--early-stop") {
+            earlyStop = true;
+        } else if (arg == "--fan-out") {
+            if (i + 1 < argc) {
+                fanOut = std::max(0, std::atoi(argv[++i]));
+            }
+        } else if (arg == "--embed-model") {
+            if (i + 1 < argc) {
+                embedModel = argv[++i];
+            }
+        } else if (arg == "--top-k") {
+            if (i + 1 < argc) {
+                topK = std::max(1, std::atoi(argv[++i]));
+            }
+        } else if (arg == "--summaries") {
+            summaries = true;
+        } else if (arg == "--summary-model") {
+            if (i + 1 < argc) {
+                summaryModel = argv[++i];
+            }
+        } else if (arg == "--minify") {
+            if (i + 1 < argc) {
+                minify = argv[++i];
+            }
+        } else if (arg == "--dedup") {
+            dedup = true;
+        } else if (arg == "--checkpoint") {
+            checkpoint = true;
+        } else if (arg == "--prefill") {
+            prefill = true;
+        } else if (arg == "--serve") {
+            serve = true;
+        } else if (arg == "--server-port") {
+            if (i + 1 < argc) {
+                serverConfig.port = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--workers") {
+            if (i + 1 < argc) {
+                serverConfig.workerThreads = std::max(1, std::atoi(argv[++i]));
+            }
+        } else if (arg == "--parallel") {
+            if (i + 1 < argc) {
+                serverConfig.clientPoolSize = std::max(1, std::atoi(argv[++i]));
+            }
+        } else if (arg == "--per-model") {
+            if (i + 1 < argc) {
+                serverConfig.scheduler.defaultModelConcurrency = std::max(1, std::atoi(argv[++i]));
+            }
+        } else if (arg == "--race") {
+            if (i + 1 < argc) {
+                raceModels = splitList(argv[++i], ',');
+            }
+        } else if (arg == "--cache") {
+            useCache = true;
+        } else if (arg == "--cache-dir") {
+            if (i + 1 < argc) {
+                cacheDir = argv[++i];
+                useCache = true;
+            }
+        } else if (arg == "--cache-bypass") {
+            useCache = true;
+            cacheBypass = true;
         } else if (arg == "--help" || arg == "-h") {
             std::cout << "\nUsage: ollama_agent [options]" << std::endl;
             std::cout << "\nOptions:" << std::endl;
             std::cout << "  -o, --output <dir>   Set output directory (default: current)" << std::endl;
             std::cout << "  -m, --model <name>   Set Ollama model (default: llama3.2)" << std::endl;
             std::cout << "  -v, --verbose        Enable verbose output" << std::endl;
+            std::cout << "  --retries <n>        Retries for transient connection errors (default: 3)" << std::endl;
+            std::cout << "  --deadline <sec>     Overall time budget per request incl. retries" << std::endl;
+            std::cout << "  --keep-alive <dur>   How long Ollama keeps the model loaded (default: 30m)" << std::endl;
+            std::cout << "  --config <file>      Load settings and model profiles (default: " << ollama_agent::defaultConfigPath() << ")" << std::endl;
+            std::cout << "  --host <host[:port]> Ollama server (default: 127.0.0.1:11434)" << std::endl;
+            std::cout << "  --compress           Gzip large request bodies (for remote hosts)" << std::endl;
+            std::cout << "  --fast-start         Skip startup checks; verify the connection in the background" << std::endl;
+            std::cout << "  --models-ttl <sec>   Reuse the model list cached on disk (default: 600 with --fast-start)" << std::endl;
+            std::cout << "  --structured         Request files as JSON (schema) instead of markdown" << std::endl;
+            std::cout << "  --early-stop         Stop generation once all files are complete" << std::endl;
+            std::cout << "  --checkpoint         Log streamed output to disk; resume interrupted replies" << std::endl;
+            std::cout << "  --prefill            Evaluate the prompt and project files while you type" << std::endl;
+            std::cout << "  --fan-out <n>        Plan files first, then generate up to n files at once" << std::endl;
+            std::cout << "  --embed-model <name> Pick context files by embedding similarity (e.g. nomic-embed-text)" << std::endl;
+            std::cout << "  --top-k <n>          Chunks retrieved per request with --embed-model (default: 8)" << std::endl;
+            std::cout << "  --summaries          List files left out of the context with cached summaries" << std::endl;
+            std::cout << "  --summary-model <m>  Have a model write those summaries (implies --summaries)" << std::endl;
+            std::cout << "  --minify <langs>     Send project files minified: all or html,css,js,json,py,cpp" << std::endl;
+            std::cout << "  --dedup              Send blocks repeated across files once, not in each file" << std::endl;
+            std::cout << "  --race <m1,m2,...>   Race requests across models, keep first valid result" << std::endl;
+            std::cout << "  --cache              Cache responses to identical requests on disk" << std::endl;
+            std::cout << "  --cache-dir <dir>    Set response cache directory (implies --cache)" << std::endl;
+            std::cout << "  --cache-bypass       Always query Ollama but refresh the cache" << std::endl;
+            std::cout << "  --serve              Run as a headless HTTP/JSON server instead of the REPL" << std::endl;
+            std::cout << "  --server-port <n>    Port --serve listens on (default: 11500); the Ollama" << std::endl;
+            std::cout << "                       port is set with --host or the config key port" << std::endl;
+            std::cout << "  --workers <n>        Server connections handled concurrently (default: 4)" << std::endl;
+            std::cout << "  --parallel <n>       Server jobs sent to Ollama at once (default: 2)" << std::endl;
+            std::cout << "  --per-model <n>      Server jobs per model at once (default: 1)" << std::endl;
             std::cout << "  -h, --help           Show this help" << std::endl;
             return 0;
         }
@@ -94,56 +368,140 @@ int main(int argc, char* argv[]) {
     
     // Initialize components
     ollama_agent::OllamaConfig config;
-    config.host = "127.0.0.1";
-    config.port = 11434;
+    config.host = host;
+    config.port = port;
     config.model = model;
-    config.timeoutSeconds = 300;  // 5 minutes for complex requests
+    config.timeoutSeconds = timeoutSeconds;
+    config.keepAlive = keepAlive;
+    config.profiles = configFile.getProfiles();
+    config.compressRequests = compress;
+    config.modelListTtlSeconds = (modelsTtl >= 0) ? modelsTtl : (fastStart ? 600 : 0);
+    
+    if (compress && !ollama_agent::OllamaClient::supportsCompression()) {
+        std::cerr << "WARNING: Built without zlib; --compress is ignored" << std::endl;
+    }
     
     ollama_agent::OllamaClient client(config);
     ollama_agent::FileManager fileManager(outputDir);
     ollama_agent::Agent agent(client, fileManager);
     
+    auto events = std::make_shared<ollama_agent::AgentEventQueue>();
+    agent.setEventQueue(events);
     agent.setVerbose(verbose);
-    
-    // Check Ollama availability
-    std::cout << "\nConnecting to Ollama..." << std::endl;
-    if (!client.isAvailable()) {
-        std::cerr << "ERROR: Cannot connect to Ollama at " << config.host << ":" << config.port << std::endl;
-        std::cerr << "Make sure Ollama is running: ollama serve" << std::endl;
-        std::cerr << "Error: " << client.getLastError() << std::endl;
-        return 1;
+    agent.setRaceModels(raceModels);
+    agent.setStructuredOutput(structured);
+    agent.setEarlyStop(earlyStop);
+    agent.setFanOut(fanOut);
+    agent.setRetrieval(embedModel, static_cast<size_t>(topK));
+    agent.setContextLimits(contextLimits);
+    std::vector<std::string> unknownLanguages;
+    agent.setMinify(ollama_agent::parseMinifyLanguages(minify, &unknownLanguages));
+    for (const auto& language : unknownLanguages) {
+        std::cerr << "WARNING: Unknown --minify language '" << language << "'" << std::endl;
     }
-    
-    std::cout << "[OK] Connected to Ollama" << std::endl;
-    
-    // List available models and auto-select first one
-    std::cout << "\nAvailable models:" << std::endl;
-    auto models = client.listModels();
-    if (models.empty()) {
-        std::cerr << "ERROR: No models found!" << std::endl;
-        std::cerr << "Please pull a model first: ollama pull llama3.2" << std::endl;
-        return 1;
+    agent.setDeduplication(dedup);
+    if (checkpoint) {
+        agent.setCheckpointLog(std::make_shared<ollama_agent::CheckpointLog>());
+    }
+    agent.setPrefill(prefill);
+    if (summaries || !summaryModel.empty()) {
+        agent.setSummaryCache(std::make_shared<ollama_agent::SummaryCache>(config, summaryModel));
     }
+    agent.setWorkspaceWatcher(std::make_shared<ollama_agent::WorkspaceWatcher>(fileManager.getWorkingDirectory()));
+    client.setRetryPolicy(retryPolicy);
+    client.setCancellationToken(g_cancelToken);
+    std::signal(SIGINT, handleInterrupt);
     
-    for (const auto& m : models) {
-        std::cout << "  - " << m << std::endl;
+    if (useCache) {
+        cacheConfig.directory = cacheDir;
+        client.setResponseCache(std::make_shared<ollama_agent::ResponseCache>(cacheConfig));
+        client.setCacheBypass(cacheBypass);
     }
     
-    // Use first model if no model was specified via command line
-    if (model == "llama3.2") {  // Default wasn't changed
-        client.setModel(models[0]);
+    if (fastStart) {
+        // No round-trips before the prompt: the model comes from the flags (or
+        // the cached model list) and connection problems show up on first use
+        client.checkAvailabilityAsync();
+        auto cached = client.getCachedModels();
+        if (model == "llama3.2" && !cached.empty()) {
+            client.setModel(cached[0]);
+        }
+    } else {
+        // One /api/tags request both checks the connection and lists models
+        std::cout << "\nConnecting to Ollama at " << config.host << ":" << config.port << "..." << std::endl;
+        auto models = client.listModels(false);
+        if (client.getLastErrorKind() != ollama_agent::RequestError::None) {
+            std::cerr << "ERROR: Cannot connect to Ollama at " << config.host << ":" << config.port << std::endl;
+            std::cerr << "Make sure Ollama is running: ollama serve" << std::endl;
+            std::cerr << "Error: " << client.getLastError() << std::endl;
+            return 1;
+        }
+        
+        std::cout << "[OK] Connected to Ollama" << std::endl;
+        
+        // List available models and auto-select first one
+        std::cout << "\nAvailable models:" << std::endl;
+        if (models.empty()) {
+            std::cerr << "ERROR: No models found!" << std::endl;
+            std::cerr << "Please pull a model first: ollama pull llama3.2" << std::endl;
+            return 1;
+        }
+        
+        for (const auto& m : models) {
+            std::cout << "  - " << m << std::endl;
+        }
+        
+        // Use first model if no model was specified via command line
+        if (model == "llama3.2") {  // Default wasn't changed
+            client.setModel(models[0]);
+        }
     }
     
     std::cout << "\n[OK] Using model: " << client.getModel() << std::endl;
+    
+    // Load the model while the user types the first request
+    client.preloadModelAsync(client.getModel());
+    std::cout << "[i] Warming up model in the background..." << std::endl;
+    if (fanOut > 0) {
+        std::cout << "[OK] Per-file generation: up to " << fanOut << " at once" << std::endl;
+    } else if (raceModels.size() >= 2) {
+        std::cout << "[OK] Racing models: " << raceModels.size() << std::endl;
+    }
     std::cout << "[OK] Output directory: " << fileManager.getWorkingDirectory() << std::endl;
     
+    // Headless mode: serve sessions over HTTP until killed
+    if (serve) {
+        serverConfig.defaultWorkingDir = fileManager.getWorkingDirectory();
+        serverConfig.contextLimits = contextLimits;
+        ollama_agent::AgentServer server(client, serverConfig);
+        std::cout << "[OK] Serving on http://" << serverConfig.bindAddress << ":" << serverConfig.port << std::endl;
+        if (!server.run()) {
+            std::cerr << "ERROR: " << server.getLastError() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    
     printHelp();
     
     // Main interaction loop
     std::string input;
+    bool availabilityReported = !fastStart;
     while (true) {
+        // Report the background connection check once it has finished
+        if (!availabilityReported && client.getAvailability() != ollama_agent::Availability::Unknown) {
+            availabilityReported = true;
+            if (client.getAvailability() == ollama_agent::Availability::Unavailable) {
+                std::cerr << "\nWARNING: Cannot connect to Ollama at " << config.host << ":" << config.port << std::endl;
+                std::cerr << "Make sure Ollama is running: ollama serve" << std::endl;
+            }
+        }
+        
+        // Ollama evaluates the prompt prefix while the next request is typed
+        agent.startPrefill();
         std::cout << "\n> ";
         std::getline(std::cin, input);
+        agent.stopPrefill();
         
         if (std::cin.eof()) {
             break;
@@ -189,7 +547,58 @@ int main(int argc, char* argv[]) {
                     std::cout << "Current model: " << client.getModel() << std::endl;
                 } else {
                     client.setModel(arg);
-                    std::cout << "Switched to model: " << client.getModel() << std::endl;
+                    client.preloadModelAsync(arg);
+                    std::cout << "Switched to model: " << client.getModel() << " (warming up)" << std::endl;
+                }
+            } else if (cmd == "/ps") {
+                auto loaded = client.listLoadedModels();
+                std::cout << "Loaded models:" << std::endl;
+                if (loaded.empty()) {
+                    std::cout << "  (none)" << std::endl;
+                }
+                for (const auto& m : loaded) {
+                    std::cout << "  - " << m << std::endl;
+                }
+                if (client.isPreloading()) {
+                    std::cout << "Warm-up of " << client.getModel() << " in progress" << std::endl;
+                } else if (client.getLastPreloadMs() >= 0) {
+                    std::cout << "Last warm-up load time: " << client.getLastPreloadMs() << " ms" << std::endl;
+                }
+            } else if (cmd == "/structured") {
+                structured = (arg.empty()) ? !structured : (arg == "on");
+                agent.setStructuredOutput(structured);
+                std::cout << "Structured output: " << (structured ? "ON" : "OFF") << std::endl;
+            } else if (cmd == "/race") {
+                if (arg == "off") {
+                    agent.setRaceModels({});
+                    std::cout << "Racing disabled" << std::endl;
+                } else if (arg.empty()) {
+                    auto racing = agent.getRaceModels();
+                    if (racing.size() < 2) {
+                        std::cout << "Racing disabled (use /race <model> <model>...)" << std::endl;
+                    } else {
+                        std::cout << "Racing models:" << std::endl;
+                        for (const auto& m : racing) {
+                            std::cout << "  - " << m << std::endl;
+                        }
+                    }
+                } else {
+                    auto requested = splitList(arg, ' ');
+                    auto available = client.listModels();
+                    std::vector<std::string> racing;
+                    for (const auto& m : requested) {
+                        if (std::find(available.begin(), available.end(), m) == available.end()) {
+                            std::cout << "  Skipping unknown model: " << m << std::endl;
+                        } else {
+                            racing.push_back(m);
+                        }
+                    }
+                    if (racing.size() < 2) {
+                        std::cout << "Need at least two available models to race" << std::endl;
+                    } else {
+                        agent.setRaceModels(racing);
+                        std::cout << "Racing " << racing.size() << " models" << std::endl;
+                    }
                 }
             } else if (cmd == "/dir") {
                 if (arg.empty()) {
@@ -223,6 +632,24 @@ int main(int argc, char* argv[]) {
                     std::cout << lastResponse << std::endl;
                     std::cout << "=== END RAW RESPONSE ===" << std::endl;
                 }
+            } else if (cmd == "/cache") {
+                auto cache = client.getResponseCache();
+                if (!cache) {
+                    std::cout << "Response cache is disabled (start with --cache)" << std::endl;
+                } else if (arg == "clear") {
+                    cache->clear();
+                    std::cout << "Response cache cleared" << std::endl;
+                } else if (arg == "bypass on" || arg == "bypass off") {
+                    cacheBypass = (arg == "bypass on");
+                    client.setCacheBypass(cacheBypass);
+                    std::cout << "Cache bypass: " << (cacheBypass ? "ON" : "OFF") << std::endl;
+                } else {
+                    std::cout << "Cache directory: " << cache->getDirectory() << std::endl;
+                    std::cout << "  Entries: " << cache->getEntryCount()
+                              << " (" << cache->getTotalBytes() / 1024 << " KB)" << std::endl;
+                    std::cout << "  Hits: " << cache->getHits() << ", misses: " << cache->getMisses() << std::endl;
+                    std::cout << "  Bypass: " << (cacheBypass ? "ON" : "OFF") << std::endl;
+                }
             } else if (cmd == "/clear" || cmd == "/cls") {
                 clearScreen();
                 printBanner();
@@ -234,8 +661,25 @@ int main(int argc, char* argv[]) {
         }
         
         // Process as a generation request
-        std::cout << "\n[...] Thinking..." << std::endl;
-        agent.processRequest(input);
+        std::cout << "\n[...] Thinking... (Ctrl+C to cancel)" << std::endl;
+        g_cancelToken.reset();
+        g_requestActive = 1;
+        
+        // Generate on a worker thread while this thread prints its output
+        std::atomic<bool> finished{false};
+        std::thread worker([&]() {
+            agent.processRequest(input);
+            finished = true;
+        });
+        while (!finished) {
+            if (printEvents(*events) == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(15));
+            }
+        }
+        worker.join();
+        while (printEvents(*events) > 0) {}
+        
+        g_requestActive = 0;
     }
     
     return 0;
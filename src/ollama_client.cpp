@@ -3,85 +3,646 @@
 #include <curl/curl.h>
 #include <sstream>
 #include <iostream>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <filesystem>
+#include <cstdlib>
+#ifdef OLLAMA_AGENT_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 namespace ollama_agent {
 
+// State shared with the libcurl callbacks during one transfer attempt
+struct TransferContext {
+    CURL* curl = nullptr;
+    const std::function<bool(const char*, size_t)>* sink = nullptr;
+    const CancellationToken* token = nullptr;
+    long long deadlineMs = 0;     // Absolute steady-clock deadline (0 = none)
+    std::string errorBody;        // Body of HTTP error responses
+    size_t delivered = 0;         // Bytes handed to the sink
+    bool sinkAborted = false;
+    bool deadlineHit = false;
+};
+
+static long long steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 // Callback for libcurl to write response data
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
+static size_t WriteCallback(char* contents, size_t size, size_t nmemb, void* userp) {
+    auto* ctx = static_cast<TransferContext*>(userp);
     size_t totalSize = size * nmemb;
-    userp->append(static_cast<char*>(contents), totalSize);
+    
+    // Error responses are kept aside so they never reach the caller's sink
+    long status = 0;
+    curl_easy_getinfo(ctx->curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status >= 400) {
+        ctx->errorBody.append(contents, totalSize);
+        return totalSize;
+    }
+    
+    if (!(*ctx->sink)(contents, totalSize)) {
+        ctx->sinkAborted = true;
+        return 0;
+    }
+    ctx->delivered += totalSize;
     return totalSize;
 }
 
+// Produces the bytes sent for a request body, gzip-compressing them on the
+// fly when asked to (compression is only requested when zlib is built in)
+class BodyStream {
+public:
+    BodyStream(const RequestBody& body, bool compress) : reader_(body) {
+#ifdef OLLAMA_AGENT_HAVE_ZLIB
+        // windowBits 15 + 16 selects the gzip wrapper
+        compress_ = compress &&
+                    deflateInit2(&zstream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+#else
+        (void)compress;
+#endif
+    }
+    
+    ~BodyStream() {
+#ifdef OLLAMA_AGENT_HAVE_ZLIB
+        if (compress_) deflateEnd(&zstream_);
+#endif
+    }
+    
+    BodyStream(const BodyStream&) = delete;
+    BodyStream& operator=(const BodyStream&) = delete;
+    
+    // Fill up to size bytes; returns 0 at the end of the body
+    size_t read(char* buffer, size_t size) {
+#ifdef OLLAMA_AGENT_HAVE_ZLIB
+        if (compress_) return readCompressed(buffer, size);
+#endif
+        return reader_.read(buffer, size);
+    }
+    
+    // Produce the whole (possibly compressed) body as one string
+    std::string readAll() {
+        std::string result;
+        char buffer[16 * 1024];
+        size_t n;
+        while ((n = read(buffer, sizeof(buffer))) > 0) {
+            result.append(buffer, n);
+        }
+        return result;
+    }
+    
+    bool failed() const {
+        return failed_;
+    }
+
+private:
+    RequestBody::Reader reader_;
+    bool failed_ = false;
+#ifdef OLLAMA_AGENT_HAVE_ZLIB
+    z_stream zstream_{};
+    bool compress_ = false;
+    bool inputDone_ = false;
+    bool finished_ = false;
+    char input_[16 * 1024];
+    
+    size_t readCompressed(char* buffer, size_t size) {
+        zstream_.next_out = reinterpret_cast<Bytef*>(buffer);
+        zstream_.avail_out = static_cast<uInt>(size);
+        
+        while (zstream_.avail_out > 0 && !finished_ && !failed_) {
+            if (zstream_.avail_in == 0 && !inputDone_) {
+                size_t n = reader_.read(input_, sizeof(input_));
+                zstream_.next_in = reinterpret_cast<Bytef*>(input_);
+                zstream_.avail_in = static_cast<uInt>(n);
+                inputDone_ = (n == 0);
+            }
+            int rc = deflate(&zstream_, inputDone_ ? Z_FINISH : Z_NO_FLUSH);
+            if (rc == Z_STREAM_END) {
+                finished_ = true;
+            } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+                failed_ = true;
+            }
+        }
+        return size - zstream_.avail_out;
+    }
+#endif
+};
+
+// Callback for libcurl to read a streamed request body
+static size_t ReadCallback(char* buffer, size_t size, size_t nitems, void* userp) {
+    auto* stream = static_cast<BodyStream*>(userp);
+    size_t n = stream->read(buffer, size * nitems);
+    return stream->failed() ? CURL_READFUNC_ABORT : n;
+}
+
+// Hosts that answered a gzip-encoded body with an error. Shared by all
+// clients so each host is only probed once per process.
+static std::mutex g_compressionMutex;
+static std::map<std::string, bool> g_compressionSupport;
+
+static std::optional<bool> knownCompressionSupport(const std::string& hostKey) {
+    std::lock_guard<std::mutex> lock(g_compressionMutex);
+    auto it = g_compressionSupport.find(hostKey);
+    if (it == g_compressionSupport.end()) return std::nullopt;
+    return it->second;
+}
+
+static void recordCompressionSupport(const std::string& hostKey, bool supported) {
+    std::lock_guard<std::mutex> lock(g_compressionMutex);
+    g_compressionSupport[hostKey] = supported;
+}
+
+// Wrap a prebuilt JSON string as a request body
+static RequestBody rawBody(const std::string& json) {
+    RequestBody body;
+    body.appendRaw(json);
+    return body;
+}
+
+static RequestBody escapedContent(const std::string& text) {
+    RequestBody content;
+    content.appendEscaped(text);
+    return content;
+}
+
+// Callback for libcurl progress; aborts on cancellation or deadline
+static int ProgressCallback(void* clientp, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+    auto* ctx = static_cast<TransferContext*>(clientp);
+    if (ctx->token->isCancelled()) {
+        return 1;
+    }
+    if (ctx->deadlineMs > 0 && steadyNowMs() >= ctx->deadlineMs) {
+        ctx->deadlineHit = true;
+        return 1;
+    }
+    return 0;
+}
+
+// File caching the model list of one host, e.g. models-127.0.0.1-11434.txt
+static std::filesystem::path modelListPath(const OllamaConfig& config) {
+    std::string name = "models-" + config.host + "-" + std::to_string(config.port) + ".txt";
+    for (char& c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-') c = '_';
+    }
+    return std::filesystem::path(defaultCacheDirectory()) / name;
+}
+
+// Read a cached model list (one name per line) if it is younger than the TTL
+static std::optional<std::vector<std::string>> readModelList(const std::filesystem::path& path,
+                                                             int ttlSeconds) {
+    std::error_code ec;
+    auto modified = std::filesystem::last_write_time(path, ec);
+    if (ec) return std::nullopt;
+    if (std::filesystem::file_time_type::clock::now() - modified > std::chrono::seconds(ttlSeconds)) {
+        return std::nullopt;
+    }
+    
+    std::ifstream file(path);
+    std::vector<std::string> models;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty()) models.push_back(line);
+    }
+    if (models.empty()) return std::nullopt;
+    return models;
+}
+
+// Replace the cached model list; written to a temp file first so readers never see half a list
+static void writeModelList(const std::filesystem::path& path, const std::vector<std::string>& models) {
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        if (!file) return;
+        for (const auto& model : models) {
+            file << model << '\n';
+        }
+    }
+    std::filesystem::rename(temp, path, ec);
+}
+
+const ModelProfile* findModelProfile(const std::map<std::string, ModelProfile>& profiles,
+                                     const std::string& model) {
+    auto it = profiles.find(model);
+    if (it == profiles.end()) {
+        size_t colon = model.find(':');
+        if (colon != std::string::npos) {
+            it = profiles.find(model.substr(0, colon));
+        }
+    }
+    if (it == profiles.end()) {
+        it = profiles.find("*");
+    }
+    return (it == profiles.end()) ? nullptr : &it->second;
+}
+
+CancellationToken::CancellationToken() : cancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+void CancellationToken::cancel() {
+    cancelled_->store(true);
+}
+
+bool CancellationToken::isCancelled() const {
+    return cancelled_->load();
+}
+
+void CancellationToken::reset() {
+    cancelled_->store(false);
+}
+
 OllamaClient::OllamaClient(const OllamaConfig& config) : config_(config) {
     curl_global_init(CURL_GLOBAL_DEFAULT);
 }
 
 OllamaClient::~OllamaClient() {
+    preloadToken_.cancel();
+    healthToken_.cancel();
+    if (preloadThread_.joinable()) {
+        preloadThread_.join();
+    }
+    if (healthThread_.joinable()) {
+        healthThread_.join();
+    }
     curl_global_cleanup();
 }
 
+RequestOptions OllamaClient::requestOptions(const std::string& model, const std::string& format) const {
+    RequestOptions options;
+    options.keepAlive = config_.keepAlive;
+    options.format = format;
+    
+    // The preload goes through here too, so it loads the model with the same
+    // num_ctx as later requests and Ollama doesn't reload it on first use
+    if (const ModelProfile* profile = findModelProfile(config_.profiles, model)) {
+        options.generation = profile->options;
+        if (!profile->keepAlive.empty()) {
+            options.keepAlive = profile->keepAlive;
+        }
+    }
+    return options;
+}
+
+GenerationStats OllamaClient::parseStats(const std::string& json) {
+    GenerationStats stats;
+    auto total = JsonParser::getInt(json, "total_duration");
+    if (!total.has_value()) {
+        return stats;
+    }
+    
+    // Ollama reports durations in nanoseconds
+    const long long nsPerMs = 1000000;
+    stats.valid = true;
+    stats.totalMs = total.value() / nsPerMs;
+    stats.loadMs = JsonParser::getInt(json, "load_duration").value_or(0) / nsPerMs;
+    stats.promptEvalCount = JsonParser::getInt(json, "prompt_eval_count").value_or(0);
+    stats.promptEvalMs = JsonParser::getInt(json, "prompt_eval_duration").value_or(0) / nsPerMs;
+    stats.evalCount = JsonParser::getInt(json, "eval_count").value_or(0);
+    stats.evalMs = JsonParser::getInt(json, "eval_duration").value_or(0) / nsPerMs;
+    return stats;
+}
+
+std::vector<std::string> OllamaClient::parseModelNames(const std::string& response) {
+    std::vector<std::string> models;
+    
+    // Parse models from response - simple parsing
+    size_t pos = 0;
+    while ((pos = response.find("\"name\"", pos)) != std::string::npos) {
+        size_t colonPos = response.find(':', pos);
+        if (colonPos == std::string::npos) break;
+        
+        size_t quoteStart = response.find('"', colonPos + 1);
+        if (quoteStart == std::string::npos) break;
+        
+        size_t quoteEnd = response.find('"', quoteStart + 1);
+        if (quoteEnd == std::string::npos) break;
+        
+        std::string modelName = response.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
+        models.push_back(modelName);
+        
+        pos = quoteEnd + 1;
+    }
+    
+    return models;
+}
+
+std::vector<std::vector<float>> OllamaClient::parseEmbeddings(const std::string& response) {
+    std::vector<std::vector<float>> embeddings;
+    
+    size_t pos = response.find("\"embeddings\"");
+    if (pos == std::string::npos) return embeddings;
+    pos = response.find('[', pos);
+    if (pos == std::string::npos) return embeddings;
+    
+    // [[0.1,0.2,...],[...]] - numbers only, so a flat scan is enough
+    const char* text = response.c_str();
+    size_t depth = 0;
+    for (size_t i = pos; i < response.size(); i++) {
+        char c = text[i];
+        if (c == '[') {
+            depth++;
+            if (depth == 2) embeddings.emplace_back();
+        } else if (c == ']') {
+            if (--depth == 0) break;
+        } else if (depth == 2 && (c == '-' || (c >= '0' && c <= '9'))) {
+            char* end = nullptr;
+            embeddings.back().push_back(std::strtof(text + i, &end));
+            i = static_cast<size_t>(end - text) - 1;
+        }
+    }
+    return embeddings;
+}
+
 std::string OllamaClient::buildUrl(const std::string& endpoint) const {
     std::ostringstream url;
     url << "http://" << config_.host << ":" << config_.port << endpoint;
     return url.str();
 }
 
-std::string OllamaClient::httpPost(const std::string& url, const std::string& body) {
+RequestError OllamaClient::transferOnce(const std::string& url, const RequestBody* body,
+                                        const BodySink& sink, long timeoutMs, long long deadlineMs,
+                                        bool compress, size_t& delivered) {
     CURL* curl = curl_easy_init();
-    std::string response;
-    
     if (!curl) {
         lastError_ = "Failed to initialize CURL";
-        return "";
+        return RequestError::Other;
     }
     
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+    TransferContext ctx;
+    ctx.curl = curl;
+    ctx.sink = &sink;
+    ctx.token = &cancelToken_;
+    ctx.deadlineMs = deadlineMs;
     
+    struct curl_slist* headers = nullptr;
+    std::string postData;
+    std::unique_ptr<BodyStream> stream;
     curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    if (body) {
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        if (compress) {
+            headers = curl_slist_append(headers, "Content-Encoding: gzip");
+        }
+        stream = std::make_unique<BodyStream>(*body, compress);
+        if (body->hasFiles()) {
+            // Stream the body with chunked encoding; file contents are read,
+            // escaped (and compressed) block by block as curl asks for more data
+            headers = curl_slist_append(headers, "Transfer-Encoding: chunked");
+            headers = curl_slist_append(headers, "Expect:");
+            curl_easy_setopt(curl, CURLOPT_POST, 1L);
+            curl_easy_setopt(curl, CURLOPT_READFUNCTION, ReadCallback);
+            curl_easy_setopt(curl, CURLOPT_READDATA, stream.get());
+        } else {
+            postData = compress ? stream->readAll() : body->toString();
+            if (stream->failed()) {
+                curl_slist_free_all(headers);
+                curl_easy_cleanup(curl);
+                lastError_ = "Failed to compress request body";
+                return RequestError::Other;
+            }
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(postData.size()));
+        }
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    }
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, config_.timeoutSeconds);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ctx);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ProgressCallback);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &ctx);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeoutMs);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    // Offer every encoding curl can decode; responses are decompressed transparently
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
     
     CURLcode res = curl_easy_perform(curl);
     
-    if (res != CURLE_OK) {
-        lastError_ = std::string("CURL error: ") + curl_easy_strerror(res);
-        response = "";
-    }
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    lastHttpStatus_ = status;
     
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
     
+    delivered = ctx.delivered;
+    
+    switch (res) {
+        case CURLE_OK:
+            break;
+        case CURLE_ABORTED_BY_CALLBACK:
+            if (stream && stream->failed()) {
+                lastError_ = "Failed to compress request body";
+                return RequestError::Other;
+            }
+            if (ctx.deadlineHit) {
+                lastError_ = "Request deadline exceeded";
+                return RequestError::Timeout;
+            }
+            lastError_ = "Request cancelled";
+            return RequestError::Cancelled;
+        case CURLE_WRITE_ERROR:
+            lastError_ = ctx.sinkAborted ? "Transfer aborted"
+                                         : std::string("CURL error: ") + curl_easy_strerror(res);
+            return ctx.sinkAborted ? RequestError::Aborted : RequestError::Other;
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+            lastError_ = std::string("CURL error: ") + curl_easy_strerror(res);
+            return RequestError::ConnectFailed;
+        case CURLE_OPERATION_TIMEDOUT:
+            lastError_ = std::string("CURL error: ") + curl_easy_strerror(res);
+            return RequestError::Timeout;
+        default:
+            lastError_ = std::string("CURL error: ") + curl_easy_strerror(res);
+            return RequestError::Other;
+    }
+    
+    if (status >= 400) {
+        lastError_ = "HTTP " + std::to_string(status);
+        auto message = JsonParser::getString(ctx.errorBody, "error");
+        if (message.has_value()) {
+            lastError_ += ": " + message.value();
+        }
+        bool busy = (status == 429 || status == 502 || status == 503 || status == 504);
+        return busy ? RequestError::ServerBusy : RequestError::HttpError;
+    }
+    
+    return RequestError::None;
+}
+
+bool OllamaClient::shouldCompress(const RequestBody* body) const {
+    if (!body || !config_.compressRequests || !supportsCompression()) {
+        return false;
+    }
+    if (body->getSourceSize() < config_.compressMinBytes) {
+        return false;
+    }
+    auto known = knownCompressionSupport(config_.host + ":" + std::to_string(config_.port));
+    return known.value_or(true);
+}
+
+bool OllamaClient::supportsCompression() {
+#ifdef OLLAMA_AGENT_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool OllamaClient::sleepUnlessCancelled(int milliseconds) const {
+    const int sliceMs = 50;
+    long long wakeAt = steadyNowMs() + milliseconds;
+    while (steadyNowMs() < wakeAt) {
+        if (cancelToken_.isCancelled()) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(sliceMs));
+    }
+    return !cancelToken_.isCancelled();
+}
+
+bool OllamaClient::performTransfer(const std::string& url, const RequestBody* body,
+                                   const BodySink& sink, int timeoutSeconds, int maxAttempts) {
+    thread_local std::mt19937 rng(std::random_device{}());
+    
+    long long deadlineMs = 0;
+    if (retryPolicy_.deadlineSeconds > 0) {
+        deadlineMs = steadyNowMs() + retryPolicy_.deadlineSeconds * 1000LL;
+    }
+    
+    int backoffMs = retryPolicy_.initialBackoffMs;
+    lastAttemptCount_ = 0;
+    
+    for (int attempt = 1; ; ++attempt) {
+        if (cancelToken_.isCancelled()) {
+            lastError_ = "Request cancelled";
+            lastErrorKind_ = RequestError::Cancelled;
+            return false;
+        }
+        
+        // Each attempt gets the transfer timeout, capped by what is left of the deadline
+        long timeoutMs = timeoutSeconds * 1000L;
+        if (deadlineMs > 0) {
+            long long remainingMs = deadlineMs - steadyNowMs();
+            if (remainingMs <= 0) {
+                lastError_ = "Request deadline exceeded";
+                lastErrorKind_ = RequestError::Timeout;
+                return false;
+            }
+            timeoutMs = static_cast<long>(std::min<long long>(timeoutMs, remainingMs));
+        }
+        
+        lastAttemptCount_ = attempt;
+        size_t delivered = 0;
+        bool compress = shouldCompress(body);
+        lastErrorKind_ = transferOnce(url, body, sink, timeoutMs, deadlineMs, compress, delivered);
+        
+        if (compress) {
+            // The first compressed request to a host doubles as the probe: a
+            // 400/415 may mean the server (or a proxy in front of it) can't
+            // read gzip bodies, so this one is resent uncompressed. A 415 says
+            // so outright; a 400 only counts if the plain resend succeeds,
+            // since Ollama also answers 400 for a bad model, format or option
+            std::string hostKey = config_.host + ":" + std::to_string(config_.port);
+            long status = lastHttpStatus_;
+            bool rejected = (lastErrorKind_ == RequestError::HttpError && delivered == 0 &&
+                             (status == 400 || status == 415));
+            if (rejected && !knownCompressionSupport(hostKey).has_value()) {
+                lastErrorKind_ = transferOnce(url, body, sink, timeoutMs, deadlineMs, false, delivered);
+                if (status == 415 || lastErrorKind_ == RequestError::None) {
+                    recordCompressionSupport(hostKey, false);
+                }
+            } else if (lastErrorKind_ == RequestError::None) {
+                recordCompressionSupport(hostKey, true);
+            }
+        }
+        
+        if (lastErrorKind_ == RequestError::None) {
+            return true;
+        }
+        
+        bool retryable = (lastErrorKind_ == RequestError::ConnectFailed ||
+                          lastErrorKind_ == RequestError::ServerBusy);
+        if (!retryable || delivered > 0 || attempt >= maxAttempts) {
+            return false;
+        }
+        
+        // Exponential backoff with jitter in [delay/2, delay]
+        std::uniform_int_distribution<int> jitter(backoffMs / 2, backoffMs);
+        int delayMs = jitter(rng);
+        backoffMs = static_cast<int>(std::min<double>(retryPolicy_.maxBackoffMs,
+                                                      backoffMs * retryPolicy_.backoffMultiplier));
+        
+        if (deadlineMs > 0 && steadyNowMs() + delayMs >= deadlineMs) {
+            return false;
+        }
+        if (!sleepUnlessCancelled(delayMs)) {
+            lastError_ = "Request cancelled";
+            lastErrorKind_ = RequestError::Cancelled;
+            return false;
+        }
+    }
+}
+
+std::string OllamaClient::httpPost(const std::string& url, const RequestBody& body) {
+    std::string response;
+    BodySink sink = [&response](const char* data, size_t size) {
+        response.append(data, size);
+        return true;
+    };
+    
+    if (!performTransfer(url, &body, sink, config_.timeoutSeconds, retryPolicy_.maxAttempts)) {
+        return "";
+    }
     return response;
 }
 
 std::string OllamaClient::httpGet(const std::string& url) {
-    CURL* curl = curl_easy_init();
     std::string response;
+    BodySink sink = [&response](const char* data, size_t size) {
+        response.append(data, size);
+        return true;
+    };
     
-    if (!curl) {
-        lastError_ = "Failed to initialize CURL";
+    // Short timeout and no retries for status checks
+    if (!performTransfer(url, nullptr, sink, 10, 1)) {
         return "";
     }
+    return response;
+}
+
+std::string OllamaClient::cachedPost(const std::string& endpoint, const RequestBody& body) {
+    lastResponseCached_ = false;
     
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10);  // Short timeout for status checks
+    std::string key;
+    if (cache_) {
+        key = ResponseCache::makeKey(endpoint, body);
+        if (!cacheBypass_) {
+            auto cached = cache_->get(key);
+            if (cached.has_value()) {
+                lastResponseCached_ = true;
+                return cached.value();
+            }
+        }
+    }
     
-    CURLcode res = curl_easy_perform(curl);
+    std::string response = httpPost(buildUrl(endpoint), body);
     
-    if (res != CURLE_OK) {
-        lastError_ = std::string("CURL error: ") + curl_easy_strerror(res);
-        response = "";
+    // Only keep complete, successful responses
+    if (cache_ && !response.empty() && !JsonParser::getString(response, "error").has_value()) {
+        cache_->put(key, response);
     }
     
-    curl_easy_cleanup(curl);
-    
     return response;
 }
 
@@ -90,35 +651,178 @@ bool OllamaClient::isAvailable() {
     return !response.empty();
 }
 
-std::vector<std::string> OllamaClient::listModels() {
-    std::vector<std::string> models;
+std::vector<std::string> OllamaClient::listModels(bool allowCached) {
+    if (allowCached) {
+        std::vector<std::string> cached = getCachedModels();
+        if (!cached.empty()) {
+            return cached;
+        }
+    }
+    
     std::string response = httpGet(buildUrl("/api/tags"));
     
     if (response.empty()) {
-        return models;
+        return {};
     }
     
-    // Parse models from response - simple parsing
-    size_t pos = 0;
-    while ((pos = response.find("\"name\"", pos)) != std::string::npos) {
-        size_t colonPos = response.find(':', pos);
-        if (colonPos == std::string::npos) break;
-        
-        size_t quoteStart = response.find('"', colonPos + 1);
-        if (quoteStart == std::string::npos) break;
-        
-        size_t quoteEnd = response.find('"', quoteStart + 1);
-        if (quoteEnd == std::string::npos) break;
-        
-        std::string modelName = response.substr(quoteStart + 1, quoteEnd - quoteStart - 1);
-        models.push_back(modelName);
-        
-        pos = quoteEnd + 1;
+    std::vector<std::string> models = parseModelNames(response);
+    if (config_.modelListTtlSeconds > 0 && !models.empty()) {
+        writeModelList(modelListPath(config_), models);
     }
-    
     return models;
 }
 
+std::vector<std::string> OllamaClient::getCachedModels() const {
+    if (config_.modelListTtlSeconds <= 0) {
+        return {};
+    }
+    auto cached = readModelList(modelListPath(config_), config_.modelListTtlSeconds);
+    return cached.value_or(std::vector<std::string>{});
+}
+
+void OllamaClient::checkAvailabilityAsync() {
+    healthToken_.cancel();
+    if (healthThread_.joinable()) {
+        healthThread_.join();
+    }
+    healthToken_ = CancellationToken();
+    availability_ = Availability::Unknown;
+    
+    // Like the preload, the check runs on its own client
+    OllamaConfig config = config_;
+    CancellationToken token = healthToken_;
+    healthThread_ = std::thread([this, config, token]() {
+        OllamaClient checker(config);
+        checker.setCancellationToken(token);
+        checker.listModels(false);
+        if (token.isCancelled()) return;
+        availability_ = (checker.getLastErrorKind() == RequestError::None)
+            ? Availability::Available : Availability::Unavailable;
+    });
+}
+
+Availability OllamaClient::getAvailability() const {
+    return availability_.load();
+}
+
+std::vector<std::string> OllamaClient::listLoadedModels() {
+    std::string response = httpGet(buildUrl("/api/ps"));
+    
+    if (response.empty()) {
+        return {};
+    }
+    
+    return parseModelNames(response);
+}
+
+std::vector<std::vector<float>> OllamaClient::embed(const std::string& model,
+                                                    const std::vector<std::string>& inputs) {
+    std::string json = "{\"model\":\"" + JsonParser::escapeJson(model) + "\",\"input\":[";
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (i > 0) json += ",";
+        json += "\"";
+        JsonParser::appendEscapedJson(json, inputs[i]);
+        json += "\"";
+    }
+    json += "]";
+    std::string keepAlive = requestOptions(model).keepAlive;
+    if (!keepAlive.empty()) {
+        json += ",\"keep_alive\":\"" + JsonParser::escapeJson(keepAlive) + "\"";
+    }
+    json += "}";
+    
+    std::string response = httpPost(buildUrl("/api/embed"), rawBody(json));
+    if (response.empty()) {
+        return {};
+    }
+    
+    auto error = JsonParser::getString(response, "error");
+    if (error.has_value()) {
+        lastError_ = "Ollama error: " + error.value();
+        return {};
+    }
+    
+    std::vector<std::vector<float>> embeddings = parseEmbeddings(response);
+    if (embeddings.size() != inputs.size()) {
+        lastError_ = "Unexpected embedding response (" + std::to_string(embeddings.size()) +
+                     " vectors for " + std::to_string(inputs.size()) + " inputs)";
+        return {};
+    }
+    return embeddings;
+}
+
+bool OllamaClient::preloadModel(const std::string& model) {
+    // A generate request with an empty prompt only loads the model
+    RequestBody body = rawBody(JsonParser::buildRequest(model, "", false, requestOptions(model)));
+    std::string response = httpPost(buildUrl("/api/generate"), body);
+    
+    if (response.empty()) {
+        return false;
+    }
+    
+    auto error = JsonParser::getString(response, "error");
+    if (error.has_value()) {
+        lastError_ = "Ollama error: " + error.value();
+        return false;
+    }
+    
+    GenerationStats stats = parseStats(response);
+    lastPreloadMs_ = stats.valid ? stats.loadMs : 0;
+    return true;
+}
+
+void OllamaClient::preloadModelAsync(const std::string& model) {
+    // Only one preload at a time - abandon the previous one
+    preloadToken_.cancel();
+    if (preloadThread_.joinable()) {
+        preloadThread_.join();
+    }
+    preloadToken_ = CancellationToken();
+    preloading_ = true;
+    
+    // The preload runs on its own client so it never touches this client's state
+    OllamaConfig config = config_;
+    RetryPolicy policy = retryPolicy_;
+    CancellationToken token = preloadToken_;
+    preloadThread_ = std::thread([this, config, policy, token, model]() {
+        OllamaClient loader(config);
+        loader.setRetryPolicy(policy);
+        loader.setCancellationToken(token);
+        if (loader.preloadModel(model)) {
+            lastPreloadMs_ = loader.getLastPreloadMs();
+        }
+        preloading_ = false;
+    });
+}
+
+bool OllamaClient::prefillChat(const std::string& systemPrompt, const RequestBody& userContent) {
+    RequestOptions options = requestOptions(config_.model);
+    options.generation.numPredict = 1;
+    RequestBody body = JsonParser::buildChatRequestBody(config_.model, systemPrompt, userContent, false, options);
+    
+    lastStats_ = GenerationStats{};
+    std::string response = httpPost(buildUrl("/api/chat"), body);
+    if (response.empty()) {
+        return false;
+    }
+    
+    auto error = JsonParser::getString(response, "error");
+    if (error.has_value()) {
+        lastError_ = "Ollama error: " + error.value();
+        return false;
+    }
+    lastStats_ = parseStats(response);
+    return true;
+}
+
+bool OllamaClient::isPreloading() const {
+    return preloading_.load();
+}
+
+long long OllamaClient::getLastPreloadMs() const {
+    return lastPreloadMs_.load();
+}
+
 void OllamaClient::setModel(const std::string& model) {
     config_.model = model;
 }
@@ -127,15 +831,23 @@ std::string OllamaClient::getModel() const {
     return config_.model;
 }
 
+const OllamaConfig& OllamaClient::getConfig() const {
+    return config_;
+}
+
 std::string OllamaClient::generate(const std::string& prompt) {
-    std::string url = buildUrl("/api/generate");
-    std::string body = JsonParser::buildRequest(config_.model, prompt, false);
+    RequestBody body = rawBody(JsonParser::buildRequest(config_.model, prompt, false, requestOptions(config_.model)));
     
-    std::string response = httpPost(url, body);
+    lastStats_ = GenerationStats{};
+    std::string response = cachedPost("/api/generate", body);
     
     if (response.empty()) {
         return "";
     }
+    // A replayed response's timings describe the original run, not this one
+    if (!lastResponseCached_) {
+        lastStats_ = parseStats(response);
+    }
     
     // Extract the response content
     auto content = JsonParser::getString(response, "response");
@@ -147,15 +859,26 @@ std::string OllamaClient::generate(const std::string& prompt) {
     return JsonParser::extractStreamContent(response);
 }
 
-std::string OllamaClient::chat(const std::string& systemPrompt, const std::string& userMessage) {
-    std::string url = buildUrl("/api/chat");
-    std::string body = JsonParser::buildChatRequest(config_.model, systemPrompt, userMessage, false);
+std::string OllamaClient::chat(const std::string& systemPrompt, const std::string& userMessage,
+                               const std::string& format) {
+    return chat(systemPrompt, escapedContent(userMessage), format);
+}
+
+std::string OllamaClient::chat(const std::string& systemPrompt, const RequestBody& userContent,
+                               const std::string& format) {
+    RequestBody body = JsonParser::buildChatRequestBody(config_.model, systemPrompt, userContent, false,
+                                                        requestOptions(config_.model, format));
     
-    std::string response = httpPost(url, body);
+    lastStats_ = GenerationStats{};
+    std::string response = cachedPost("/api/chat", body);
     
     if (response.empty()) {
         return "";
     }
+    // A replayed response's timings describe the original run, not this one
+    if (!lastResponseCached_) {
+        lastStats_ = parseStats(response);
+    }
     
     // For chat API, content is nested in message object
     // First find the message object, then extract content
@@ -179,68 +902,189 @@ std::string OllamaClient::chat(const std::string& systemPrompt, const std::strin
 
 void OllamaClient::generateStream(const std::string& prompt, StreamCallback callback) {
     // For streaming, we use the generate endpoint with stream=true
-    // This is a simplified implementation
     std::string url = buildUrl("/api/generate");
-    std::string body = JsonParser::buildRequest(config_.model, prompt, true);
-    
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        lastError_ = "Failed to initialize CURL";
-        return;
-    }
-    
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+    RequestBody body = rawBody(JsonParser::buildRequest(config_.model, prompt, true, requestOptions(config_.model)));
     
     std::string buffer;
     
-    // Custom write callback for streaming
-    auto streamWriter = +[](void* contents, size_t size, size_t nmemb, void* userp) -> size_t {
-        auto* data = static_cast<std::pair<std::string*, StreamCallback*>*>(userp);
-        size_t totalSize = size * nmemb;
-        std::string chunk(static_cast<char*>(contents), totalSize);
-        
-        data->first->append(chunk);
+    // Process complete NDJSON lines
+    BodySink sink = [&](const char* data, size_t size) {
+        buffer.append(data, size);
         
-        // Process complete lines
         size_t pos;
-        while ((pos = data->first->find('\n')) != std::string::npos) {
-            std::string line = data->first->substr(0, pos);
-            data->first->erase(0, pos + 1);
+        while ((pos = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, pos);
+            buffer.erase(0, pos + 1);
             
             if (!line.empty()) {
                 auto content = JsonParser::getString(line, "response");
                 if (content.has_value()) {
-                    (*data->second)(content.value());
+                    callback(content.value());
                 }
             }
         }
-        
-        return totalSize;
+        return true;
     };
     
-    std::pair<std::string*, StreamCallback*> userData{&buffer, &callback};
+    performTransfer(url, &body, sink, config_.timeoutSeconds, retryPolicy_.maxAttempts);
+}
+
+std::string OllamaClient::chatStream(const std::string& systemPrompt, const std::string& userMessage,
+                                     ChatStreamCallback callback, const std::string& format) {
+    return chatStream(systemPrompt, escapedContent(userMessage), std::move(callback), format);
+}
+
+std::string OllamaClient::chatStream(const std::string& systemPrompt, const RequestBody& userContent,
+                                     ChatStreamCallback callback, const std::string& format) {
+    return streamChat(systemPrompt, userContent, "", std::move(callback), format);
+}
+
+std::string OllamaClient::continueChatStream(const std::string& systemPrompt, const RequestBody& userContent,
+                                             const std::string& assistantPrefix, ChatStreamCallback callback,
+                                             const std::string& format) {
+    return streamChat(systemPrompt, userContent, assistantPrefix, std::move(callback), format);
+}
+
+std::string OllamaClient::streamChat(const std::string& systemPrompt, const RequestBody& userContent,
+                                     const std::string& assistantPrefix, ChatStreamCallback callback,
+                                     const std::string& format) {
+    std::string url = buildUrl("/api/chat");
+    RequestOptions options = requestOptions(config_.model, format);
+    RequestBody body = JsonParser::buildChatRequestBody(config_.model, systemPrompt, userContent, true,
+                                                        options, assistantPrefix);
     
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, streamWriter);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &userData);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, config_.timeoutSeconds);
+    lastStats_ = GenerationStats{};
+    lastResponseCached_ = false;
     
-    CURLcode res = curl_easy_perform(curl);
+    // Streamed replies share cache entries with chat(): the key is that of
+    // the same request sent whole, without the stream flag or a prefix
+    std::string key;
+    if (cache_) {
+        key = ResponseCache::makeKey("/api/chat", JsonParser::buildChatRequestBody(
+            config_.model, systemPrompt, userContent, false, options));
+        auto cached = cacheBypass_ ? std::nullopt : cache_->get(key);
+        if (cached.has_value()) {
+            size_t msgPos = cached->find("\"message\"");
+            auto reply = msgPos == std::string::npos ? std::nullopt
+                                                     : JsonParser::getString(cached->substr(msgPos), "content");
+            // A continued reply is served from the cache if it extends the prefix
+            if (reply.has_value() && reply->compare(0, assistantPrefix.size(), assistantPrefix) == 0) {
+                std::string content = reply->substr(assistantPrefix.size());
+                lastResponseCached_ = true;
+                if (!content.empty()) {
+                    callback(content);
+                }
+                return content;
+            }
+        }
+    }
     
-    if (res != CURLE_OK) {
-        lastError_ = std::string("CURL error: ") + curl_easy_strerror(res);
+    std::string buffer;
+    std::string content;
+    std::string streamError;
+    bool done = false;
+    bool aborted = false;
+    
+    // Split NDJSON lines and hand each content delta to the callback
+    BodySink sink = [&](const char* data, size_t size) {
+        buffer.append(data, size);
+        
+        size_t pos;
+        while ((pos = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, pos);
+            buffer.erase(0, pos + 1);
+            if (line.empty()) continue;
+            
+            auto error = JsonParser::getString(line, "error");
+            if (error.has_value()) {
+                streamError = error.value();
+                continue;
+            }
+            
+            // The final line carries the timing statistics
+            if (JsonParser::getBool(line, "done").value_or(false)) {
+                lastStats_ = parseStats(line);
+                done = true;
+            }
+            
+            size_t msgPos = line.find("\"message\"");
+            if (msgPos == std::string::npos) continue;
+            
+            auto delta = JsonParser::getString(line.substr(msgPos), "content");
+            if (delta.has_value() && !delta->empty()) {
+                content += delta.value();
+                if (!callback(delta.value())) {
+                    aborted = true;
+                    return false;  // Abort the transfer
+                }
+            }
+        }
+        return true;
+    };
+    
+    bool ok = performTransfer(url, &body, sink, config_.timeoutSeconds, retryPolicy_.maxAttempts);
+    if (ok && !streamError.empty()) {
+        lastError_ = "Ollama error: " + streamError;
+        lastErrorKind_ = RequestError::Other;
     }
     
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    // Only complete replies are kept, stored as chat() would have received them
+    if (cache_ && ok && done && !aborted && streamError.empty()) {
+        cache_->put(key, "{\"model\":\"" + JsonParser::escapeJson(config_.model) +
+                         "\",\"message\":{\"role\":\"assistant\",\"content\":\"" +
+                         JsonParser::escapeJson(assistantPrefix + content) + "\"},\"done\":true}");
+    }
+    
+    return content;
 }
 
 std::string OllamaClient::getLastError() const {
     return lastError_;
 }
 
+GenerationStats OllamaClient::getLastStats() const {
+    return lastStats_;
+}
+
+void OllamaClient::setResponseCache(std::shared_ptr<ResponseCache> cache) {
+    cache_ = std::move(cache);
+}
+
+std::shared_ptr<ResponseCache> OllamaClient::getResponseCache() const {
+    return cache_;
+}
+
+void OllamaClient::setCacheBypass(bool bypass) {
+    cacheBypass_ = bypass;
+}
+
+bool OllamaClient::wasLastResponseCached() const {
+    return lastResponseCached_;
+}
+
+void OllamaClient::setRetryPolicy(const RetryPolicy& policy) {
+    retryPolicy_ = policy;
+}
+
+const RetryPolicy& OllamaClient::getRetryPolicy() const {
+    return retryPolicy_;
+}
+
+void OllamaClient::setCancellationToken(const CancellationToken& token) {
+    cancelToken_ = token;
+}
+
+const CancellationToken& OllamaClient::getCancellationToken() const {
+    return cancelToken_;
+}
+
+RequestError OllamaClient::getLastErrorKind() const {
+    return lastErrorKind_;
+}
+
+int OllamaClient::getLastAttemptCount() const {
+    return lastAttemptCount_;
+}
+
 } // namespace ollama_agent
 
@@ -0,0 +1,121 @@
+#include "request_body.hpp"
+#include "json_parser.hpp"
+#include <algorithm>
+
+namespace ollama_agent {
+
+// Source bytes escaped per step; output is at most 6x this
+static const size_t kBlockSize = 16 * 1024;
+
+void RequestBody::appendRaw(const std::string& text) {
+    if (text.empty()) return;
+    segments_.push_back({SegmentKind::Raw, text, {}, 0});
+}
+
+void RequestBody::appendEscaped(const std::string& text) {
+    if (text.empty()) return;
+    segments_.push_back({SegmentKind::Escaped, text, {}, 0});
+}
+
+void RequestBody::appendFile(const std::filesystem::path& path, size_t maxBytes) {
+    if (maxBytes == 0) return;
+    segments_.push_back({SegmentKind::File, "", path, maxBytes});
+}
+
+void RequestBody::append(const RequestBody& other) {
+    segments_.insert(segments_.end(), other.segments_.begin(), other.segments_.end());
+}
+
+bool RequestBody::empty() const {
+    return segments_.empty();
+}
+
+bool RequestBody::hasFiles() const {
+    return std::any_of(segments_.begin(), segments_.end(),
+                       [](const Segment& s) { return s.kind == SegmentKind::File; });
+}
+
+size_t RequestBody::getSourceSize() const {
+    size_t total = 0;
+    for (const auto& segment : segments_) {
+        total += (segment.kind == SegmentKind::File) ? segment.maxBytes : segment.text.size();
+    }
+    return total;
+}
+
+std::string RequestBody::toString() const {
+    std::string result;
+    result.reserve(getSourceSize() + 64);
+    Reader reader(*this);
+    char buffer[kBlockSize];
+    size_t n;
+    while ((n = reader.read(buffer, sizeof(buffer))) > 0) {
+        result.append(buffer, n);
+    }
+    return result;
+}
+
+RequestBody::Reader::Reader(const RequestBody& body) : body_(body) {}
+
+bool RequestBody::Reader::fillPending() {
+    pending_.clear();
+    pendingPos_ = 0;
+    
+    while (segment_ < body_.segments_.size()) {
+        const Segment& segment = body_.segments_[segment_];
+        
+        if (segment.kind == SegmentKind::File) {
+            if (!fileOpen_) {
+                file_.open(segment.path, std::ios::binary);
+                fileOpen_ = true;
+            }
+            
+            // Unreadable files contribute nothing rather than failing the request
+            size_t remaining = segment.maxBytes - offset_;
+            if (file_.is_open() && remaining > 0) {
+                char block[kBlockSize];
+                file_.read(block, static_cast<std::streamsize>(std::min(remaining, sizeof(block))));
+                size_t got = static_cast<size_t>(file_.gcount());
+                if (got > 0) {
+                    offset_ += got;
+                    JsonParser::appendEscapedJson(pending_, std::string_view(block, got));
+                    return true;
+                }
+            }
+            
+            file_.close();
+            file_.clear();
+            fileOpen_ = false;
+        } else if (offset_ < segment.text.size()) {
+            size_t count = std::min(kBlockSize, segment.text.size() - offset_);
+            std::string_view piece(segment.text.data() + offset_, count);
+            offset_ += count;
+            if (segment.kind == SegmentKind::Raw) {
+                pending_.assign(piece.data(), piece.size());
+            } else {
+                JsonParser::appendEscapedJson(pending_, piece);
+            }
+            return true;
+        }
+        
+        segment_++;
+        offset_ = 0;
+    }
+    return false;
+}
+
+size_t RequestBody::Reader::read(char* buffer, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        if (pendingPos_ >= pending_.size() && !fillPending()) {
+            break;
+        }
+        size_t count = std::min(size - written, pending_.size() - pendingPos_);
+        std::copy_n(pending_.data() + pendingPos_, count, buffer + written);
+        pendingPos_ += count;
+        written += count;
+    }
+    return written;
+}
+
+} // namespace ollama_agent
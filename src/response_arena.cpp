@@ -0,0 +1,67 @@
+#include "response_arena.hpp"
+#include <algorithm>
+
+namespace ollama_agent {
+
+ResponseArena::ResponseArena(size_t chunkSize) : chunkSize_(std::max<size_t>(chunkSize, 256)) {}
+
+std::string_view ResponseArena::adopt(std::string&& text) {
+    adopted_.push_back(std::move(text));
+    bytesUsed_ += adopted_.back().size();
+    return adopted_.back();
+}
+
+std::string_view ResponseArena::copy(std::string_view text) {
+    // Don't interleave with a slice that is still being built
+    if (getOpenSize() > 0) {
+        return adopt(std::string(text));
+    }
+    append(text);
+    return commit();
+}
+
+void ResponseArena::append(std::string_view text) {
+    if (text.empty()) return;
+    
+    if (chunks_.empty() || chunks_.back().size() + text.size() > chunks_.back().capacity()) {
+        // Start a new chunk; existing chunks are never touched again, so
+        // earlier views stay valid. The open slice moves along.
+        size_t openSize = getOpenSize();
+        size_t needed = openSize + text.size();
+        std::string chunk;
+        chunk.reserve(std::max(chunkSize_, needed * 2));
+        if (openSize > 0) {
+            chunk.append(chunks_.back(), openStart_, openSize);
+        }
+        chunks_.push_back(std::move(chunk));
+        openStart_ = 0;
+    }
+    
+    chunks_.back().append(text.data(), text.size());
+    bytesUsed_ += text.size();
+}
+
+std::string_view ResponseArena::commit() {
+    if (chunks_.empty()) return std::string_view();
+    std::string& chunk = chunks_.back();
+    std::string_view slice(chunk.data() + openStart_, chunk.size() - openStart_);
+    openStart_ = chunk.size();
+    return slice;
+}
+
+void ResponseArena::rollback() {
+    if (chunks_.empty()) return;
+    std::string& chunk = chunks_.back();
+    bytesUsed_ -= chunk.size() - openStart_;
+    chunk.resize(openStart_);
+}
+
+size_t ResponseArena::getOpenSize() const {
+    return chunks_.empty() ? 0 : chunks_.back().size() - openStart_;
+}
+
+size_t ResponseArena::getBytesUsed() const {
+    return bytesUsed_;
+}
+
+} // namespace ollama_agent
@@ -0,0 +1,218 @@
+#include "response_cache.hpp"
+#include "content_hash.hpp"
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+namespace ollama_agent {
+
+std::string defaultCacheDirectory() {
+#ifdef _WIN32
+    if (const char* localAppData = std::getenv("LOCALAPPDATA")) {
+        return (std::filesystem::path(localAppData) / "OllamaAgent" / "cache").string();
+    }
+#else
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+        if (*xdg) return (std::filesystem::path(xdg) / "ollama_agent").string();
+    }
+    if (const char* home = std::getenv("HOME")) {
+        return (std::filesystem::path(home) / ".cache" / "ollama_agent").string();
+    }
+#endif
+    return ".ollama_agent_cache";
+}
+
+ResponseCache::ResponseCache(const ResponseCacheConfig& config) : config_(config) {
+    directory_ = config_.directory.empty()
+        ? std::filesystem::path(defaultCacheDirectory()) / "responses"
+        : std::filesystem::path(config_.directory);
+    
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    loadIndex();
+}
+
+std::string ResponseCache::makeKey(const std::string& endpoint, const std::string& body) {
+    ContentHasher hasher;
+    hasher.update(endpoint);
+    hasher.update(std::string_view("\n", 1));
+    hasher.update(body);
+    return hasher.hexDigest();
+}
+
+std::string ResponseCache::makeKey(const std::string& endpoint, const RequestBody& body) {
+    ContentHasher hasher;
+    hasher.update(endpoint);
+    hasher.update(std::string_view("\n", 1));
+    
+    RequestBody::Reader reader(body);
+    char buffer[16 * 1024];
+    size_t n;
+    while ((n = reader.read(buffer, sizeof(buffer))) > 0) {
+        hasher.update(std::string_view(buffer, n));
+    }
+    return hasher.hexDigest();
+}
+
+std::filesystem::path ResponseCache::entryPath(const std::string& key) const {
+    return directory_ / (key + ".json");
+}
+
+void ResponseCache::loadIndex() {
+    struct DiskEntry {
+        std::string key;
+        size_t size;
+        std::filesystem::file_time_type mtime;
+    };
+    std::vector<DiskEntry> found;
+    
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory_, ec)) {
+        if (!entry.is_regular_file(ec)) continue;
+        if (entry.path().extension() != ".json") continue;
+        
+        DiskEntry diskEntry;
+        diskEntry.key = entry.path().stem().string();
+        diskEntry.size = static_cast<size_t>(entry.file_size(ec));
+        diskEntry.mtime = entry.last_write_time(ec);
+        found.push_back(diskEntry);
+    }
+    
+    // Most recently used first
+    std::sort(found.begin(), found.end(), [](const DiskEntry& a, const DiskEntry& b) {
+        return a.mtime > b.mtime;
+    });
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& diskEntry : found) {
+        lru_.push_back({diskEntry.key, diskEntry.size});
+        index_[diskEntry.key] = std::prev(lru_.end());
+        totalBytes_ += diskEntry.size;
+    }
+    evictLocked();
+}
+
+std::optional<std::string> ResponseCache::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        misses_++;
+        return std::nullopt;
+    }
+    
+    std::ifstream file(entryPath(key), std::ios::binary);
+    if (!file.is_open()) {
+        // Entry was removed behind our back (e.g. by another process)
+        totalBytes_ -= it->second->size;
+        lru_.erase(it->second);
+        index_.erase(it);
+        misses_++;
+        return std::nullopt;
+    }
+    
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    
+    // Move to front and touch the file so LRU order survives restarts
+    lru_.splice(lru_.begin(), lru_, it->second);
+    std::error_code ec;
+    std::filesystem::last_write_time(entryPath(key), std::filesystem::file_time_type::clock::now(), ec);
+    
+    hits_++;
+    return ss.str();
+}
+
+bool ResponseCache::put(const std::string& key, const std::string& response) {
+    if (response.size() > config_.maxBytes) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    
+    // Write to a temporary file first so readers never see a partial entry
+    std::filesystem::path finalPath = entryPath(key);
+    std::filesystem::path tempPath = finalPath;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write(response.data(), static_cast<std::streamsize>(response.size()));
+        if (!file) {
+            return false;
+        }
+    }
+    
+    std::error_code ec;
+    std::filesystem::rename(tempPath, finalPath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        totalBytes_ -= it->second->size;
+        it->second->size = response.size();
+        lru_.splice(lru_.begin(), lru_, it->second);
+    } else {
+        lru_.push_front({key, response.size()});
+        index_[key] = lru_.begin();
+    }
+    totalBytes_ += response.size();
+    
+    evictLocked();
+    return true;
+}
+
+void ResponseCache::evictLocked() {
+    while (!lru_.empty() && (lru_.size() > config_.maxEntries || totalBytes_ > config_.maxBytes)) {
+        const Entry& victim = lru_.back();
+        std::error_code ec;
+        std::filesystem::remove(entryPath(victim.key), ec);
+        totalBytes_ -= victim.size;
+        index_.erase(victim.key);
+        lru_.pop_back();
+    }
+}
+
+void ResponseCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : lru_) {
+        std::error_code ec;
+        std::filesystem::remove(entryPath(entry.key), ec);
+    }
+    lru_.clear();
+    index_.clear();
+    totalBytes_ = 0;
+}
+
+std::string ResponseCache::getDirectory() const {
+    return directory_.string();
+}
+
+size_t ResponseCache::getEntryCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
+
+size_t ResponseCache::getTotalBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return totalBytes_;
+}
+
+size_t ResponseCache::getHits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+size_t ResponseCache::getMisses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+} // namespace ollama_agent
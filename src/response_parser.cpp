@@ -0,0 +1,440 @@
+#include "response_parser.hpp"
+#include "json_parser.hpp"
+#include "section_chunker.hpp"
+#include <regex>
+#include <algorithm>
+#include <cctype>
+
+namespace ollama_agent {
+
+// Get the extension of a filename as its language; a section reference
+// "page.html#S1f2e3d4c" has the language of its file
+static std::string_view languageOf(std::string_view filename) {
+    size_t end = filename.find('#');
+    if (end == std::string_view::npos) end = filename.size();
+    size_t dotPos = filename.substr(0, end).rfind('.');
+    if (dotPos == std::string_view::npos) return {};
+    return filename.substr(dotPos + 1, end - dotPos - 1);
+}
+
+StreamingFileParser::StreamingFileParser(ParserLogCallback log)
+    : log_(std::move(log)), arena_(std::make_shared<ResponseArena>()) {}
+
+void StreamingFileParser::log(const std::string& message) const {
+    if (log_) {
+        log_(message);
+    }
+}
+
+std::string StreamingFileParser::trim(const std::string& str) {
+    size_t start = str.find_first_not_of(" \t\n\r");
+    if (start == std::string::npos) return "";
+    size_t end = str.find_last_not_of(" \t\n\r");
+    return str.substr(start, end - start + 1);
+}
+
+std::string StreamingFileParser::extractFilenameFromText(const std::string& text) {
+    std::string cleaned = text;
+    
+    // Remove markdown formatting
+    size_t pos = 0;
+    while ((pos = cleaned.find('*')) != std::string::npos) cleaned.erase(pos, 1);
+    while ((pos = cleaned.find('`')) != std::string::npos) cleaned.erase(pos, 1);
+    while ((pos = cleaned.find('#')) != std::string::npos) cleaned.erase(pos, 1);
+    
+    // Remove "FILE:" prefix if present
+    std::string upper = cleaned;
+    std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    if (upper.find("FILE:") == 0 || upper.find("FILE :") == 0) {
+        size_t colonPos = cleaned.find(':');
+        if (colonPos != std::string::npos) {
+            cleaned = cleaned.substr(colonPos + 1);
+        }
+    }
+    
+    return trim(cleaned);
+}
+
+bool StreamingFileParser::looksLikeFilename(const std::string& text) {
+    std::string trimmed = trim(text);
+    
+    // Must have an extension (dot followed by letters)
+    size_t dotPos = trimmed.rfind('.');
+    if (dotPos == std::string::npos || dotPos == 0 || dotPos >= trimmed.length() - 1) {
+        return false;
+    }
+    
+    // Extension should be 1-5 alphanumeric characters
+    std::string ext = trimmed.substr(dotPos + 1);
+    if (ext.length() < 1 || ext.length() > 5) return false;
+    
+    for (char c : ext) {
+        if (!std::isalnum(c)) return false;
+    }
+    
+    // Filename part should be reasonable
+    std::string name = trimmed.substr(0, dotPos);
+    if (name.empty() || name.length() > 100) return false;
+    
+    // Should contain valid filename characters
+    for (char c : name) {
+        if (!std::isalnum(c) && c != '_' && c != '-' && c != '/' && c != '\\' && c != '.') {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+std::string StreamingFileParser::generateFilename(const std::string& lang, int index) {
+    // Language to extension mapping
+    static const std::map<std::string, std::string> langToExt = {
+        {"html", "html"}, {"htm", "html"},
+        {"css", "css"}, {"scss", "scss"},
+        {"javascript", "js"}, {"js", "js"}, {"jsx", "jsx"},
+        {"typescript", "ts"}, {"ts", "ts"}, {"tsx", "tsx"},
+        {"python", "py"}, {"py", "py"},
+        {"cpp", "cpp"}, {"c++", "cpp"}, {"cxx", "cpp"},
+        {"c", "c"}, {"java", "java"},
+        {"rust", "rs"}, {"go", "go"},
+        {"ruby", "rb"}, {"php", "php"},
+        {"json", "json"}, {"xml", "xml"},
+        {"yaml", "yaml"}, {"yml", "yml"},
+        {"bash", "sh"}, {"sh", "sh"}, {"shell", "sh"},
+        {"bat", "bat"}, {"cmd", "cmd"},
+        {"sql", "sql"}, {"md", "md"}
+    };
+    
+    std::string lowerLang = lang;
+    std::transform(lowerLang.begin(), lowerLang.end(), lowerLang.begin(), ::tolower);
+    
+    auto it = langToExt.find(lowerLang);
+    std::string ext = (it != langToExt.end()) ? it->second : lang;
+    
+    if (ext == "html") return (index == 0) ? "index.html" : "page" + std::to_string(index) + ".html";
+    if (ext == "css") return (index == 0) ? "styles.css" : "styles" + std::to_string(index) + ".css";
+    if (ext == "js") return (index == 0) ? "script.js" : "script" + std::to_string(index) + ".js";
+    
+    return "file" + std::to_string(index) + "." + ext;
+}
+
+std::string StreamingFileParser::findFilenameInRecentLines() const {
+    static const std::regex filenameRegex(R"(([a-zA-Z0-9_\-./]+\.[a-zA-Z0-9]{1,5}))");
+    
+    for (auto it = recentLines_.rbegin(); it != recentLines_.rend(); ++it) {
+        std::string trimmed = trim(*it);
+        if (trimmed.empty()) continue;
+        
+        // Check various patterns
+        std::string upper = trimmed;
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        
+        // FILE: pattern
+        if (upper.find("FILE:") != std::string::npos || upper.find("FILE :") != std::string::npos) {
+            size_t colonPos = trimmed.find(':');
+            if (colonPos != std::string::npos) {
+                std::string possibleFile = extractFilenameFromText(trimmed.substr(colonPos + 1));
+                if (looksLikeFilename(possibleFile)) return possibleFile;
+            }
+        }
+        
+        // Direct filename patterns (with or without markdown)
+        std::string extracted = extractFilenameFromText(trimmed);
+        if (looksLikeFilename(extracted)) return extracted;
+        
+        // Pattern: "Updated index.html:" or "Here's the index.html file:"
+        std::smatch match;
+        if (std::regex_search(trimmed, match, filenameRegex)) {
+            std::string found = match[1].str();
+            if (looksLikeFilename(found)) return found;
+        }
+    }
+    return "";
+}
+
+void StreamingFileParser::feed(std::string_view chunk) {
+    size_t lineStart = 0;
+    size_t newlinePos;
+    
+    // Complete a line left over from the previous chunk
+    if (!lineBuffer_.empty()) {
+        newlinePos = chunk.find('\n');
+        if (newlinePos == std::string_view::npos) {
+            lineBuffer_.append(chunk.data(), chunk.size());
+            return;
+        }
+        lineBuffer_.append(chunk.data(), newlinePos);
+        processLine(lineBuffer_);
+        lineBuffer_.clear();
+        lineStart = newlinePos + 1;
+    }
+    
+    // Lines wholly inside the chunk are parsed in place
+    while ((newlinePos = chunk.find('\n', lineStart)) != std::string_view::npos) {
+        processLine(chunk.substr(lineStart, newlinePos - lineStart));
+        lineStart = newlinePos + 1;
+    }
+    lineBuffer_.assign(chunk.data() + lineStart, chunk.size() - lineStart);
+}
+
+void StreamingFileParser::finish() {
+    if (!lineBuffer_.empty()) {
+        processLine(lineBuffer_);
+        lineBuffer_.clear();
+    }
+}
+
+void StreamingFileParser::processLine(std::string_view line) {
+    // Check for code block markers - be more flexible
+    size_t tickPos = line.find("```");
+    bool isCodeBlockMarker = (tickPos != std::string_view::npos);
+    
+    if (isCodeBlockMarker) {
+        trailingTextSize_ = 0;
+        if (!inCodeBlock_) {
+            // Starting a code block
+            inCodeBlock_ = true;
+            arena_->rollback();
+            
+            // Extract language hint after ```
+            size_t langStart = tickPos + 3;
+            if (langStart < line.length()) {
+                currentLang_ = std::string(line.substr(langStart));
+                // Remove any trailing characters
+                size_t spacePos = currentLang_.find(' ');
+                if (spacePos != std::string::npos) {
+                    currentLang_ = currentLang_.substr(0, spacePos);
+                }
+                currentLang_ = trim(currentLang_);
+            }
+            
+            // Try to find filename from pending or recent lines
+            if (pendingFilename_.empty()) {
+                pendingFilename_ = findFilenameInRecentLines();
+            }
+        } else {
+            // Ending a code block
+            inCodeBlock_ = false;
+            
+            // Determine filename
+            std::string filename;
+            
+            if (!pendingFilename_.empty()) {
+                filename = pendingFilename_;
+                pendingFilename_.clear();
+            } else if (!currentLang_.empty()) {
+                filename = generateFilename(currentLang_, codeBlockCount_);
+            }
+            
+            // Save the file if we have content; the body was written to
+            // the arena line by line and is referenced, not copied
+            if (arena_->getOpenSize() > 0 && !filename.empty()) {
+                std::string_view body = arena_->commit();
+                size_t endPos = body.find_last_not_of(" \t\n\r");
+                if (endPos != std::string_view::npos) {
+                    ParsedFile file;
+                    file.filename = arena_->copy(filename);
+                    file.content = body.substr(0, endPos + 1);  // Trim trailing whitespace
+                    file.storage = arena_;
+                    
+                    // Get extension as language
+                    file.language = languageOf(file.filename);
+                    
+                    // Check for duplicate filename - keep the latest version
+                    auto it = fileIndexByName_.find(filename);
+                    if (it != fileIndexByName_.end()) {
+                        // Replace existing file with newer version
+                        files_[it->second] = file;
+                        log("[Parser] Updated file: " + filename + " (" + std::to_string(file.content.length()) + " bytes) - replacing previous version");
+                    } else {
+                        // New file
+                        fileIndexByName_[filename] = files_.size();
+                        files_.push_back(file);
+                        log("[Parser] Found file: " + filename + " (" + std::to_string(file.content.length()) + " bytes)");
+                    }
+                    codeBlockCount_++;
+                }
+            } else {
+                arena_->rollback();
+            }
+            
+            currentLang_.clear();
+            recentLines_.clear();  // Clear recent lines after processing a code block
+        }
+        return;
+    }
+    
+    if (inCodeBlock_) {
+        // Inside code block - accumulate content
+        if (arena_->getOpenSize() > 0) {
+            arena_->append("\n");
+        }
+        arena_->append(line);
+    } else {
+        // Outside code block - track recent lines and look for filename indicators
+        trailingTextSize_ += line.size() + 1;
+        std::string trimmedLine = trim(std::string(line));
+        recentLines_.emplace_back(line);
+        if (recentLines_.size() > 5) {
+            recentLines_.erase(recentLines_.begin());
+        }
+        
+        std::string upperLine = trimmedLine;
+        std::transform(upperLine.begin(), upperLine.end(), upperLine.begin(), ::toupper);
+        
+        // Check for "SECTION: filename#ID" - replaces one section of a large file
+        if (upperLine.find("SECTION:") == 0) {
+            std::string reference = trimmedLine.substr(8);
+            reference.erase(std::remove_if(reference.begin(), reference.end(), [](char c) {
+                return c == '*' || c == '`';
+            }), reference.end());
+            reference = trim(reference);
+            
+            std::string path;
+            std::string id;
+            if (parseSectionReference(reference, path, id) && looksLikeFilename(path)) {
+                pendingFilename_ = path + "#" + id;
+                log("[Parser] Found SECTION: marker -> " + pendingFilename_);
+            }
+        }
+        // Check for "FILE: filename" pattern - priority
+        else if (upperLine.find("FILE:") != std::string::npos || upperLine.find("FILE :") != std::string::npos) {
+            size_t colonPos = trimmedLine.find(':');
+            if (colonPos != std::string::npos) {
+                std::string possibleFile = extractFilenameFromText(trimmedLine.substr(colonPos + 1));
+                if (looksLikeFilename(possibleFile)) {
+                    pendingFilename_ = possibleFile;
+                    log("[Parser] Found FILE: marker -> " + pendingFilename_);
+                }
+            }
+        }
+        // Check for **filename.ext** or `filename.ext` patterns
+        else if (looksLikeFilename(extractFilenameFromText(trimmedLine))) {
+            std::string extracted = extractFilenameFromText(trimmedLine);
+            if (trimmedLine.length() < 100) {
+                pendingFilename_ = extracted;
+                log("[Parser] Found filename pattern -> " + pendingFilename_);
+            }
+        }
+    }
+}
+
+const std::vector<ParsedFile>& StreamingFileParser::getFiles() const {
+    return files_;
+}
+
+bool StreamingFileParser::isInCodeBlock() const {
+    return inCodeBlock_;
+}
+
+size_t StreamingFileParser::getTrailingTextSize() const {
+    // Include the unfinished line: prose often arrives as one long paragraph
+    return inCodeBlock_ ? 0 : trailingTextSize_ + lineBuffer_.size();
+}
+
+int StreamingFileParser::getCodeBlockCount() const {
+    return codeBlockCount_;
+}
+
+StructuredFileDecoder::StructuredFileDecoder(ParserLogCallback log)
+    : log_(std::move(log)), arena_(std::make_shared<ResponseArena>()) {}
+
+std::string StructuredFileDecoder::schema() {
+    return R"({"type":"object","properties":{"files":{"type":"array","items":{"type":"object",)"
+           R"("properties":{"path":{"type":"string"},"content":{"type":"string"}},)"
+           R"("required":["path","content"]}}},"required":["files"]})";
+}
+
+void StructuredFileDecoder::feed(std::string_view chunk) {
+    for (char c : chunk) {
+        if (complete_) return;
+        
+        if (capturing_) {
+            objectBuffer_ += c;
+        }
+        
+        if (inString_) {
+            if (escaped_) {
+                escaped_ = false;
+            } else if (c == '\\') {
+                escaped_ = true;
+            } else if (c == '"') {
+                inString_ = false;
+            }
+            continue;
+        }
+        
+        switch (c) {
+            case '"':
+                inString_ = true;
+                break;
+            case '{':
+            case '[':
+                containers_ += c;
+                // A file object sits at {"files":[ { ... } ]}
+                if (c == '{' && containers_ == "{[{") {
+                    capturing_ = true;
+                    objectBuffer_ = "{";
+                }
+                break;
+            case '}':
+            case ']':
+                if (capturing_ && c == '}' && containers_ == "{[{") {
+                    capturing_ = false;
+                    decodeObject(objectBuffer_);
+                    objectBuffer_.clear();
+                }
+                if (!containers_.empty()) {
+                    containers_.pop_back();
+                    if (containers_.empty()) {
+                        complete_ = true;
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void StructuredFileDecoder::decodeObject(const std::string& object) {
+    auto path = JsonParser::getString(object, "path");
+    auto content = JsonParser::getString(object, "content");
+    if (!path.has_value() || !content.has_value()) {
+        if (log_) log_("[Structured] Skipping object without path/content");
+        return;
+    }
+    
+    std::string filename = StreamingFileParser::trim(path.value());
+    if (filename.empty()) {
+        return;
+    }
+    
+    // The decoded strings move into the arena; the file only references them
+    ParsedFile file;
+    file.filename = arena_->adopt(std::string(filename));
+    file.content = arena_->adopt(std::move(content.value()));
+    file.storage = arena_;
+    
+    file.language = languageOf(file.filename);
+    
+    auto it = fileIndexByName_.find(filename);
+    if (it != fileIndexByName_.end()) {
+        files_[it->second] = file;
+        if (log_) log_("[Structured] Updated file: " + filename + " (" + std::to_string(file.content.length()) + " bytes)");
+    } else {
+        fileIndexByName_[filename] = files_.size();
+        files_.push_back(file);
+        if (log_) log_("[Structured] Decoded file: " + filename + " (" + std::to_string(file.content.length()) + " bytes)");
+    }
+}
+
+const std::vector<ParsedFile>& StructuredFileDecoder::getFiles() const {
+    return files_;
+}
+
+bool StructuredFileDecoder::isComplete() const {
+    return complete_;
+}
+
+} // namespace ollama_agent
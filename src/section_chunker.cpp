@@ -0,0 +1,338 @@
+#include "section_chunker.hpp"
+#include "content_hash.hpp"
+#include <map>
+#include <set>
+#include <algorithm>
+#include <cctype>
+
+namespace ollama_agent {
+
+static const size_t kMaxLabelLength = 60;
+
+// How a language's top-level units are recognized
+enum class SectionStyle {
+    Markup,         // Lines opening a top-level block element
+    Braces,         // Brace depth returning to zero
+    Python,         // Top-level def/class
+    Markdown,       // Headings
+    Paragraphs      // Blank lines
+};
+
+static SectionStyle styleFor(std::string_view extension) {
+    static const std::set<std::string, std::less<>> markup = {"html", "htm", "xml", "svg", "vue"};
+    static const std::set<std::string, std::less<>> braces = {
+        "css", "scss", "js", "jsx", "ts", "tsx", "c", "cpp", "cc", "h", "hpp",
+        "java", "rs", "go", "cs", "php", "kt", "swift"
+    };
+    if (markup.count(extension)) return SectionStyle::Markup;
+    if (braces.count(extension)) return SectionStyle::Braces;
+    if (extension == "py") return SectionStyle::Python;
+    if (extension == "md") return SectionStyle::Markdown;
+    return SectionStyle::Paragraphs;
+}
+
+static std::string_view trimView(std::string_view text) {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos) return {};
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+static bool startsWith(std::string_view text, std::string_view prefix) {
+    return text.substr(0, prefix.size()) == prefix;
+}
+
+// Tracks how deeply nested the block elements of a page are
+class MarkupScanner {
+public:
+    // Check if a line opens a block element at the top of the page layout
+    // (a child of <body> or shallower)
+    bool startsBlock(std::string_view line) const {
+        if (depth_ > 1) return false;
+        if (startsWith(line, "<!--")) return true;
+        return line.size() > 1 && line[0] == '<' && isBlockTag(tagName(line, 1));
+    }
+    
+    // Count the block elements opened and closed on a line
+    void scanLine(std::string_view line) {
+        for (size_t pos = line.find('<'); pos != std::string_view::npos; pos = line.find('<', pos + 1)) {
+            bool closing = pos + 1 < line.size() && line[pos + 1] == '/';
+            if (!isBlockTag(tagName(line, pos + (closing ? 2 : 1)))) continue;
+            size_t end = line.find('>', pos);
+            bool selfClosing = end != std::string_view::npos && end > 0 && line[end - 1] == '/';
+            if (closing) {
+                if (depth_ > 0) depth_--;
+            } else if (!selfClosing) {
+                depth_++;
+            }
+        }
+    }
+
+private:
+    int depth_ = 0;
+    
+    static std::string tagName(std::string_view line, size_t start) {
+        std::string tag;
+        for (size_t i = start; i < line.size() && std::isalnum(static_cast<unsigned char>(line[i])); i++) {
+            tag += static_cast<char>(std::tolower(static_cast<unsigned char>(line[i])));
+        }
+        return tag;
+    }
+    
+    static bool isBlockTag(const std::string& tag) {
+        static const std::set<std::string> blockTags = {
+            "head", "body", "header", "nav", "main", "section", "article", "aside", "footer",
+            "div", "form", "table", "ul", "ol", "dl", "figure", "details", "dialog",
+            "script", "style", "template", "svg", "h1", "h2", "h3", "h4", "h5", "h6", "p"
+        };
+        return blockTags.count(tag) > 0;
+    }
+};
+
+// Tracks brace depth across lines, skipping strings and comments
+class BraceScanner {
+public:
+    // Scan one line; returns true if a block closed back to depth zero
+    bool scanLine(std::string_view line) {
+        // A namespace or extern "C" block wraps the whole file; its contents
+        // are treated as top level
+        std::string_view trimmed = trimView(line);
+        bool transparent = !inComment_ && (startsWith(trimmed, "namespace ") ||
+                                           startsWith(trimmed, "extern \"C\""));
+        bool closed = false;
+        char quote = 0;
+        
+        for (size_t i = 0; i < line.size(); i++) {
+            char c = line[i];
+            char next = i + 1 < line.size() ? line[i + 1] : '\0';
+            if (inComment_) {
+                if (c == '*' && next == '/') {
+                    inComment_ = false;
+                    i++;
+                }
+            } else if (inTemplate_ || quote) {
+                char close = inTemplate_ ? '`' : quote;
+                if (c == '\\') {
+                    i++;
+                } else if (c == close) {
+                    inTemplate_ = false;
+                    quote = 0;
+                }
+            } else if (c == '/' && next == '/') {
+                break;
+            } else if (c == '/' && next == '*') {
+                inComment_ = true;
+                i++;
+            } else if (c == '"' || c == '\'') {
+                quote = c;
+            } else if (c == '`') {
+                inTemplate_ = true;
+            } else if (c == '{') {
+                if (transparent) {
+                    transparent = false;
+                } else {
+                    depth_++;
+                }
+            } else if (c == '}') {
+                if (depth_ > 0) {
+                    depth_--;
+                    closed = closed || depth_ == 0;
+                }
+            }
+        }
+        return closed && depth_ == 0;
+    }
+    
+    // Check if the scanner is at top level
+    bool atTopLevel() const {
+        return depth_ == 0 && !inComment_ && !inTemplate_;
+    }
+
+private:
+    int depth_ = 0;
+    bool inComment_ = false;
+    bool inTemplate_ = false;   // Template literals may span lines
+};
+
+// Find where the top-level units of a file start
+static std::vector<size_t> findUnitStarts(std::string_view text, SectionStyle style) {
+    std::vector<size_t> starts = {0};
+    BraceScanner braces;
+    MarkupScanner markup;
+    bool breakPending = false;       // A unit ended; the next non-blank line starts one
+    bool previousBlank = false;
+    bool previousDecorator = false;
+    bool inFence = false;
+    size_t pos = 0;
+    
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        size_t lineEnd = (eol == std::string_view::npos) ? text.size() : eol + 1;
+        std::string_view line = text.substr(pos, lineEnd - pos);
+        std::string_view trimmed = trimView(line);
+        bool blank = trimmed.empty();
+        bool indented = !line.empty() && (line[0] == ' ' || line[0] == '\t');
+        
+        bool startsUnit = false;
+        switch (style) {
+            case SectionStyle::Markup:
+                startsUnit = markup.startsBlock(trimmed);
+                markup.scanLine(line);
+                break;
+            case SectionStyle::Braces:
+                startsUnit = breakPending && !blank;
+                break;
+            case SectionStyle::Python:
+                startsUnit = !indented && !previousDecorator &&
+                             (startsWith(trimmed, "def ") || startsWith(trimmed, "async def ") ||
+                              startsWith(trimmed, "class ") || startsWith(trimmed, "@"));
+                break;
+            case SectionStyle::Markdown:
+                startsUnit = !inFence && startsWith(trimmed, "#");
+                break;
+            case SectionStyle::Paragraphs:
+                startsUnit = previousBlank && !blank;
+                break;
+        }
+        if (startsUnit && pos > starts.back()) {
+            starts.push_back(pos);
+        }
+        if (startsUnit || style != SectionStyle::Braces || !blank) {
+            breakPending = false;
+        }
+        
+        if (style == SectionStyle::Braces) {
+            bool closed = braces.scanLine(line);
+            breakPending = breakPending || (braces.atTopLevel() && (closed || blank));
+        }
+        if (startsWith(trimmed, "```")) {
+            inFence = !inFence;
+        }
+        if (!blank) {
+            previousDecorator = startsWith(trimmed, "@");
+        }
+        previousBlank = blank;
+        pos = lineEnd;
+    }
+    return starts;
+}
+
+std::vector<std::pair<size_t, size_t>> splitIntoChunks(std::string_view text, size_t maxBytes) {
+    std::vector<std::pair<size_t, size_t>> chunks;
+    size_t start = 0;
+    size_t blankBreak = 0;           // End of the last blank line in the chunk (0 = none)
+    size_t pos = 0;
+    
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        size_t lineEnd = (eol == std::string_view::npos) ? text.size() : eol + 1;
+        
+        // Minified files may have no line breaks at all
+        while (lineEnd - start > maxBytes * 2) {
+            chunks.push_back({start, maxBytes});
+            start += maxBytes;
+            blankBreak = 0;
+        }
+        
+        if (text.find_first_not_of(" \t\r\n", pos) >= lineEnd) {
+            blankBreak = lineEnd;
+        }
+        pos = lineEnd;
+        
+        if (lineEnd - start >= maxBytes) {
+            bool useBlank = blankBreak > start && blankBreak - start >= maxBytes / 2;
+            size_t cut = useBlank ? blankBreak : lineEnd;
+            chunks.push_back({start, cut - start});
+            start = cut;
+            blankBreak = 0;
+        }
+    }
+    if (start < text.size()) {
+        chunks.push_back({start, text.size() - start});
+    }
+    return chunks;
+}
+
+std::vector<FileSection> splitIntoSections(std::string_view text, std::string_view extension,
+                                           size_t maxBytes) {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    std::vector<size_t> starts = findUnitStarts(text, styleFor(extension));
+    starts.push_back(text.size());
+    
+    // Pack neighbouring units up to maxBytes; a unit too large on its own
+    // is cut at line ends
+    size_t sectionStart = 0;
+    for (size_t i = 0; i + 1 < starts.size(); i++) {
+        size_t unitStart = starts[i];
+        size_t unitEnd = starts[i + 1];
+        if (unitEnd - unitStart > maxBytes) {
+            if (unitStart > sectionStart) {
+                ranges.push_back({sectionStart, unitStart - sectionStart});
+            }
+            for (const auto& [offset, length] : splitIntoChunks(text.substr(unitStart, unitEnd - unitStart), maxBytes)) {
+                ranges.push_back({unitStart + offset, length});
+            }
+            sectionStart = unitEnd;
+        } else if (unitEnd - sectionStart > maxBytes) {
+            ranges.push_back({sectionStart, unitStart - sectionStart});
+            sectionStart = unitStart;
+        }
+    }
+    if (sectionStart < text.size()) {
+        ranges.push_back({sectionStart, text.size() - sectionStart});
+    }
+    
+    // IDs come from the first line, so editing one section leaves the
+    // others' IDs alone; repeated first lines are numbered in order
+    std::vector<FileSection> sections;
+    std::map<std::string, int> seen;
+    for (const auto& [offset, length] : ranges) {
+        std::string_view body = text.substr(offset, length);
+        size_t first = body.find_first_not_of(" \t\r\n");
+        std::string_view firstLine;
+        if (first != std::string_view::npos) {
+            firstLine = trimView(body.substr(first, body.find('\n', first) - first));
+        }
+        
+        FileSection section;
+        section.offset = offset;
+        section.length = length;
+        section.id = "S" + contentHash(firstLine).substr(0, 8);
+        int occurrence = ++seen[section.id];
+        if (occurrence > 1) {
+            section.id += "-" + std::to_string(occurrence);
+        }
+        section.label = std::string(firstLine.substr(0, kMaxLabelLength));
+        if (firstLine.size() > kMaxLabelLength) {
+            section.label += "...";
+        }
+        sections.push_back(std::move(section));
+    }
+    return sections;
+}
+
+bool parseSectionReference(std::string_view name, std::string& path, std::string& id) {
+    size_t hashPos = name.rfind('#');
+    if (hashPos == std::string_view::npos || hashPos == 0 || hashPos + 2 > name.size()) return false;
+    
+    std::string_view ref = name.substr(hashPos + 1);
+    if (ref[0] != 'S') return false;
+    for (char c : ref) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-') return false;
+    }
+    path = std::string(name.substr(0, hashPos));
+    id = std::string(ref);
+    return true;
+}
+
+std::string pathExtension(std::string_view path) {
+    size_t slash = path.find_last_of("/\\");
+    size_t dotPos = path.rfind('.');
+    if (dotPos == std::string_view::npos || (slash != std::string_view::npos && dotPos < slash)) return "";
+    
+    std::string ext(path.substr(dotPos + 1));
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+} // namespace ollama_agent
@@ -0,0 +1,383 @@
+#include "summary_cache.hpp"
+#include "content_hash.hpp"
+#include "response_cache.hpp"
+#include "section_chunker.hpp"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+
+namespace ollama_agent {
+
+static const size_t kMaxSummaryLength = 400;
+static const size_t kMaxSummarizedBytes = 12000;   // File text sent to the summarizing model
+static const size_t kMaxItems = 24;                // Names listed per kind
+
+static const char* kSummaryPrompt =
+    "Summarize the file in the user message in at most three short lines: what it is for and the "
+    "main names it defines (functions, classes, ids, selectors). Plain text only, no code.";
+
+static std::string_view trimView(std::string_view text) {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos) return {};
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+static bool startsWith(std::string_view text, std::string_view prefix) {
+    return text.substr(0, prefix.size()) == prefix;
+}
+
+// Collapse whitespace runs and cut to the summary length
+static std::string compact(std::string_view text) {
+    std::string result;
+    bool space = false;
+    for (char c : text) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            space = !result.empty();
+            continue;
+        }
+        if (space) result += ' ';
+        result += c;
+        space = false;
+        if (result.size() >= kMaxSummaryLength) {
+            result += "...";
+            break;
+        }
+    }
+    return result;
+}
+
+static void addItem(std::vector<std::string>& items, std::string_view item) {
+    std::string text(trimView(item).substr(0, 80));
+    if (text.empty() || items.size() >= kMaxItems) return;
+    if (std::find(items.begin(), items.end(), text) == items.end()) {
+        items.push_back(std::move(text));
+    }
+}
+
+static void appendList(std::string& summary, const char* label, const std::vector<std::string>& items) {
+    if (items.empty()) return;
+    if (!summary.empty()) summary += "; ";
+    summary += label;
+    summary += ": ";
+    for (size_t i = 0; i < items.size(); i++) {
+        if (i > 0) summary += ", ";
+        summary += items[i];
+    }
+}
+
+// Collect the text of every <tag ...>text</tag> in a page
+static void collectElementText(std::string_view html, std::string_view tag, std::vector<std::string>& items) {
+    std::string open = "<" + std::string(tag);
+    std::string close = "</" + std::string(tag);
+    for (size_t pos = html.find(open); pos != std::string_view::npos; pos = html.find(open, pos + 1)) {
+        size_t start = html.find('>', pos);
+        size_t end = html.find(close, pos);
+        if (start == std::string_view::npos || end == std::string_view::npos || end < start) continue;
+        
+        // Drop nested markup such as <span> inside headings
+        std::string text;
+        bool inTag = false;
+        for (char c : html.substr(start + 1, end - start - 1)) {
+            if (c == '<') inTag = true;
+            else if (c == '>') inTag = false;
+            else if (!inTag) text += c;
+        }
+        addItem(items, compact(text));
+    }
+}
+
+// Collect the values of an attribute, e.g. id="..."
+static void collectAttribute(std::string_view html, std::string_view attribute, std::vector<std::string>& items) {
+    std::string needle = std::string(attribute) + "=\"";
+    for (size_t pos = html.find(needle); pos != std::string_view::npos; pos = html.find(needle, pos + 1)) {
+        if (pos > 0 && !std::isspace(static_cast<unsigned char>(html[pos - 1]))) continue;
+        size_t start = pos + needle.size();
+        size_t end = html.find('"', start);
+        if (end == std::string_view::npos) break;
+        addItem(items, html.substr(start, end - start));
+    }
+}
+
+static std::string summarizeHtml(std::string_view text) {
+    std::vector<std::string> title, headings, ids, links;
+    collectElementText(text, "title", title);
+    for (const char* tag : {"h1", "h2", "h3"}) {
+        collectElementText(text, tag, headings);
+    }
+    collectAttribute(text, "id", ids);
+    collectAttribute(text, "src", links);
+    collectAttribute(text, "href", links);
+    
+    std::string summary;
+    appendList(summary, "title", title);
+    appendList(summary, "headings", headings);
+    appendList(summary, "ids", ids);
+    appendList(summary, "links", links);
+    return summary;
+}
+
+static std::string summarizeCss(std::string_view text) {
+    std::vector<std::string> selectors;
+    size_t pos = 0;
+    int depth = 0;
+    while (pos < text.size() && selectors.size() < kMaxItems) {
+        size_t brace = text.find_first_of("{}", pos);
+        if (brace == std::string_view::npos) break;
+        if (text[brace] == '{') {
+            if (depth == 0) {
+                // The selector runs from the end of the previous rule or comment
+                size_t start = text.find_last_of("};/", brace == 0 ? 0 : brace - 1);
+                start = (start == std::string_view::npos || start < pos) ? pos : start + 1;
+                addItem(selectors, compact(text.substr(start, brace - start)));
+            }
+            depth++;
+        } else if (depth > 0) {
+            depth--;
+        }
+        pos = brace + 1;
+    }
+    
+    std::string summary;
+    appendList(summary, "selectors", selectors);
+    return summary;
+}
+
+static std::string summarizeCode(std::string_view text) {
+    static const char* declarations[] = {
+        "export ", "function ", "async function ", "class ", "def ", "async def ", "struct ",
+        "interface ", "enum ", "type ", "fn ", "pub fn ", "pub struct ", "func ", "module.exports"
+    };
+    std::vector<std::string> names;
+    size_t pos = 0;
+    while (pos < text.size() && names.size() < kMaxItems) {
+        size_t eol = text.find('\n', pos);
+        size_t lineEnd = (eol == std::string_view::npos) ? text.size() : eol;
+        std::string_view line = text.substr(pos, lineEnd - pos);
+        std::string_view trimmed = trimView(line);
+        bool topLevel = !line.empty() && line[0] != ' ' && line[0] != '\t';
+        pos = lineEnd + 1;
+        
+        bool declaration = std::any_of(std::begin(declarations), std::end(declarations),
+                                       [&](const char* keyword) { return startsWith(trimmed, keyword); });
+        // C-like function definitions: a top-level line with a parameter list
+        bool signature = topLevel && trimmed.find('(') != std::string_view::npos &&
+                         (trimmed.back() == '{' || trimmed.back() == ')') &&
+                         !startsWith(trimmed, "if") && !startsWith(trimmed, "for") && !startsWith(trimmed, "while") &&
+                         !startsWith(trimmed, "}") && !startsWith(trimmed, "//") && !startsWith(trimmed, "#");
+        if (!declaration && !signature) continue;
+        
+        size_t cut = trimmed.find_first_of("{=:");
+        if (startsWith(trimmed, "def ") || startsWith(trimmed, "async def ") || startsWith(trimmed, "class ")) {
+            cut = trimmed.rfind(':');
+        }
+        addItem(names, trimmed.substr(0, cut));
+    }
+    
+    std::string summary;
+    appendList(summary, "defines", names);
+    return summary;
+}
+
+static std::string summarizeMarkdown(std::string_view text) {
+    std::vector<std::string> headings;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        size_t lineEnd = (eol == std::string_view::npos) ? text.size() : eol;
+        std::string_view line = text.substr(pos, lineEnd - pos);
+        if (startsWith(line, "#")) {
+            addItem(headings, line.substr(line.find_first_not_of('#')));
+        }
+        pos = lineEnd + 1;
+    }
+    
+    std::string summary;
+    appendList(summary, "headings", headings);
+    return summary;
+}
+
+std::string extractSummary(std::string_view text, std::string_view extension) {
+    std::string summary;
+    if (extension == "html" || extension == "htm" || extension == "xml" || extension == "vue") {
+        summary = summarizeHtml(text);
+    } else if (extension == "css" || extension == "scss") {
+        summary = summarizeCss(text);
+    } else if (extension == "md") {
+        summary = summarizeMarkdown(text);
+    } else if (extension != "txt" && extension != "json" && extension != "yaml" && extension != "yml") {
+        summary = summarizeCode(text);
+    }
+    
+    // Nothing recognizable: the first lines say the most
+    if (summary.empty()) {
+        summary = "starts: " + compact(text.substr(0, kMaxSummaryLength));
+    }
+    return compact(summary);
+}
+
+SummaryCache::SummaryCache(const OllamaConfig& config, const std::string& model, const std::string& directory)
+    : model_(model),
+      directory_(directory.empty() ? std::filesystem::path(defaultCacheDirectory()) / "summaries"
+                                   : std::filesystem::path(directory)),
+      client_(config) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (!model_.empty()) {
+        client_.setModel(model_);
+        // A failed summary falls back to local extraction; no need to wait
+        RetryPolicy policy;
+        policy.maxAttempts = 1;
+        client_.setRetryPolicy(policy);
+        client_.setCancellationToken(cancelToken_);
+    }
+    worker_ = std::thread(&SummaryCache::workerLoop, this);
+}
+
+SummaryCache::~SummaryCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cancelToken_.cancel();
+    workReady_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+std::string SummaryCache::getModel() const {
+    return model_;
+}
+
+uint64_t SummaryCache::getVersion() const {
+    return version_.load();
+}
+
+size_t SummaryCache::getPending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+std::filesystem::path SummaryCache::entryPath(const std::string& hash) const {
+    // Model summaries and local extractions of the same file are kept apart
+    ContentHasher hasher;
+    hasher.update(model_.empty() ? "local" : model_);
+    hasher.update(std::string_view("\n", 1));
+    hasher.update(hash);
+    return directory_ / (hasher.hexDigest() + ".txt");
+}
+
+std::string SummaryCache::load(const std::string& hash) const {
+    std::ifstream file(entryPath(hash), std::ios::binary);
+    if (!file) return "";
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+void SummaryCache::store(const std::string& hash, const std::string& summary) {
+    // Write to a temporary file first so readers never see a partial entry
+    std::filesystem::path finalPath = entryPath(hash);
+    std::filesystem::path tempPath = finalPath;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+        file << summary;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, finalPath, ec);
+    if (!ec) {
+        version_++;
+    }
+}
+
+bool SummaryCache::hashFile(const WorkspaceEntry& file, std::string& content, std::string& hash) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = hashes_.find(file.relativePath);
+        if (it != hashes_.end() && it->second.size == file.size && it->second.mtime == file.mtime) {
+            hash = it->second.hash;
+            return true;
+        }
+    }
+    
+    std::ifstream in(file.fullPath, std::ios::binary);
+    if (!in) return false;
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    hash = contentHash(content);
+    
+    std::lock_guard<std::mutex> lock(mutex_);
+    hashes_[file.relativePath] = {file.size, file.mtime, hash};
+    return true;
+}
+
+void SummaryCache::refresh(const std::vector<WorkspaceEntry>& files) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& file : files) {
+        // Files hashed at this size and mtime already have a stored summary
+        auto it = hashes_.find(file.relativePath);
+        if (it != hashes_.end() && it->second.size == file.size && it->second.mtime == file.mtime &&
+            std::filesystem::exists(entryPath(it->second.hash))) {
+            continue;
+        }
+        if (queued_.insert(file.relativePath).second) {
+            queue_.push_back(file);
+        }
+    }
+    workReady_.notify_one();
+}
+
+std::string SummaryCache::get(const WorkspaceEntry& file) {
+    std::string content;
+    std::string hash;
+    if (!hashFile(file, content, hash)) return "";
+    
+    std::string summary = load(hash);
+    if (!summary.empty()) return summary;
+    
+    if (content.empty()) {
+        std::ifstream in(file.fullPath, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    return extractSummary(content, pathExtension(file.relativePath));
+}
+
+void SummaryCache::workerLoop() {
+    while (true) {
+        WorkspaceEntry file;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            workReady_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) return;
+            file = std::move(queue_.front());
+            queue_.pop_front();
+            queued_.erase(file.relativePath);
+        }
+        
+        std::string content;
+        std::string hash;
+        if (!hashFile(file, content, hash) || !load(hash).empty()) continue;
+        if (content.empty()) {
+            std::ifstream in(file.fullPath, std::ios::binary);
+            content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        
+        std::string summary;
+        if (!model_.empty()) {
+            std::string request = "FILE: " + file.relativePath + "\n```\n" +
+                                  content.substr(0, kMaxSummarizedBytes) + "\n```\n";
+            summary = compact(client_.chat(kSummaryPrompt, request));
+            // Keep the file unsummarized rather than store a local extraction
+            // under the model's key; get() extracts one meanwhile
+            if (summary.empty()) continue;
+        } else {
+            summary = extractSummary(content, pathExtension(file.relativePath));
+        }
+        store(hash, summary);
+    }
+}
+
+} // namespace ollama_agent
@@ -0,0 +1,295 @@
+#include "workspace_watcher.hpp"
+#include "content_hash.hpp"
+#include <fstream>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace ollama_agent {
+
+static bool isHidden(const std::string& name) {
+    return !name.empty() && name[0] == '.';
+}
+
+static std::string joinPath(const std::string& dir, const std::string& name) {
+    return dir.empty() ? name : dir + "/" + name;
+}
+
+static std::string hashFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return "";
+    
+    ContentHasher hasher;
+    char buffer[16 * 1024];
+    while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+        hasher.update(std::string_view(buffer, static_cast<size_t>(file.gcount())));
+    }
+    return hasher.hexDigest();
+}
+
+WorkspaceWatcher::WorkspaceWatcher(const std::string& root) {
+    setRoot(root);
+}
+
+WorkspaceWatcher::~WorkspaceWatcher() {
+    closeNotifications();
+}
+
+void WorkspaceWatcher::setRoot(const std::string& root) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::error_code ec;
+    root_ = std::filesystem::absolute(root, ec);
+    rebuild();
+}
+
+std::string WorkspaceWatcher::getRoot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return root_.string();
+}
+
+void WorkspaceWatcher::closeNotifications() {
+#ifdef __linux__
+    if (notifyFd_ >= 0) {
+        close(notifyFd_);
+    }
+#endif
+    notifyFd_ = -1;
+    watchDirs_.clear();
+    dirWatches_.clear();
+}
+
+void WorkspaceWatcher::rebuild() {
+    closeNotifications();
+    index_.clear();
+    generation_++;
+    ignoreRules_ = IgnoreRules();
+    ignoreRules_.addDefaults();
+
+#ifdef __linux__
+    notifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    scanDirectory("");
+}
+
+void WorkspaceWatcher::addWatch(const std::string& relativeDir) {
+#ifdef __linux__
+    if (notifyFd_ < 0) return;
+    
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                          IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR;
+    std::filesystem::path dir = relativeDir.empty() ? root_ : root_ / relativeDir;
+    int wd = inotify_add_watch(notifyFd_, dir.c_str(), mask);
+    if (wd < 0) {
+        // Typically the per-user watch limit (ENOSPC); rescans still work
+        closeNotifications();
+        return;
+    }
+    watchDirs_[wd] = relativeDir;
+    dirWatches_[relativeDir] = wd;
+#else
+    (void)relativeDir;
+#endif
+}
+
+void WorkspaceWatcher::scanDirectory(const std::string& relativeDir) {
+    // Watch before listing so nothing created meanwhile is missed
+    addWatch(relativeDir);
+    ignoreRules_.loadDirectory(root_, relativeDir);
+    
+    std::filesystem::path dir = relativeDir.empty() ? root_ : root_ / relativeDir;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(
+            dir, std::filesystem::directory_options::skip_permission_denied, ec)) {
+        std::string name = entry.path().filename().string();
+        if (isHidden(name)) continue;
+        
+        std::string relativePath = joinPath(relativeDir, name);
+        bool isDirectory = entry.is_directory(ec) && !entry.is_symlink(ec);
+        if (ignoreRules_.isIgnored(relativePath, isDirectory)) continue;
+        
+        if (isDirectory) {
+            scanDirectory(relativePath);
+        } else if (entry.is_regular_file(ec)) {
+            refreshFile(relativePath);
+        }
+    }
+}
+
+bool WorkspaceWatcher::refreshFile(const std::string& relativePath) {
+    std::filesystem::path fullPath = root_ / relativePath;
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(fullPath, ec)) {
+        return index_.erase(relativePath) > 0;
+    }
+    
+    size_t size = static_cast<size_t>(std::filesystem::file_size(fullPath, ec));
+    auto mtime = std::filesystem::last_write_time(fullPath, ec);
+    
+    auto it = index_.find(relativePath);
+    if (it != index_.end() && it->second.entry.size == size && it->second.entry.mtime == mtime) {
+        return false;
+    }
+    
+    IndexedFile& file = index_[relativePath];
+    file.entry.relativePath = relativePath;
+    file.entry.fullPath = fullPath;
+    file.entry.size = size;
+    file.entry.mtime = mtime;
+    file.hash.clear();
+    return true;
+}
+
+void WorkspaceWatcher::removeDirectory(const std::string& relativeDir) {
+    std::string prefix = relativeDir + "/";
+    auto first = index_.lower_bound(prefix);
+    auto last = first;
+    while (last != index_.end() && last->first.compare(0, prefix.size(), prefix) == 0) {
+        ++last;
+    }
+    index_.erase(first, last);
+    
+    for (auto it = dirWatches_.begin(); it != dirWatches_.end();) {
+        if (it->first == relativeDir || it->first.compare(0, prefix.size(), prefix) == 0) {
+#ifdef __linux__
+            if (notifyFd_ >= 0) inotify_rm_watch(notifyFd_, it->second);
+#endif
+            watchDirs_.erase(it->second);
+            it = dirWatches_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void WorkspaceWatcher::rescan() {
+    std::map<std::string, IndexedFile> previous;
+    previous.swap(index_);
+    ignoreRules_ = IgnoreRules();
+    ignoreRules_.addDefaults();
+    scanDirectory("");
+    
+    bool changed = previous.size() != index_.size();
+    for (auto& [path, file] : index_) {
+        auto old = previous.find(path);
+        if (old == previous.end() || old->second.entry.size != file.entry.size ||
+            old->second.entry.mtime != file.entry.mtime) {
+            changed = true;
+        } else {
+            file.hash = std::move(old->second.hash);
+        }
+    }
+    if (changed) {
+        generation_++;
+    }
+}
+
+void WorkspaceWatcher::update() {
+    if (notifyFd_ < 0) {
+        rescan();
+        return;
+    }
+
+#ifdef __linux__
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    bool changed = false;
+    while (true) {
+        ssize_t length = read(notifyFd_, buffer, sizeof(buffer));
+        if (length <= 0) break;  // EAGAIN: nothing pending
+        
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            auto* event = reinterpret_cast<struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+            
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost; only a full scan is reliable now
+                rebuild();
+                return;
+            }
+            if (event->mask & IN_IGNORED) {
+                auto it = watchDirs_.find(event->wd);
+                if (it != watchDirs_.end()) {
+                    dirWatches_.erase(it->second);
+                    watchDirs_.erase(it);
+                }
+                continue;
+            }
+            
+            auto dir = watchDirs_.find(event->wd);
+            if (dir == watchDirs_.end() || event->len == 0) continue;
+            std::string name = event->name;
+            if (name == ".gitignore" || name == ".agentignore") {
+                // Any rule may change what is indexed
+                rebuild();
+                return;
+            }
+            if (isHidden(name)) continue;
+            std::string relativePath = joinPath(dir->second, name);
+            if (ignoreRules_.isIgnored(relativePath, (event->mask & IN_ISDIR) != 0)) continue;
+            
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    scanDirectory(relativePath);
+                    changed = true;
+                } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    removeDirectory(relativePath);
+                    changed = true;
+                }
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                changed |= index_.erase(relativePath) > 0;
+            } else {
+                changed |= refreshFile(relativePath);
+            }
+            
+            if (notifyFd_ < 0) {
+                // Ran out of watches while adding a new directory
+                rescan();
+                return;
+            }
+        }
+    }
+    if (changed) {
+        generation_++;
+    }
+#endif
+}
+
+std::vector<WorkspaceEntry> WorkspaceWatcher::getFiles() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    update();
+    
+    std::vector<WorkspaceEntry> files;
+    files.reserve(index_.size());
+    for (const auto& [path, file] : index_) {
+        files.push_back(file.entry);
+    }
+    return files;
+}
+
+std::string WorkspaceWatcher::getHash(const std::string& relativePath) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    update();
+    
+    auto it = index_.find(relativePath);
+    if (it == index_.end()) return "";
+    if (it->second.hash.empty()) {
+        it->second.hash = hashFile(it->second.entry.fullPath);
+    }
+    return it->second.hash;
+}
+
+uint64_t WorkspaceWatcher::getGeneration() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    update();
+    return generation_;
+}
+
+bool WorkspaceWatcher::isEventDriven() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return notifyFd_ >= 0;
+}
+
+} // namespace ollama_agent